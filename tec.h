@@ -25,9 +25,12 @@
 #ifndef TEC_H
 #define TEC_H
 
+#include <errno.h>
 #include <float.h>
 #include <inttypes.h>
 #include <setjmp.h>
+#include <signal.h>
+#include <stdarg.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -35,13 +38,25 @@
 #include <stdlib.h>
 #include <string.h>
 #ifdef __cplusplus
+#include <exception>
+#include <iosfwd>
+#include <new>
+#include <type_traits>
+/*
+ * tec.h doesn't need these itself any more, but test files written against
+ * older versions rely on getting them from here. TEC_LEAN_INCLUDES drops
+ * them, along with the runner-only headers below, for faster test files.
+ */
+#ifndef TEC_LEAN_INCLUDES
 #include <sstream>
 #include <stdexcept>
 #include <string>
 #endif
+#endif
 
 #ifdef _WIN32
 // https://learn.microsoft.com/en-us/cpp/c-runtime-library/reference/isatty
+#include <direct.h>
 #include <io.h>
 #include <windows.h>
 #define isatty _isatty
@@ -49,8 +64,75 @@
 #define STDOUT_FILENO _fileno(stdout)
 #endif
 #else
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
 #include <time.h>
 #include <unistd.h>
+#if defined(__GLIBC__) || defined(__APPLE__)
+#define TEC_HAVE_BACKTRACE
+#endif
+/*
+ * opt-in: the implementation then defines clock_gettime, nanosleep, poll, ...
+ * under libc's names for the whole binary. Define it for every file of the
+ * test binary, e.g. -DTEC_ENABLE_VIRTUAL_TIME.
+ */
+#if defined(__GLIBC__) && defined(__LP64__) &&                                 \
+    defined(TEC_ENABLE_VIRTUAL_TIME)
+#define TEC_HAVE_VIRTUAL_TIME
+#endif
+/*
+ * opt-in as well: the implementation then defines malloc, calloc, realloc and
+ * free. AddressSanitizer replaces those itself, so it always wins.
+ */
+#if defined(__SANITIZE_ADDRESS__)
+#define _TEC_ASAN
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define _TEC_ASAN
+#endif
+#endif
+#if defined(__GLIBC__) && defined(TEC_ENABLE_LEAK_CHECK) && !defined(_TEC_ASAN)
+#define TEC_HAVE_LEAK_CHECK
+#endif
+#if defined(__linux__) && defined(__x86_64__) &&                               \
+    (defined(__GNUC__) || defined(__clang__))
+#define TEC_HAVE_TSC
+#endif
+#if defined(__linux__) && defined(__cplusplus) && __cplusplus >= 202002L &&    \
+    defined(__cpp_impl_coroutine)
+#include <coroutine>
+#include <sys/epoll.h>
+#include <utility>
+#define TEC_HAVE_ASYNC
+#endif
+#endif
+
+#if defined(__cplusplus)
+#define TEC_THREAD_LOCAL thread_local
+#elif defined(_MSC_VER)
+#define TEC_THREAD_LOCAL __declspec(thread)
+#else
+#define TEC_THREAD_LOCAL __thread
+#endif
+
+#ifdef _MSC_VER
+#define _TEC_ATOMIC_ADD(p, v) InterlockedExchangeAdd((volatile LONG *)(p), (v))
+#define _TEC_ATOMIC_LOAD(p)                                                    \
+    InterlockedCompareExchange((volatile LONG *)(p), 0, 0)
+#define _TEC_ATOMIC_STORE(p, v) InterlockedExchange((volatile LONG *)(p), (v))
+#define _TEC_CPU_RELAX() YieldProcessor()
+#else
+#define _TEC_ATOMIC_ADD(p, v) __atomic_fetch_add((p), (v), __ATOMIC_ACQ_REL)
+#define _TEC_ATOMIC_LOAD(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define _TEC_ATOMIC_STORE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#if defined(__x86_64__) || defined(__i386__)
+#define _TEC_CPU_RELAX() __builtin_ia32_pause()
+#else
+#define _TEC_CPU_RELAX() ((void)0)
+#endif
 #endif
 
 #ifdef __cplusplus
@@ -79,6 +161,46 @@ extern "C" {
 #define TEC_FMT_SLOTS 2
 #define TEC_FMT_SLOT_SIZE TEC_TMP_STRBUF_LEN
 #define TEC_PREFIX_SIZE 64
+#define TEC_DIFF_CONTEXT 3
+#define TEC_DIFF_MAX_LINE 120
+#define TEC_DIFF_MAX_WORK (1L << 20)
+#define TEC_PATH_MAX 1024
+#define TEC_SNAPSHOT_DIR "__snapshots__"
+#define TEC_LATENCY_SUB_BITS 7
+#define TEC_LATENCY_SUB_COUNT (1 << TEC_LATENCY_SUB_BITS)
+#define TEC_LATENCY_HALF_COUNT (TEC_LATENCY_SUB_COUNT / 2)
+#define TEC_LATENCY_BUCKETS                                                    \
+    ((64 - TEC_LATENCY_SUB_BITS + 2) * TEC_LATENCY_HALF_COUNT)
+#define TEC_LATENCY_MAX_ROWS 8
+#define TEC_BACKTRACE_DEPTH 64
+#define TEC_TIMEOUT_EXIT_CODE 124
+#define TEC_DEATH_STDERR_EXCERPT 200
+#define TEC_CAPTURE_EXCERPT 200
+#define TEC_CAPTURE_SHOW_MAX 65536
+#define TEC_SCRATCH_MAX_FDS 64
+#define TEC_ARENA_BLOCK_SIZE (64 * 1024)
+#define TEC_ARENA_ALIGN 16
+#define TEC_LEAK_MAX_SITES 5
+#define TEC_CLOCK_OVERHEAD_SAMPLES 101
+#define TEC_BENCH_SAMPLES 20
+#define TEC_BENCH_SAMPLE_NS 1000000ull
+#define TEC_BENCH_MAX_ITERATIONS (1ull << 32)
+#define TEC_BENCH_DEFAULT_WARMUP 10
+#define TEC_BENCH_DEFAULT_CV 5.0
+#define TEC_BENCH_PROBE_READS 10001
+#define TEC_BENCH_MAX_POINTS 64
+#define TEC_BENCH_RANGE_MULTIPLIER 8
+#define TEC_BENCH_THREAD_RUN_NS 100000000ull
+#define TEC_CACHE_LINE 64
+#define TEC_TSC_CALIBRATION_NS 20000000ull
+#define TEC_PROFILE_INTERVAL_US 1000
+#define TEC_PROFILE_MAX_SAMPLES 65536
+#define TEC_PROFILE_MAX_FRAMES (TEC_PROFILE_MAX_SAMPLES * 16)
+
+// expected outcomes for TEC_ASSERT_DEATH
+#define TEC_DEATH_ANY (-1)
+#define TEC_DEATH_EXIT(code) ((int)(code) & 0xff)
+#define TEC_DEATH_SIGNAL(sig) (0x100 | (int)(sig))
 
 #define _TEC_FABS(x) ((x) < 0.0 ? -(x) : (x))
 
@@ -88,34 +210,156 @@ extern "C" {
 
 typedef enum { TEC_INITIAL, TEC_FAIL, TEC_SKIP_e } JUMP_CODES;
 
+typedef enum {
+    TEC_DEATH_CHECK, // in the runner: ask the fork server to run the statement
+    TEC_DEATH_RUN,   // in a death-test child: run the statement now
+    TEC_DEATH_SKIP   // in a death-test child: an earlier death assertion
+} tec_death_mode;
+
 typedef enum {
     TEC_SUITE_SETUP,
     TEC_SUITE_TEARDOWN,
     TEC_TEST_SETUP,
-    TEC_TEST_TEARDOWN
+    TEC_TEST_TEARDOWN,
+    TEC_FIXTURE_RESET,  // TEC_FIXTURE_RESET: refills the typed fixture
+    TEC_FIXTURE_RELEASE // TEC_FIXTURE_RELEASE: before the fixture is freed
 } tec_fixture_type;
 
 typedef void (*tec_func_t)(void);
 typedef void (*tec_fixture_func_t)(void);
 
+typedef struct {
+    uint64_t wall_ns;
+    uint64_t cpu_ns;
+} tec_timestamp_t;
+
 typedef struct {
     const char *suite;
     const char *name;
     const char *file;
     tec_func_t func;
     bool xfail;
+    double budget_ms; // 0 means "use --max-test-time"
+    double timeout_s; // 0 means "use --timeout"
+    double elapsed;   // wall time of the last run, 0 if it never ran
+    double cpu_elapsed; // thread CPU time of the last run
+    const char *outcome; // "passed", "failed", ... NULL if it never ran
+    bool bench;          // the body is one iteration of a benchmark
+    size_t range_lo;     // TEC_BENCH_RANGE sizes, range_hi is 0 otherwise
+    size_t range_hi;
+    size_t max_threads; // TEC_BENCH_THREADS: 1, 2, 4, ... up to this
+    bool concurrent;    // TEC_CONCURRENT: threads x iterations of the body
+    size_t threads;     // 0 means one per online CPU
+    size_t iterations;
+    bool async; // TEC_ASYNC: a coroutine run on the runner's event loop
+    bool virtual_time; // TEC_VIRTUAL_TIME: sleeps advance a simulated clock
+    bool compile_time; // TEC_CONSTEXPR: checked by the compiler, never run
 } tec_entry_t;
 
+typedef struct {
+    const char *name;
+    double elapsed;
+} tec_suite_time_t;
+
 typedef struct {
     const char *name;
     tec_fixture_func_t setup;
     tec_fixture_func_t teardown;
     tec_fixture_func_t test_setup;
     tec_fixture_func_t test_teardown;
+    size_t fixture_size; // TEC_FIXTURE: size of the suite's fixture struct
+    tec_fixture_func_t fixture_reset;
+    tec_fixture_func_t fixture_release;
+    void *fixture; // allocated on the suite's first test, reused after that
 } tec_suite_t;
 
+/*
+ * Fixed-size, log-bucketed histogram of nanosecond samples (HDR style). The
+ * first 128 buckets are exact, after that each power of two is split in 64
+ * buckets, so any recorded value is known to within 1/64 (~1.6%). Covers the
+ * whole uint64_t range in ~30 KB with no allocation.
+ */
+typedef struct tec_latency_recorder {
+    uint64_t count;
+    uint64_t min;
+    uint64_t max;
+    uint64_t sum;
+    uint64_t buckets[TEC_LATENCY_BUCKETS];
+} tec_latency_recorder;
+
+typedef struct {
+    const char *name;
+    uint64_t count;
+    uint64_t p50;
+    uint64_t p90;
+    uint64_t p99;
+    uint64_t p999;
+    uint64_t max;
+} tec_latency_row_t;
+
+typedef enum {
+    TEC_O_1,
+    TEC_O_LOG_N,
+    TEC_O_N,
+    TEC_O_N_LOG_N,
+    TEC_O_N2,
+    TEC_COMPLEXITY_COUNT
+} tec_complexity;
+
+// per-iteration statistics of one benchmark size, in nanoseconds.
+typedef struct {
+    size_t n;
+    uint64_t iterations; // per sample
+    double mean_ns;
+    double median_ns;
+    double min_ns;
+    double stddev_ns;
+    double cv_pct;
+    bool unstable; // coefficient of variation above --bench-cv
+} tec_bench_point_t;
+
+// throughput of one thread count of a TEC_BENCH_THREADS benchmark.
+typedef struct {
+    size_t threads;
+    double ops_per_s;        // all threads together
+    double min_thread;       // slowest thread, ops/s
+    double max_thread;       // fastest thread, ops/s
+    double scaling_pct;      // ops_per_s / (threads * single-thread ops_per_s)
+    double spread_pct;       // (max_thread - min_thread) / mean thread rate
+} tec_bench_throughput_t;
+
+typedef struct {
+    size_t n; // current size of a TEC_BENCH_RANGE sweep
+    size_t point_count;
+    tec_bench_point_t points[TEC_BENCH_MAX_POINTS];
+    size_t throughput_count;
+    tec_bench_throughput_t throughput[TEC_BENCH_MAX_POINTS];
+    bool fitted;
+    tec_complexity complexity; // best fit of the sweep
+    double coefficient;        // ns per unit of the best-fit model
+    double rms_pct;            // RMS error of the fit, % of the mean time
+    bool has_bound;            // TEC_ASSERT_COMPLEXITY_LE was reached
+    tec_complexity bound;
+    int bound_line;
+} tec_bench_result_t;
+
+typedef struct {
+    const char *category; // "suite", "test" or "fixture"
+    const char *name;
+    const char *suite;  // tests only
+    const char *result; // outcome of a test, "failed" for a fixture
+    uint64_t start_ns;
+    uint64_t end_ns;
+} tec_trace_event_t;
+
 typedef struct {
     jmp_buf jump_buffer;
+#ifndef _WIN32
+    sigjmp_buf signal_jump_buffer; // only used with --catch-signals
+    volatile sig_atomic_t signal_jump_set;
+#endif
+    const char *crash_signal; // signal that ended the current test, or NULL
+    const char *outcome;      // verdict of the last tec_process_test_result
     char failure_message[TEC_MAX_FAILURE_MESSAGE_LEN];
     char format_bufs[TEC_FMT_SLOTS][TEC_FMT_SLOT_SIZE];
     struct {
@@ -129,6 +373,11 @@ typedef struct {
         size_t total_assertions;
         size_t passed_assertions;
         size_t failed_assertions;
+        size_t updated_snapshots;
+        size_t over_budget_tests;
+        size_t unstable_benchmarks;
+        size_t leaking_tests;
+        size_t compile_time_tests;
     } stats;
     struct {
         tec_entry_t *entries;
@@ -137,6 +386,8 @@ typedef struct {
         size_t tec_capacity;
         size_t suite_count;
         size_t suite_capacity;
+        tec_suite_time_t *suite_times;
+        size_t suite_time_count;
     } registry;
     struct {
         char **filters;
@@ -145,27 +396,197 @@ typedef struct {
         bool fail_fast;
         bool no_color;
         bool use_ascii;
+        bool update_snapshots;
+        bool budget_warn;
+        bool catch_signals;
+        bool tsc_clock;
+        bool bench; // run TEC_BENCH* entries too
+        bool bench_pin_set;
+        int bench_pin;
+        bool bench_priority;
+        size_t bench_warmup;
+        double bench_cv_pct;
+        bool capture;
+        bool leak_check;
+        bool leak_warn;
+        const char *profile_dir;
+        const char *trace_path;
+        double max_test_time_ms;
+        double timeout_s;
+        size_t durations;
     } options;
+    struct {
+        size_t index;  // TEC_ASSERT_DEATH calls seen so far in this test
+        size_t target; // in a death-test child: the call to execute
+        bool in_child;
+        bool reached; // in a death-test child: the statement has started
+#ifndef _WIN32
+        pid_t zygote_pid;
+        int zygote_fd;
+        int marker_fd;
+#endif
+    } death;
+    struct {
+        bool ready;  // the memfds below exist
+        bool active; // fd 1 and fd 2 currently point at them
+        int out_fd;
+        int err_fd;
+        int saved_out;
+        int saved_err;
+    } capture;
+    struct {
+        tec_trace_event_t *events;
+        size_t count;
+        size_t capacity;
+        bool overflowed;
+    } trace;
+    tec_bench_result_t bench;
+    const tec_entry_t *current_test;
+    void *fixture; // TEC_FIXTURE storage of the current test's suite
+    tec_latency_row_t latency_rows[TEC_LATENCY_MAX_ROWS];
+    size_t latency_row_count;
     size_t current_passed;
     size_t current_failed;
     bool jump_set;
 } tec_context_t;
 
-void tec_register(const char *suite, const char *name, const char *file,
-                  tec_func_t func, bool xfail);
+tec_entry_t *tec_register(const char *suite, const char *name,
+                          const char *file, tec_func_t func, bool xfail);
 void tec_register_fixture(const char *suite_name, tec_fixture_func_t func,
                           tec_fixture_type fixture_type);
+void tec_register_fixture_storage(const char *suite_name, size_t size);
+void tec_process_test_result(JUMP_CODES jump_val, const tec_entry_t *test,
+                             double elapsed);
+int tec_run_all(int argc, char **argv);
 
 void _tec_post_wrapper(bool is_fail_case);
 void TEC_POST_FAIL(void) TEC_FUCK_MSVC_EH;
 void _tec_skip_impl(const char *reason, int line) TEC_FUCK_MSVC_EH;
+bool _tec_text_eq(const char *a, const char *b, const char *a_expr,
+                  const char *b_expr, int line);
+bool _tec_snapshot_check(const char *name, const void *data, size_t len,
+                         int line);
+uint64_t tec_ulp_distance_f32(float a, float b);
+uint64_t tec_ulp_distance_f64(double a, double b);
+bool _tec_array_near(const void *a, const void *b, size_t n, int kind,
+                     double tol, const char *a_expr, const char *b_expr,
+                     int line);
+uint64_t tec_now_ns(void);
+uint64_t tec_thread_cpu_ns(void);
+bool _tec_clock_use_tsc(void);
+void _tec_clock_init(void);
+tec_timestamp_t _tec_timestamp(void);
+tec_timestamp_t _tec_elapsed(tec_timestamp_t start);
+void tec_latency_reset(tec_latency_recorder *rec);
+uint64_t tec_latency_percentile(const tec_latency_recorder *rec, double pct);
+void tec_latency_report(const tec_latency_recorder *rec, const char *name);
+bool _tec_percentile_le(const tec_latency_recorder *rec, const char *rec_expr,
+                        double pct, uint64_t budget_ns, int line);
+bool _tec_guarded_call(tec_fixture_func_t func);
+void _tec_watchdog_start(void);
+void _tec_watchdog_arm(const tec_entry_t *test);
+int _tec_death_enter(void);
+void _tec_death_survived(void);
+bool _tec_capture_begin(void);
+void _tec_capture_end(void);
+const char *tec_scratch_dir(void);
+void _tec_scratch_cleanup(void);
+int tec_memfd_open(const char *name);
+void *tec_arena_alloc(size_t size, size_t align);
+void _tec_arena_reset(void);
+void _tec_leak_begin(void);
+void _tec_leak_end(void);
+bool _tec_leak_record(bool on);
+bool _tec_leak_check(void);
+bool _tec_profile_start(void);
+void _tec_profile_begin(size_t test_index);
+void _tec_profile_mark(void);
+void _tec_profile_end(void);
+size_t _tec_profile_write(void);
+void _tec_bench_measure(tec_func_t body, tec_bench_point_t *point);
+bool _tec_bench_throughput(tec_func_t body, size_t threads,
+                           tec_bench_throughput_t *out, JUMP_CODES *failed);
+void _tec_bench_end(void);
+void _tec_fork_context(tec_context_t *context);
+void _tec_merge_context(const tec_context_t *context);
+void _tec_raise(JUMP_CODES result) TEC_FUCK_MSVC_EH;
+void _tec_concurrent_body(void) TEC_FUCK_MSVC_EH;
+#ifdef TEC_HAVE_ASYNC
+void _tec_async_body(void) TEC_FUCK_MSVC_EH;
+void _tec_async_start(void *root);
+void _tec_async_sleep(uint64_t ns, void *handle);
+int _tec_async_wait_fd(int fd, uint32_t events, void *handle);
+void _tec_async_wait_failed(int fd, int error) TEC_FUCK_MSVC_EH;
+bool _tec_async_elapsed(const tec_entry_t *test, uint64_t *wall_ns,
+                        uint64_t *cpu_ns);
+#endif
+bool _tec_expect_complexity(tec_complexity bound, int line);
+const char *tec_complexity_name(tec_complexity c);
+bool _tec_stdout_check(const char *expected, bool exact, const char *expr,
+                       int line);
+bool _tec_death_check(int expected, const char *stderr_regex,
+                      const char *statement, int line);
+#ifndef _WIN32
+bool _tec_signals_install(void);
+void _tec_signals_uninstall(void);
+#endif
 
 extern tec_context_t tec_context;
+/*
+ * the context that assertions on the calling thread write to: tec_context
+ * itself, except on TEC_CONCURRENT and TEC_BENCH_THREADS workers, which each
+ * get a private copy.
+ */
+extern TEC_THREAD_LOCAL tec_context_t *_tec_thread_context;
+#define _TEC_CTX (*_tec_thread_context)
 extern char tec_fail_prefix[TEC_PREFIX_SIZE];
 extern char tec_pass_prefix[TEC_PREFIX_SIZE];
 extern char tec_skip_prefix[TEC_PREFIX_SIZE];
 extern char tec_line_prefix[TEC_PREFIX_SIZE];
 
+// size of the current step of a TEC_BENCH_RANGE sweep.
+static inline size_t tec_bench_n(void) { return tec_context.bench.n; }
+
+extern TEC_THREAD_LOCAL size_t _tec_thread_index;
+
+// index of the calling worker in a TEC_BENCH_THREADS run, 0 elsewhere.
+static inline size_t tec_bench_thread_id(void) { return _tec_thread_index; }
+
+// index of the calling worker in a TEC_CONCURRENT test, 0 elsewhere.
+static inline size_t tec_concurrent_thread_id(void) {
+    return _tec_thread_index;
+}
+
+static inline unsigned _tec_msb64(uint64_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+    return 63u - (unsigned)__builtin_clzll(v);
+#else
+    unsigned msb = 0;
+    while (v >>= 1)
+        msb++;
+    return msb;
+#endif
+}
+
+static inline size_t _tec_latency_bucket(uint64_t ns) {
+    if (ns < TEC_LATENCY_SUB_COUNT)
+        return (size_t)ns;
+    unsigned shift = _tec_msb64(ns) - (TEC_LATENCY_SUB_BITS - 1);
+    return (size_t)shift * TEC_LATENCY_HALF_COUNT + (size_t)(ns >> shift);
+}
+
+// hot path: one bit scan, one shift and a handful of adds, no branches on
+// the bucket layout.
+static inline void tec_latency_record(tec_latency_recorder *rec, uint64_t ns) {
+    if (rec->count == 0 || ns < rec->min)
+        rec->min = ns;
+    if (ns > rec->max)
+        rec->max = ns;
+    rec->count++;
+    rec->sum += ns;
+    rec->buckets[_tec_latency_bucket(ns)]++;
+}
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -176,40 +597,313 @@ extern char tec_line_prefix[TEC_PREFIX_SIZE];
 #define TEC_AUTO_TYPE __auto_type
 #endif
 
+/*
+ * _TEC_FLOAT_KIND(x) is TEC_KIND_FLOAT or TEC_KIND_DOUBLE for those types and
+ * 0 for anything else, as a constant expression. Picking a path by sizeof
+ * would take int32_t for float and int64_t for double.
+ */
+#define TEC_KIND_FLOAT 1
+#define TEC_KIND_DOUBLE 2
+#ifdef __cplusplus
+template <typename T> struct _tec_float_kind {
+    enum { value = 0 };
+};
+template <> struct _tec_float_kind<float> {
+    enum { value = TEC_KIND_FLOAT };
+};
+template <> struct _tec_float_kind<double> {
+    enum { value = TEC_KIND_DOUBLE };
+};
+#define _TEC_FLOAT_KIND(x)                                                     \
+    ((int)_tec_float_kind<typename std::remove_cv<                             \
+         typename std::remove_reference<decltype(x)>::type>::type>::value)
+#define _TEC_STATIC_ASSERT(condition, message) static_assert(condition, message)
+#else
+#define _TEC_FLOAT_KIND(x)                                                     \
+    _Generic((x), float: TEC_KIND_FLOAT, double: TEC_KIND_DOUBLE, default: 0)
+#define _TEC_STATIC_ASSERT(condition, message)                                 \
+    _Static_assert(condition, message)
+#endif
+
 #ifdef __cplusplus
-class tec_assertion_failure : public std::runtime_error {
+// msg is the context's failure_message, which outlives the throw.
+class tec_assertion_failure : public std::exception {
+  public:
+    tec_assertion_failure(const char *msg) : message(msg) {}
+    const char *what() const noexcept override { return message; }
+
+  private:
+    const char *message;
+};
+class tec_skip_test : public std::exception {
   public:
-    tec_assertion_failure(const char *msg) : std::runtime_error(msg) {}
+    tec_skip_test(const char *msg) : message(msg) {}
+    const char *what() const noexcept override { return message; }
+
+  private:
+    const char *message;
+};
+
+// lets standard containers in a test body allocate from tec_arena_alloc().
+template <typename T> struct tec_arena_allocator {
+    using value_type = T;
+
+    tec_arena_allocator() noexcept {}
+    template <typename U>
+    tec_arena_allocator(const tec_arena_allocator<U> &) noexcept {}
+
+    T *allocate(size_t n) {
+        if (n > SIZE_MAX / sizeof(T))
+            throw std::bad_array_new_length();
+        void *p = tec_arena_alloc(n * sizeof(T), alignof(T));
+        if (p == nullptr)
+            throw std::bad_alloc();
+        return static_cast<T *>(p);
+    }
+    void deallocate(T *, size_t) noexcept {} // freed when the test ends
+};
+
+template <typename T, typename U>
+bool operator==(const tec_arena_allocator<T> &,
+                const tec_arena_allocator<U> &) noexcept {
+    return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const tec_arena_allocator<T> &,
+                const tec_arena_allocator<U> &) noexcept {
+    return false;
+}
+#endif
+
+#ifdef TEC_HAVE_ASYNC
+/*
+ * TEC_ASYNC bodies are coroutines returning tec_task<>. A task does not start
+ * until it is awaited (a test body: until the runner starts it), and when it
+ * finishes it resumes its awaiter, rethrowing anything that escaped it.
+ * tec_task<T> hands a default-constructible T to its awaiter.
+ */
+template <typename T = void> class tec_task;
+
+struct _tec_task_promise_base {
+    std::coroutine_handle<> continuation;
+    std::exception_ptr error;
+
+    struct final_awaiter {
+        bool await_ready() noexcept { return false; }
+        template <typename P>
+        std::coroutine_handle<>
+        await_suspend(std::coroutine_handle<P> done) noexcept {
+            std::coroutine_handle<> next = done.promise().continuation;
+            return next ? next : std::noop_coroutine();
+        }
+        void await_resume() noexcept {}
+    };
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    final_awaiter final_suspend() noexcept { return {}; }
+    void unhandled_exception() { error = std::current_exception(); }
+};
+
+template <typename T> struct _tec_task_promise : _tec_task_promise_base {
+    T value{};
+    tec_task<T> get_return_object();
+    void return_value(T result) { value = std::move(result); }
+};
+
+template <> struct _tec_task_promise<void> : _tec_task_promise_base {
+    tec_task<void> get_return_object();
+    void return_void() {}
 };
-class tec_skip_test : public std::runtime_error {
+
+template <typename T> class tec_task {
   public:
-    tec_skip_test(const char *msg) : std::runtime_error(msg) {}
+    using promise_type = _tec_task_promise<T>;
+
+    explicit tec_task(std::coroutine_handle<promise_type> h) : handle(h) {}
+    tec_task(tec_task &&other) noexcept : handle(other.handle) {
+        other.handle = nullptr;
+    }
+    tec_task(const tec_task &) = delete;
+    tec_task &operator=(const tec_task &) = delete;
+    ~tec_task() {
+        if (handle)
+            handle.destroy();
+    }
+
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<>
+    await_suspend(std::coroutine_handle<> awaiter) noexcept {
+        handle.promise().continuation = awaiter;
+        return handle;
+    }
+    T await_resume() {
+        if (handle.promise().error)
+            std::rethrow_exception(handle.promise().error);
+        if constexpr (std::is_void_v<T>)
+            return;
+        else
+            return std::move(handle.promise().value);
+    }
+
+    // gives the coroutine frame to the runner, which destroys it.
+    void *release() noexcept {
+        void *frame = handle.address();
+        handle = nullptr;
+        return frame;
+    }
+
+  private:
+    std::coroutine_handle<promise_type> handle;
+};
+
+template <typename T> tec_task<T> _tec_task_promise<T>::get_return_object() {
+    return tec_task<T>(
+        std::coroutine_handle<_tec_task_promise<T>>::from_promise(*this));
+}
+
+inline tec_task<void> _tec_task_promise<void>::get_return_object() {
+    return tec_task<void>(
+        std::coroutine_handle<_tec_task_promise<void>>::from_promise(*this));
+}
+
+struct tec_sleep_awaiter {
+    uint64_t ns;
+    bool await_ready() const noexcept { return ns == 0; }
+    void await_suspend(std::coroutine_handle<> h) {
+        _tec_async_sleep(ns, h.address());
+    }
+    void await_resume() const noexcept {}
+};
+
+struct tec_fd_awaiter {
+    int fd;
+    uint32_t events;
+    int error;
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<> h) noexcept {
+        error = _tec_async_wait_fd(fd, events, h.address());
+        return error == 0;
+    }
+    void await_resume() TEC_FUCK_MSVC_EH {
+        if (error != 0)
+            _tec_async_wait_failed(fd, error);
+    }
 };
+
+// co_await these inside a TEC_ASYNC body or a tec_task it awaits.
+inline tec_sleep_awaiter tec_sleep_ns(uint64_t ns) { return {ns}; }
+inline tec_sleep_awaiter tec_sleep_ms(uint64_t ms) { return {ms * 1000000}; }
+inline tec_fd_awaiter tec_readable(int fd) { return {fd, EPOLLIN, 0}; }
+inline tec_fd_awaiter tec_writable(int fd) { return {fd, EPOLLOUT, 0}; }
 #endif
 
 #ifdef __cplusplus
-/* FUCK STRINGSTREAM.
- * We know the "right" way to do this is with std::format from C++20.
- * BUT, that would force every poor bastard using this library to add
- * `-std=c++20`, since most compilers still default to older standards.
- * So, for maximum drop-in compatibility, we're stuck with this slow-ass thing.
- * It's a shit trade-off, but it makes the library easier to use.
+/* FUCK STRINGSTREAM, part two.
+ * Pulling <sstream> into every test file cost more compile time than the tests
+ * themselves, so values are printed straight into the format slot instead.
+ * Built-in types, C strings and anything with a c_str() (std::string) go
+ * through snprintf and print what a std::ostream would. Everything else falls
+ * back to its operator<<, but the stream code is a template on the character
+ * type: only files asserting on such a type instantiate it, and only they
+ * need <ostream>.
  */
-template <typename T> std::string tec_to_string(const T &value) {
-    std::stringstream ss;
-    ss << value;
-    return ss.str();
+inline void _tec_format(char *buf, size_t size, bool value) {
+    snprintf(buf, size, "%d", value ? 1 : 0);
+}
+inline void _tec_format(char *buf, size_t size, char value) {
+    snprintf(buf, size, "%c", value);
 }
-inline std::string tec_to_string(const char *value) {
+inline void _tec_format(char *buf, size_t size, signed char value) {
+    snprintf(buf, size, "%c", (char)value);
+}
+inline void _tec_format(char *buf, size_t size, unsigned char value) {
+    snprintf(buf, size, "%c", (char)value);
+}
+inline void _tec_format(char *buf, size_t size, short value) {
+    snprintf(buf, size, "%d", value);
+}
+inline void _tec_format(char *buf, size_t size, unsigned short value) {
+    snprintf(buf, size, "%u", value);
+}
+inline void _tec_format(char *buf, size_t size, int value) {
+    snprintf(buf, size, "%d", value);
+}
+inline void _tec_format(char *buf, size_t size, unsigned value) {
+    snprintf(buf, size, "%u", value);
+}
+inline void _tec_format(char *buf, size_t size, long value) {
+    snprintf(buf, size, "%ld", value);
+}
+inline void _tec_format(char *buf, size_t size, unsigned long value) {
+    snprintf(buf, size, "%lu", value);
+}
+inline void _tec_format(char *buf, size_t size, long long value) {
+    snprintf(buf, size, "%lld", value);
+}
+inline void _tec_format(char *buf, size_t size, unsigned long long value) {
+    snprintf(buf, size, "%llu", value);
+}
+inline void _tec_format(char *buf, size_t size, float value) {
+    snprintf(buf, size, "%g", (double)value);
+}
+inline void _tec_format(char *buf, size_t size, double value) {
+    snprintf(buf, size, "%g", value);
+}
+inline void _tec_format(char *buf, size_t size, long double value) {
+    snprintf(buf, size, "%Lg", value);
+}
+inline void _tec_format(char *buf, size_t size, const char *value) {
     if (value == NULL)
-        return "(null)";
-    return "\"" + std::string(value) + "\"";
+        snprintf(buf, size, "(null)");
+    else
+        snprintf(buf, size, "\"%s\"", value);
 }
-inline std::string tec_to_string(char *value) {
-    return tec_to_string(const_cast<const char *>(value));
+inline void _tec_format(char *buf, size_t size, char *value) {
+    _tec_format(buf, size, const_cast<const char *>(value));
+}
+inline void _tec_format(char *buf, size_t size, decltype(nullptr)) {
+    snprintf(buf, size, "nullptr");
+}
+template <typename T> void _tec_format(char *buf, size_t size, T *value) {
+    snprintf(buf, size, "%p", (const void *)value);
 }
-#define TEC_FMT(x, buf)                                                        \
-    snprintf((buf), TEC_FMT_SLOT_SIZE, "%s", tec_to_string(x).c_str())
+
+// enums print as their value, the way a stream prints an unscoped one.
+template <typename T>
+typename std::enable_if<std::is_enum<T>::value>::type
+_tec_format_other(char *buf, size_t size, const T &value, int) {
+    _tec_format(buf, size,
+                +static_cast<typename std::underlying_type<T>::type>(value));
+}
+template <typename T>
+auto _tec_format_other(char *buf, size_t size, const T &value, int)
+    -> decltype((const char *)value.c_str(), void()) {
+    snprintf(buf, size, "%s", (const char *)value.c_str());
+}
+
+template <typename Char>
+class _tec_format_sink : public std::basic_streambuf<Char> {
+  public:
+    _tec_format_sink(Char *buf, size_t size) {
+        this->setp(buf, buf + size - 1);
+    }
+    void finish() { *this->pptr() = Char(); }
+};
+// instantiating this needs <ostream>; operator<< for T should have it.
+template <typename Char, typename T>
+void _tec_format_other(Char *buf, size_t size, const T &value, long) {
+    _tec_format_sink<Char> sink(buf, size);
+    std::basic_ostream<Char> out(&sink);
+    out << value;
+    sink.finish();
+}
+
+template <typename T>
+void _tec_format(char *buf, size_t size, const T &value) {
+    _tec_format_other(buf, size, value, 0);
+}
+#define TEC_FMT(x, buf) _tec_format((buf), TEC_FMT_SLOT_SIZE, (x))
 
 #define TEC_TRY_BLOCK(code)                                                    \
     try {                                                                      \
@@ -225,17 +919,17 @@ inline std::string tec_to_string(char *value) {
 
 /*
  * #define TEC_TRY_BLOCK                                                       \
- *     for (int _tec_loop_once = (tec_context.jump_set = true, 1);             \
- *          _tec_loop_once && setjmp(tec_context.jump_buffer) == 0;            \
- *          _tec_loop_once = 0, tec_context.jump_set = false)
+ *     for (int _tec_loop_once = (_TEC_CTX.jump_set = true, 1);                \
+ *          _tec_loop_once && setjmp(_TEC_CTX.jump_buffer) == 0;               \
+ *          _tec_loop_once = 0, _TEC_CTX.jump_set = false)
  */
 #define TEC_TRY_BLOCK(code)                                                    \
     do {                                                                       \
-        tec_context.jump_set = true;                                           \
-        if (setjmp(tec_context.jump_buffer) == 0) {                            \
+        _TEC_CTX.jump_set = true;                                              \
+        if (setjmp(_TEC_CTX.jump_buffer) == 0) {                               \
             code                                                               \
         }                                                                      \
-        tec_context.jump_set = false;                                          \
+        _TEC_CTX.jump_set = false;                                             \
     } while (0)
 
 /*
@@ -321,18 +1015,18 @@ inline std::string tec_to_string(char *value) {
 
 #define TEC_POST_PASS()                                                        \
     do {                                                                       \
-        tec_context.current_passed++;                                          \
-        tec_context.stats.passed_assertions++;                                 \
+        _TEC_CTX.current_passed++;                                             \
+        _TEC_CTX.stats.passed_assertions++;                                    \
     } while (0);
 
 #define TEC_SKIP(reason) _tec_skip_impl(reason, __LINE__)
 
 #define TEC_ASSERT(condition)                                                  \
     do {                                                                       \
-        tec_context.stats.total_assertions++;                                  \
+        _TEC_CTX.stats.total_assertions++;                                     \
         TEC_AUTO_TYPE _tec_cond_result = (condition);                          \
         if (!(_tec_cond_result)) {                                             \
-            snprintf(tec_context.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN, \
+            snprintf(_TEC_CTX.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,    \
                      TEC_PRE_SPACE "%sAssertion failed: %s (line %d)\n",       \
                      tec_fail_prefix, #condition, __LINE__);                   \
             TEC_POST_FAIL();                                                   \
@@ -343,10 +1037,10 @@ inline std::string tec_to_string(char *value) {
 
 #define TEC_ASSERT_TRUE(condition)                                             \
     do {                                                                       \
-        tec_context.stats.total_assertions++;                                  \
+        _TEC_CTX.stats.total_assertions++;                                     \
         TEC_AUTO_TYPE _cond = (condition);                                     \
         if (!(_cond)) {                                                        \
-            snprintf(tec_context.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN, \
+            snprintf(_TEC_CTX.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,    \
                      TEC_PRE_SPACE "%sExpected %s to be true (line %d)\n",     \
                      tec_fail_prefix, #condition, __LINE__);                   \
             TEC_POST_FAIL();                                                   \
@@ -357,10 +1051,10 @@ inline std::string tec_to_string(char *value) {
 
 #define TEC_ASSERT_FALSE(condition)                                            \
     do {                                                                       \
-        tec_context.stats.total_assertions++;                                  \
+        _TEC_CTX.stats.total_assertions++;                                     \
         TEC_AUTO_TYPE _cond = (condition);                                     \
         if ((_cond)) {                                                         \
-            snprintf(tec_context.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN, \
+            snprintf(_TEC_CTX.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,    \
                      TEC_PRE_SPACE "%sExpected %s to be false (line %d)\n",    \
                      tec_fail_prefix, #condition, __LINE__);                   \
             TEC_POST_FAIL();                                                   \
@@ -371,17 +1065,17 @@ inline std::string tec_to_string(char *value) {
 
 #define TEC_ASSERT_EQ(a, b)                                                    \
     do {                                                                       \
-        tec_context.stats.total_assertions++;                                  \
+        _TEC_CTX.stats.total_assertions++;                                     \
         TEC_AUTO_TYPE _a = a;                                                  \
         TEC_AUTO_TYPE _b = b;                                                  \
         if ((_a) != (_b)) {                                                    \
-            TEC_FMT(_a, tec_context.format_bufs[0]);                           \
-            TEC_FMT(_b, tec_context.format_bufs[1]);                           \
-            snprintf(tec_context.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN, \
+            TEC_FMT(_a, _TEC_CTX.format_bufs[0]);                              \
+            TEC_FMT(_b, _TEC_CTX.format_bufs[1]);                              \
+            snprintf(_TEC_CTX.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,    \
                      TEC_PRE_SPACE                                             \
                      "%sExpected %s == %s, got %s != %s (line %d)\n",          \
-                     tec_fail_prefix, #a, #b, tec_context.format_bufs[0],      \
-                     tec_context.format_bufs[1], __LINE__);                    \
+                     tec_fail_prefix, #a, #b, _TEC_CTX.format_bufs[0],         \
+                     _TEC_CTX.format_bufs[1], __LINE__);                       \
             TEC_POST_FAIL();                                                   \
         } else {                                                               \
             TEC_POST_PASS();                                                   \
@@ -390,15 +1084,15 @@ inline std::string tec_to_string(char *value) {
 
 #define TEC_ASSERT_NE(a, b)                                                    \
     do {                                                                       \
-        tec_context.stats.total_assertions++;                                  \
+        _TEC_CTX.stats.total_assertions++;                                     \
         TEC_AUTO_TYPE _a = a;                                                  \
         TEC_AUTO_TYPE _b = b;                                                  \
         if ((_a) == (_b)) {                                                    \
-            TEC_FMT(_a, tec_context.format_bufs[0]);                           \
-            snprintf(tec_context.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN, \
+            TEC_FMT(_a, _TEC_CTX.format_bufs[0]);                              \
+            snprintf(_TEC_CTX.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,    \
                      TEC_PRE_SPACE                                             \
                      "%sExpected %s != %s, but both are %s (line %d)\n",       \
-                     tec_fail_prefix, #a, #b, tec_context.format_bufs[0],      \
+                     tec_fail_prefix, #a, #b, _TEC_CTX.format_bufs[0],         \
                      __LINE__);                                                \
             TEC_POST_FAIL();                                                   \
         } else {                                                               \
@@ -408,13 +1102,13 @@ inline std::string tec_to_string(char *value) {
 
 #define TEC_ASSERT_NEAR(a, b, tolerance)                                       \
     do {                                                                       \
-        tec_context.stats.total_assertions++;                                  \
+        _TEC_CTX.stats.total_assertions++;                                     \
         TEC_AUTO_TYPE _a = (a);                                                \
         TEC_AUTO_TYPE _b = (b);                                                \
         TEC_AUTO_TYPE _tol = (tolerance);                                      \
         TEC_AUTO_TYPE _diff = _TEC_FABS((double)_a - (double)_b);              \
         if (_diff > (double)_tol) {                                            \
-            snprintf(tec_context.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN, \
+            snprintf(_TEC_CTX.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,    \
                      TEC_PRE_SPACE                                             \
                      "%sNearness assertion failed (line %d)\n" TEC_PRE_SPACE   \
                      "%sExpected: %s and %s to be within %g\n" TEC_PRE_SPACE   \
@@ -429,14 +1123,14 @@ inline std::string tec_to_string(char *value) {
 
 #define TEC_ASSERT_FLOAT_EQ(a, b)                                              \
     do {                                                                       \
-        tec_context.stats.total_assertions++;                                  \
+        _TEC_CTX.stats.total_assertions++;                                     \
         TEC_AUTO_TYPE _a = (a);                                                \
         TEC_AUTO_TYPE _b = (b);                                                \
         double _default_tol = DBL_EPSILON * 4.0;                               \
         double _diff = _TEC_FABS((double)_a - (double)_b);                     \
         if (_diff > _default_tol) {                                            \
             snprintf(                                                          \
-                tec_context.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,      \
+                _TEC_CTX.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,         \
                 TEC_PRE_SPACE                                                  \
                 "%sFloating point equality failed (line %d)\n" TEC_PRE_SPACE   \
                 "%sExpected: %s == %s\n" TEC_PRE_SPACE                         \
@@ -452,15 +1146,94 @@ inline std::string tec_to_string(char *value) {
         }                                                                      \
     } while (0)
 
+/*
+ * Units-in-the-last-place comparison: scale-free, so the same `max_ulps` works
+ * for 1e-300 and 1e300. Float operands are compared as float, anything else as
+ * double. NaN is never equal to anything.
+ */
+#define TEC_ASSERT_ULP_EQ(a, b, max_ulps)                                      \
+    do {                                                                       \
+        _TEC_CTX.stats.total_assertions++;                                     \
+        TEC_AUTO_TYPE _a = (a);                                                \
+        TEC_AUTO_TYPE _b = (b);                                                \
+        uint64_t _max_ulps = (uint64_t)(max_ulps);                             \
+        uint64_t _ulps = _TEC_FLOAT_KIND(_a) == TEC_KIND_FLOAT                 \
+                             ? tec_ulp_distance_f32((float)_a, (float)_b)      \
+                             : tec_ulp_distance_f64((double)_a, (double)_b);   \
+        if (_ulps > _max_ulps) {                                               \
+            snprintf(_TEC_CTX.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,    \
+                     TEC_PRE_SPACE                                             \
+                     "%sULP equality failed (line %d)\n" TEC_PRE_SPACE         \
+                     "%sExpected: %s == %s within %" PRIu64                    \
+                     " ULPs\n" TEC_PRE_SPACE                                   \
+                     "%sActual:   %.17g and %.17g are %" PRIu64                \
+                     " ULPs apart\n",                                          \
+                     tec_fail_prefix, __LINE__, tec_line_prefix, #a, #b,       \
+                     _max_ulps, tec_line_prefix, (double)_a, (double)_b,       \
+                     _ulps);                                                   \
+            TEC_POST_FAIL();                                                   \
+        } else {                                                               \
+            TEC_POST_PASS();                                                   \
+        }                                                                      \
+    } while (0)
+
+// passes when |a - b| <= max(abs_tol, rel_tol * max(|a|, |b|)).
+#define TEC_ASSERT_NEAR_REL(a, b, rel_tol, abs_tol)                            \
+    do {                                                                       \
+        _TEC_CTX.stats.total_assertions++;                                     \
+        double _a = (double)(a);                                               \
+        double _b = (double)(b);                                               \
+        double _rel = (double)(rel_tol);                                       \
+        double _abs = (double)(abs_tol);                                       \
+        double _diff = _TEC_FABS(_a - _b);                                     \
+        double _scale = _TEC_FABS(_a) > _TEC_FABS(_b) ? _TEC_FABS(_a)          \
+                                                      : _TEC_FABS(_b);         \
+        double _allowed = _rel * _scale > _abs ? _rel * _scale : _abs;         \
+        if (!(_diff <= _allowed)) {                                            \
+            snprintf(_TEC_CTX.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,    \
+                     TEC_PRE_SPACE                                             \
+                     "%sRelative nearness failed (line %d)\n" TEC_PRE_SPACE    \
+                     "%sExpected: %s and %s within rel %g / abs %g\n"          \
+                     TEC_PRE_SPACE "%sActual:   %.17g and %.17g differ by %g " \
+                     "(allowed %g)\n",                                         \
+                     tec_fail_prefix, __LINE__, tec_line_prefix, #a, #b, _rel, \
+                     _abs, tec_line_prefix, _a, _b, _diff, _allowed);          \
+            TEC_POST_FAIL();                                                   \
+        } else {                                                               \
+            TEC_POST_PASS();                                                   \
+        }                                                                      \
+    } while (0)
+
+/*
+ * Element-wise |a[i] - b[i]| <= tol over `n` floats or doubles. The common
+ * all-good case is a single branch-free pass the compiler can vectorize; the
+ * max error, its index and an error histogram are only computed on failure.
+ * Any other element type, integers included, is a compile error.
+ */
+#define TEC_ASSERT_ARRAY_NEAR(a, b, n, tol)                                    \
+    do {                                                                       \
+        _TEC_STATIC_ASSERT(_TEC_FLOAT_KIND(*(a)) != 0 &&                       \
+                               _TEC_FLOAT_KIND(*(a)) == _TEC_FLOAT_KIND(*(b)), \
+                           "TEC_ASSERT_ARRAY_NEAR needs two float or two "     \
+                           "double arrays");                                   \
+        _TEC_CTX.stats.total_assertions++;                                     \
+        if (!_tec_array_near((a), (b), (size_t)(n), _TEC_FLOAT_KIND(*(a)),     \
+                             (double)(tol), #a, #b, __LINE__)) {               \
+            TEC_POST_FAIL();                                                   \
+        } else {                                                               \
+            TEC_POST_PASS();                                                   \
+        }                                                                      \
+    } while (0)
+
 #define TEC_ASSERT_STR_EQ(a, b)                                                \
     do {                                                                       \
-        tec_context.stats.total_assertions++;                                  \
+        _TEC_CTX.stats.total_assertions++;                                     \
         const char *_a = (a);                                                  \
         const char *_b = (b);                                                  \
         int equal =                                                            \
             ((_a == NULL && _b == NULL) || (_a && _b && strcmp(_a, _b) == 0)); \
         if (!equal) {                                                          \
-            snprintf(tec_context.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN, \
+            snprintf(_TEC_CTX.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,    \
                      TEC_PRE_SPACE                                             \
                      "%sExpected strings equal: \"%s\" != \"%s\" (line %d)\n", \
                      tec_fail_prefix, (_a ? _a : "(null)"),                    \
@@ -471,12 +1244,120 @@ inline std::string tec_to_string(char *value) {
         }                                                                      \
     } while (0)
 
+/*
+ * Line-oriented comparison for big multi-line strings. On failure the message
+ * holds a unified-diff view of the changed lines instead of both payloads.
+ */
+#define TEC_ASSERT_TEXT_EQ(a, b)                                               \
+    do {                                                                       \
+        _TEC_CTX.stats.total_assertions++;                                     \
+        const char *_a = (a);                                                  \
+        const char *_b = (b);                                                  \
+        if (!_tec_text_eq(_a, _b, #a, #b, __LINE__)) {                         \
+            TEC_POST_FAIL();                                                   \
+        } else {                                                               \
+            TEC_POST_PASS();                                                   \
+        }                                                                      \
+    } while (0)
+
+/*
+ * Compares `len` bytes at `data` against a golden file stored next to the test
+ * source, under __snapshots__/<suite>/<name>.snap. Run the binary with
+ * --update-snapshots to record missing goldens or accept changed ones.
+ */
+#define TEC_ASSERT_SNAPSHOT(name, data, len)                                   \
+    do {                                                                       \
+        _TEC_CTX.stats.total_assertions++;                                     \
+        if (!_tec_snapshot_check((name), (const void *)(data), (size_t)(len),  \
+                                 __LINE__)) {                                  \
+            TEC_POST_FAIL();                                                   \
+        } else {                                                               \
+            TEC_POST_PASS();                                                   \
+        }                                                                      \
+    } while (0)
+
+/*
+ * Asserts that the `pct` percentile of a tec_latency_recorder is at most
+ * `budget_ns` nanoseconds. The recorder's percentiles are also listed under
+ * the test's result line.
+ */
+#define TEC_ASSERT_PERCENTILE_LE(rec, pct, budget_ns)                          \
+    do {                                                                       \
+        _TEC_CTX.stats.total_assertions++;                                     \
+        if (!_tec_percentile_le(&(rec), #rec, (double)(pct),                   \
+                                (uint64_t)(budget_ns), __LINE__)) {            \
+            TEC_POST_FAIL();                                                   \
+        } else {                                                               \
+            TEC_POST_PASS();                                                   \
+        }                                                                      \
+    } while (0)
+
+/*
+ * Asserts that `statement` ends the process: `expected` is TEC_DEATH_EXIT(n),
+ * TEC_DEATH_SIGNAL(sig) or TEC_DEATH_ANY, and stderr must match the extended
+ * regex `stderr_regex` (NULL or "" to skip the check). The statement runs in
+ * a child of a fork server started before the first test; the child replays
+ * the test up to this assertion, so the code before it must be repeatable.
+ */
+#define TEC_ASSERT_DEATH(statement, expected, stderr_regex)                    \
+    do {                                                                       \
+        _TEC_CTX.stats.total_assertions++;                                     \
+        int _tec_mode = _tec_death_enter();                                    \
+        if (_tec_mode == TEC_DEATH_RUN) {                                      \
+            statement;                                                         \
+            _tec_death_survived();                                             \
+        } else if (_tec_mode == TEC_DEATH_SKIP ||                              \
+                   _tec_death_check((expected), (stderr_regex), #statement,    \
+                                    __LINE__)) {                               \
+            TEC_POST_PASS();                                                   \
+        } else {                                                               \
+            TEC_POST_FAIL();                                                   \
+        }                                                                      \
+    } while (0)
+
+/*
+ * Check what the test wrote to stdout so far; needs --capture. The captured
+ * bytes are compared in place, without copying them.
+ */
+#define TEC_ASSERT_STDOUT_CONTAINS(needle)                                     \
+    do {                                                                       \
+        _TEC_CTX.stats.total_assertions++;                                     \
+        if (!_tec_stdout_check((needle), false, #needle, __LINE__)) {          \
+            TEC_POST_FAIL();                                                   \
+        } else {                                                               \
+            TEC_POST_PASS();                                                   \
+        }                                                                      \
+    } while (0)
+
+#define TEC_ASSERT_STDOUT_EQ(expected)                                         \
+    do {                                                                       \
+        _TEC_CTX.stats.total_assertions++;                                     \
+        if (!_tec_stdout_check((expected), true, #expected, __LINE__)) {       \
+            TEC_POST_FAIL();                                                   \
+        } else {                                                               \
+            TEC_POST_PASS();                                                   \
+        }                                                                      \
+    } while (0)
+
+/*
+ * In a TEC_BENCH_RANGE body: once the sweep is done, its best-fit complexity
+ * must be `bound` (O_1, O_LOG_N, O_N, O_N_LOG_N or O_N2) or better.
+ */
+#define TEC_ASSERT_COMPLEXITY_LE(bound)                                        \
+    do {                                                                       \
+        if (!tec_context.bench.has_bound &&                                    \
+            !_tec_expect_complexity(TEC_##bound, __LINE__)) {                  \
+            _TEC_CTX.stats.total_assertions++;                                 \
+            TEC_POST_FAIL();                                                   \
+        }                                                                      \
+    } while (0)
+
 #define TEC_ASSERT_NULL(ptr)                                                   \
     do {                                                                       \
-        tec_context.stats.total_assertions++;                                  \
+        _TEC_CTX.stats.total_assertions++;                                     \
         const void *_ptr = ptr;                                                \
         if ((_ptr) != NULL) {                                                  \
-            snprintf(tec_context.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN, \
+            snprintf(_TEC_CTX.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,    \
                      TEC_PRE_SPACE                                             \
                      "%sExpected %s to be NULL, got %p (line %d)\n",           \
                      tec_fail_prefix, #ptr, (const void *)(_ptr), __LINE__);   \
@@ -488,10 +1369,10 @@ inline std::string tec_to_string(char *value) {
 
 #define TEC_ASSERT_NOT_NULL(ptr)                                               \
     do {                                                                       \
-        tec_context.stats.total_assertions++;                                  \
+        _TEC_CTX.stats.total_assertions++;                                     \
         const void *_ptr = ptr;                                                \
         if ((_ptr) == NULL) {                                                  \
-            snprintf(tec_context.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN, \
+            snprintf(_TEC_CTX.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,    \
                      TEC_PRE_SPACE "%sExpected %s to not be NULL (line %d)\n", \
                      tec_fail_prefix, #ptr, __LINE__);                         \
             TEC_POST_FAIL();                                                   \
@@ -502,9 +1383,9 @@ inline std::string tec_to_string(char *value) {
 
 #define TEC_ASSERT_FUNC_NOT_NULL(fn)                                           \
     do {                                                                       \
-        tec_context.stats.total_assertions++;                                  \
+        _TEC_CTX.stats.total_assertions++;                                     \
         if ((fn) == NULL) {                                                    \
-            snprintf(tec_context.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN, \
+            snprintf(_TEC_CTX.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,    \
                      TEC_PRE_SPACE                                             \
                      "%sExpected function %s to not be NULL (line %d)\n",      \
                      tec_fail_prefix, #fn, __LINE__);                          \
@@ -521,22 +1402,22 @@ inline std::string tec_to_string(char *value) {
 
 #define _TEC_ASSERT_OP(a, b, op)                                               \
     do {                                                                       \
-        tec_context.stats.total_assertions++;                                  \
+        _TEC_CTX.stats.total_assertions++;                                     \
         TEC_AUTO_TYPE _a = a;                                                  \
         TEC_AUTO_TYPE _b = b;                                                  \
         if (!(_a op _b)) {                                                     \
-            TEC_FMT(_a, tec_context.format_bufs[0]);                           \
-            TEC_FMT(_b, tec_context.format_bufs[1]);                           \
+            TEC_FMT(_a, _TEC_CTX.format_bufs[0]);                              \
+            TEC_FMT(_b, _TEC_CTX.format_bufs[1]);                              \
             const char *_op_str = #op;                                         \
             const char *_inv_op_str =                                          \
                 (_op_str[0] == '>')   ? ((_op_str[1] == '=') ? "<" : "<=")     \
                 : (_op_str[0] == '<') ? ((_op_str[1] == '=') ? ">" : ">=")     \
                                       : "???";                                 \
             snprintf(                                                          \
-                tec_context.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,      \
+                _TEC_CTX.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,         \
                 TEC_PRE_SPACE "%sExpected %s %s %s, got %s %s %s (line %d)\n", \
-                tec_fail_prefix, #a, _op_str, #b, tec_context.format_bufs[0],  \
-                _inv_op_str, tec_context.format_bufs[1], __LINE__);            \
+                tec_fail_prefix, #a, _op_str, #b, _TEC_CTX.format_bufs[0],     \
+                _inv_op_str, _TEC_CTX.format_bufs[1], __LINE__);               \
             TEC_POST_FAIL();                                                   \
         } else {                                                               \
             TEC_POST_PASS();                                                   \
@@ -546,11 +1427,11 @@ inline std::string tec_to_string(char *value) {
 #ifdef __cplusplus
 #define TEC_ASSERT_THROWS(statement, exception_type)                           \
     do {                                                                       \
-        tec_context.stats.total_assertions++;                                  \
+        _TEC_CTX.stats.total_assertions++;                                     \
         try {                                                                  \
             statement;                                                         \
             snprintf(                                                          \
-                tec_context.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,      \
+                _TEC_CTX.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,         \
                 TEC_PRE_SPACE                                                  \
                 "%sExpected statement `%s` to throw `%s`, but it did not "     \
                 "(line %d).\n",                                                \
@@ -561,7 +1442,7 @@ inline std::string tec_to_string(char *value) {
         } catch (const exception_type &) {                                     \
             TEC_POST_PASS();                                                   \
         } catch (const std::exception &e) {                                    \
-            snprintf(tec_context.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN, \
+            snprintf(_TEC_CTX.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,    \
                      TEC_PRE_SPACE                                             \
                      "%sExpected `%s` to throw `%s`, but it threw a "          \
                      "std::exception with what(): %s (line %d)\n",             \
@@ -569,7 +1450,7 @@ inline std::string tec_to_string(char *value) {
                      __LINE__);                                                \
             TEC_POST_FAIL();                                                   \
         } catch (...) {                                                        \
-            snprintf(tec_context.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN, \
+            snprintf(_TEC_CTX.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,    \
                      TEC_PRE_SPACE                                             \
                      "%sExpected `%s` to throw `%s`, but it threw an unknown " \
                      "exception (line %d).\n",                                 \
@@ -582,16 +1463,113 @@ inline std::string tec_to_string(char *value) {
 #ifdef __cplusplus
 struct tec_auto_register {
     tec_auto_register(const char *suite, const char *name, const char *file,
-                      tec_func_t func, bool xfail) {
-        tec_register(suite, name, file, func, xfail);
+                      tec_func_t func, bool xfail, double budget_ms = 0.0,
+                      double timeout_s = 0.0, bool bench = false,
+                      size_t range_lo = 0, size_t range_hi = 0,
+                      size_t max_threads = 0, bool concurrent = false,
+                      size_t threads = 0, size_t iterations = 0,
+                      bool async = false, bool virtual_time = false,
+                      bool compile_time = false) {
+        tec_entry_t *entry = tec_register(suite, name, file, func, xfail);
+        if (entry) {
+            entry->budget_ms = budget_ms;
+            entry->timeout_s = timeout_s;
+            entry->bench = bench;
+            entry->range_lo = range_lo;
+            entry->range_hi = range_hi;
+            entry->max_threads = max_threads;
+            entry->concurrent = concurrent;
+            entry->threads = threads;
+            entry->iterations = iterations;
+            entry->async = async;
+            entry->virtual_time = virtual_time;
+            entry->compile_time = compile_time;
+        }
     }
 };
-struct tec_auto_register_fixture {
-    tec_auto_register_fixture(const char *suite_name, tec_fixture_func_t func,
-                              tec_fixture_type fixture_type) {
-        tec_register_fixture(suite_name, func, fixture_type);
+// "a, std::pair<b, c>" -> "std::pair<b, c>" (length 14) for index 1.
+inline const char *_tec_type_name(const char *list, size_t index,
+                                  int *length) {
+    int depth = 0;
+    const char *start = list;
+    for (const char *c = list;; ++c) {
+        if (*c == '<' || *c == '(' || *c == '[')
+            depth++;
+        else if (*c == '>' || *c == ')' || *c == ']')
+            depth--;
+        if (*c != '\0' && (*c != ',' || depth > 0))
+            continue;
+        if (index-- == 0) {
+            const char *end = c;
+            while (start < end && *start == ' ')
+                start++;
+            while (end > start && end[-1] == ' ')
+                end--;
+            *length = (int)(end - start);
+            return start;
+        }
+        if (*c == '\0') {
+            *length = 0;
+            return c;
+        }
+        start = c + 1;
     }
-};
+}
+
+// TEC_TYPED: registers Test<T>::run once per type, named "name<T>".
+template <template <typename> class Test, typename... Types>
+struct tec_auto_register_typed {
+    char names[sizeof...(Types)][TEC_TMP_STRBUF_LEN];
+
+    tec_auto_register_typed(const char *suite, const char *name,
+                            const char *file, const char *type_list) {
+        size_t index = 0;
+        // a braced list runs the calls in order, one per type.
+        int expand[] = {
+            (add<Types>(suite, name, file, type_list, index), 0)...};
+        (void)expand;
+    }
+
+    template <typename T>
+    void add(const char *suite, const char *name, const char *file,
+             const char *type_list, size_t &index) {
+        int length;
+        const char *type = _tec_type_name(type_list, index, &length);
+        snprintf(names[index], sizeof(names[index]), "%s<%.*s>", name, length,
+                 type);
+        tec_register(suite, names[index], file, &Test<T>::run, false);
+        index++;
+    }
+};
+
+#if defined(__cpp_constexpr) && __cpp_constexpr >= 201304L
+#define TEC_HAVE_CONSTEXPR
+/*
+ * TEC_CONSTEXPR registers tec_constexpr_test<Test>::run, which instantiates
+ * the static_assert below. Compilers instantiate function templates at the
+ * end of the file, after the body it evaluates has been defined, and the
+ * registered function itself is empty.
+ */
+template <typename Test> struct tec_constexpr_test {
+    static void run(void) {
+        static_assert((Test::check(), true), "TEC_CONSTEXPR check failed");
+    }
+};
+
+// not constexpr on purpose: reaching it stops the constant evaluation, and
+// the compiler's note names the check that failed.
+inline void _tec_constexpr_failed(const char *check) { (void)check; }
+#endif
+
+struct tec_auto_register_fixture {
+    tec_auto_register_fixture(const char *suite_name, tec_fixture_func_t func,
+                              tec_fixture_type fixture_type) {
+        tec_register_fixture(suite_name, func, fixture_type);
+    }
+    tec_auto_register_fixture(const char *suite_name, size_t size) {
+        tec_register_fixture_storage(suite_name, size);
+    }
+};
 
 #define TEC(suite_name, test_name)                                             \
     static void tec_##suite_name##_##test_name(void);                          \
@@ -607,6 +1585,68 @@ struct tec_auto_register_fixture {
         true);                                                                 \
     static void tec_##suite_name##_##test_name(void)
 
+#define TEC_BUDGET(suite_name, test_name, max_ms)                              \
+    static void tec_##suite_name##_##test_name(void);                          \
+    static tec_auto_register tec_register_##suite_name##_##test_name(          \
+        #suite_name, #test_name, __FILE__, tec_##suite_name##_##test_name,     \
+        false, (double)(max_ms));                                              \
+    static void tec_##suite_name##_##test_name(void)
+
+#define TEC_TIMEOUT(suite_name, test_name, seconds)                            \
+    static void tec_##suite_name##_##test_name(void);                          \
+    static tec_auto_register tec_register_##suite_name##_##test_name(          \
+        #suite_name, #test_name, __FILE__, tec_##suite_name##_##test_name,     \
+        false, 0.0, (double)(seconds));                                        \
+    static void tec_##suite_name##_##test_name(void)
+
+#define TEC_BENCH(suite_name, test_name)                                       \
+    static void tec_##suite_name##_##test_name(void);                          \
+    static tec_auto_register tec_register_##suite_name##_##test_name(          \
+        #suite_name, #test_name, __FILE__, tec_##suite_name##_##test_name,     \
+        false, 0.0, 0.0, true);                                                \
+    static void tec_##suite_name##_##test_name(void)
+
+#define TEC_BENCH_RANGE(suite_name, test_name, lo, hi)                         \
+    static void tec_##suite_name##_##test_name(void);                          \
+    static tec_auto_register tec_register_##suite_name##_##test_name(          \
+        #suite_name, #test_name, __FILE__, tec_##suite_name##_##test_name,     \
+        false, 0.0, 0.0, true, (size_t)(lo), (size_t)(hi));                    \
+    static void tec_##suite_name##_##test_name(void)
+
+#define TEC_BENCH_THREADS(suite_name, test_name, max)                          \
+    static void tec_##suite_name##_##test_name(void);                          \
+    static tec_auto_register tec_register_##suite_name##_##test_name(          \
+        #suite_name, #test_name, __FILE__, tec_##suite_name##_##test_name,     \
+        false, 0.0, 0.0, true, 0, 0, (size_t)(max));                           \
+    static void tec_##suite_name##_##test_name(void)
+
+#define TEC_CONCURRENT(suite_name, test_name, nthreads, iterations_each)       \
+    static void tec_##suite_name##_##test_name(void);                          \
+    static tec_auto_register tec_register_##suite_name##_##test_name(          \
+        #suite_name, #test_name, __FILE__, tec_##suite_name##_##test_name,     \
+        false, 0.0, 0.0, false, 0, 0, 0, true, (size_t)(nthreads),             \
+        (size_t)(iterations_each));                                            \
+    static void tec_##suite_name##_##test_name(void)
+
+#define TEC_VIRTUAL_TIME(suite_name, test_name)                                \
+    static void tec_##suite_name##_##test_name(void);                          \
+    static tec_auto_register tec_register_##suite_name##_##test_name(          \
+        #suite_name, #test_name, __FILE__, tec_##suite_name##_##test_name,     \
+        false, 0.0, 0.0, false, 0, 0, 0, false, 0, 0, false, true);            \
+    static void tec_##suite_name##_##test_name(void)
+
+#ifdef TEC_HAVE_ASYNC
+#define TEC_ASYNC(suite_name, test_name)                                       \
+    static tec_task<> tec_async_##suite_name##_##test_name(void);              \
+    static void tec_##suite_name##_##test_name(void) {                         \
+        _tec_async_start(tec_async_##suite_name##_##test_name().release());    \
+    }                                                                          \
+    static tec_auto_register tec_register_##suite_name##_##test_name(          \
+        #suite_name, #test_name, __FILE__, tec_##suite_name##_##test_name,     \
+        false, 0.0, 0.0, false, 0, 0, 0, false, 0, 0, true);                   \
+    static tec_task<> tec_async_##suite_name##_##test_name(void)
+#endif
+
 #define _TEC_FIXTURE_FACTORY(suite_name, fixture_type_token,                   \
                              fixture_type_enum)                                \
     static void tec_##fixture_type_token##_##suite_name(void);                 \
@@ -615,6 +1655,58 @@ struct tec_auto_register_fixture {
             #suite_name, tec_##fixture_type_token##_##suite_name,              \
             fixture_type_enum);                                                \
     static void tec_##fixture_type_token##_##suite_name(void)
+
+#define TEC_FIXTURE(suite_name, struct_type)                                   \
+    typedef struct_type tec_fixture_type_##suite_name;                         \
+    static tec_auto_register_fixture tec_register_fixture_##suite_name(        \
+        #suite_name, sizeof(struct_type))
+
+/*
+ * TEC_TYPED(suite, name, types...) instantiates the body once per type, with
+ * the type as `tec_type`, and registers each instance as "name<type>".
+ */
+#define TEC_TYPED(suite_name, test_name, ...)                                  \
+    namespace {                                                                \
+    template <typename tec_type> struct tec_typed_##suite_name##_##test_name { \
+        static void run(void);                                                 \
+    };                                                                         \
+    tec_auto_register_typed<tec_typed_##suite_name##_##test_name, __VA_ARGS__> \
+        tec_register_##suite_name##_##test_name(#suite_name, #test_name,       \
+                                                __FILE__, #__VA_ARGS__);       \
+    }                                                                          \
+    template <typename tec_type>                                               \
+    void tec_typed_##suite_name##_##test_name<tec_type>::run(void)
+
+#ifdef TEC_HAVE_CONSTEXPR
+/*
+ * TEC_CONSTEXPR(suite, name) bodies are constexpr functions the compiler runs
+ * while building the file; a failed TEC_CONSTEXPR_ASSERT is a compile error.
+ * The runner lists them as passed without calling anything.
+ */
+#define TEC_CONSTEXPR(suite_name, test_name)                                   \
+    namespace {                                                                \
+    struct tec_constexpr_##suite_name##_##test_name {                          \
+        static constexpr void check(void);                                     \
+    };                                                                         \
+    tec_auto_register tec_register_##suite_name##_##test_name(                 \
+        #suite_name, #test_name, __FILE__,                                     \
+        tec_constexpr_test<tec_constexpr_##suite_name##_##test_name>::run,     \
+        false, 0.0, 0.0, false, 0, 0, 0, false, 0, 0, false, false, true);     \
+    }                                                                          \
+    constexpr void tec_constexpr_##suite_name##_##test_name::check(void)
+
+#define TEC_CONSTEXPR_ASSERT(condition)                                        \
+    do {                                                                       \
+        if (!(condition))                                                      \
+            _tec_constexpr_failed(#condition);                                 \
+    } while (0)
+
+#define TEC_CONSTEXPR_ASSERT_EQ(a, b)                                          \
+    do {                                                                       \
+        if (!((a) == (b)))                                                     \
+            _tec_constexpr_failed(#a " == " #b);                               \
+    } while (0)
+#endif
 #else
 #define TEC(suite_name, test_name)                                             \
     static void tec_##suite_name##_##test_name(void);                          \
@@ -634,6 +1726,98 @@ struct tec_auto_register_fixture {
     }                                                                          \
     static void tec_##suite_name##_##test_name(void)
 
+#define TEC_BUDGET(suite_name, test_name, max_ms)                              \
+    static void tec_##suite_name##_##test_name(void);                          \
+    static void __attribute__((constructor))                                   \
+    tec_register_##suite_name##_##test_name(void) {                            \
+        tec_entry_t *entry =                                                   \
+            tec_register(#suite_name, #test_name, __FILE__,                    \
+                         tec_##suite_name##_##test_name, false);               \
+        if (entry)                                                             \
+            entry->budget_ms = (double)(max_ms);                               \
+    }                                                                          \
+    static void tec_##suite_name##_##test_name(void)
+
+#define TEC_TIMEOUT(suite_name, test_name, seconds)                            \
+    static void tec_##suite_name##_##test_name(void);                          \
+    static void __attribute__((constructor))                                   \
+    tec_register_##suite_name##_##test_name(void) {                            \
+        tec_entry_t *entry =                                                   \
+            tec_register(#suite_name, #test_name, __FILE__,                    \
+                         tec_##suite_name##_##test_name, false);               \
+        if (entry)                                                             \
+            entry->timeout_s = (double)(seconds);                              \
+    }                                                                          \
+    static void tec_##suite_name##_##test_name(void)
+
+#define TEC_BENCH(suite_name, test_name)                                       \
+    static void tec_##suite_name##_##test_name(void);                          \
+    static void __attribute__((constructor))                                   \
+    tec_register_##suite_name##_##test_name(void) {                            \
+        tec_entry_t *entry =                                                   \
+            tec_register(#suite_name, #test_name, __FILE__,                    \
+                         tec_##suite_name##_##test_name, false);               \
+        if (entry)                                                             \
+            entry->bench = true;                                               \
+    }                                                                          \
+    static void tec_##suite_name##_##test_name(void)
+
+#define TEC_BENCH_RANGE(suite_name, test_name, lo, hi)                         \
+    static void tec_##suite_name##_##test_name(void);                          \
+    static void __attribute__((constructor))                                   \
+    tec_register_##suite_name##_##test_name(void) {                            \
+        tec_entry_t *entry =                                                   \
+            tec_register(#suite_name, #test_name, __FILE__,                    \
+                         tec_##suite_name##_##test_name, false);               \
+        if (entry) {                                                           \
+            entry->bench = true;                                               \
+            entry->range_lo = (size_t)(lo);                                    \
+            entry->range_hi = (size_t)(hi);                                    \
+        }                                                                      \
+    }                                                                          \
+    static void tec_##suite_name##_##test_name(void)
+
+#define TEC_BENCH_THREADS(suite_name, test_name, max)                          \
+    static void tec_##suite_name##_##test_name(void);                          \
+    static void __attribute__((constructor))                                   \
+    tec_register_##suite_name##_##test_name(void) {                            \
+        tec_entry_t *entry =                                                   \
+            tec_register(#suite_name, #test_name, __FILE__,                    \
+                         tec_##suite_name##_##test_name, false);               \
+        if (entry) {                                                           \
+            entry->bench = true;                                               \
+            entry->max_threads = (size_t)(max);                                \
+        }                                                                      \
+    }                                                                          \
+    static void tec_##suite_name##_##test_name(void)
+
+#define TEC_CONCURRENT(suite_name, test_name, nthreads, iterations_each)       \
+    static void tec_##suite_name##_##test_name(void);                          \
+    static void __attribute__((constructor))                                   \
+    tec_register_##suite_name##_##test_name(void) {                            \
+        tec_entry_t *entry =                                                   \
+            tec_register(#suite_name, #test_name, __FILE__,                    \
+                         tec_##suite_name##_##test_name, false);               \
+        if (entry) {                                                           \
+            entry->concurrent = true;                                          \
+            entry->threads = (size_t)(nthreads);                               \
+            entry->iterations = (size_t)(iterations_each);                     \
+        }                                                                      \
+    }                                                                          \
+    static void tec_##suite_name##_##test_name(void)
+
+#define TEC_VIRTUAL_TIME(suite_name, test_name)                                \
+    static void tec_##suite_name##_##test_name(void);                          \
+    static void __attribute__((constructor))                                   \
+    tec_register_##suite_name##_##test_name(void) {                            \
+        tec_entry_t *entry =                                                   \
+            tec_register(#suite_name, #test_name, __FILE__,                    \
+                         tec_##suite_name##_##test_name, false);               \
+        if (entry)                                                             \
+            entry->virtual_time = true;                                        \
+    }                                                                          \
+    static void tec_##suite_name##_##test_name(void)
+
 #define _TEC_FIXTURE_FACTORY(suite_name, fixture_type_token,                   \
                              fixture_type_enum)                                \
     static void tec_##fixture_type_token##_##suite_name(void);                 \
@@ -644,6 +1828,13 @@ struct tec_auto_register_fixture {
                              fixture_type_enum);                               \
     }                                                                          \
     static void tec_##fixture_type_token##_##suite_name(void)
+
+#define TEC_FIXTURE(suite_name, struct_type)                                   \
+    static void __attribute__((constructor))                                   \
+    tec_register_fixture_##suite_name(void) {                                  \
+        tec_register_fixture_storage(#suite_name, sizeof(struct_type));        \
+    }                                                                          \
+    typedef struct_type tec_fixture_type_##suite_name
 #endif
 
 #define TEC_SETUP(suite_name)                                                  \
@@ -655,24 +1846,106 @@ struct tec_auto_register_fixture {
 #define TEC_TEST_TEARDOWN(suite_name)                                          \
     _TEC_FIXTURE_FACTORY(suite_name, test_teardown, TEC_TEST_TEARDOWN)
 
+/*
+ * Typed fixtures: after TEC_FIXTURE(suite, type), TEC_F tests of that suite
+ * get a `type *` named by their third argument. The runner allocates the
+ * struct once, zeroed, and before each test either runs TEC_FIXTURE_RESET on
+ * it in place or zeroes it again.
+ */
+#define TEC_F(suite_name, test_name, fixture_param)                            \
+    static void tec_f_##suite_name##_##test_name(                              \
+        tec_fixture_type_##suite_name *fixture_param);                         \
+    TEC(suite_name, test_name) {                                               \
+        tec_f_##suite_name##_##test_name(                                      \
+            (tec_fixture_type_##suite_name *)tec_context.fixture);             \
+    }                                                                          \
+    static void tec_f_##suite_name##_##test_name(                              \
+        tec_fixture_type_##suite_name *fixture_param)
+
+#define _TEC_TYPED_FIXTURE_HOOK(suite_name, fixture_param, hook_token,         \
+                                fixture_type_enum)                             \
+    static void tec_##hook_token##_body_##suite_name(                          \
+        tec_fixture_type_##suite_name *fixture_param);                         \
+    _TEC_FIXTURE_FACTORY(suite_name, hook_token, fixture_type_enum) {          \
+        tec_##hook_token##_body_##suite_name(                                  \
+            (tec_fixture_type_##suite_name *)tec_context.fixture);             \
+    }                                                                          \
+    static void tec_##hook_token##_body_##suite_name(                          \
+        tec_fixture_type_##suite_name *fixture_param)
+
+#define TEC_FIXTURE_RESET(suite_name, fixture_param)                           \
+    _TEC_TYPED_FIXTURE_HOOK(suite_name, fixture_param, fixture_reset,          \
+                            TEC_FIXTURE_RESET)
+#define TEC_FIXTURE_RELEASE(suite_name, fixture_param)                         \
+    _TEC_TYPED_FIXTURE_HOOK(suite_name, fixture_param, fixture_release,        \
+                            TEC_FIXTURE_RELEASE)
+
+/*
+ * Headers only the runner needs. With TEC_LEAN_INCLUDES, test files that just
+ * declare tests don't parse them (x86intrin.h alone is bigger than the rest
+ * of tec.h).
+ */
+#if defined(TEC_IMPLEMENTATION) || !defined(TEC_LEAN_INCLUDES)
+#ifndef _WIN32
+#include <dirent.h>
+#include <regex.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#ifdef TEC_HAVE_BACKTRACE
+#include <execinfo.h>
+#endif
+#if defined(TEC_HAVE_VIRTUAL_TIME) || !defined(TEC_LEAN_INCLUDES)
+#include <dlfcn.h>
+#include <poll.h>
+#endif
+#ifdef TEC_HAVE_TSC
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+#endif
+#endif
+
 #ifdef TEC_IMPLEMENTATION
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 tec_context_t tec_context;
+TEC_THREAD_LOCAL tec_context_t *_tec_thread_context = &tec_context;
 
 char tec_fail_prefix[TEC_PREFIX_SIZE];
 char tec_pass_prefix[TEC_PREFIX_SIZE];
 char tec_skip_prefix[TEC_PREFIX_SIZE];
 char tec_line_prefix[TEC_PREFIX_SIZE];
 
+/*
+ * Clocks. Everything is timed in integer nanoseconds by tec_now_ns(): QPC on
+ * Windows, CLOCK_MONOTONIC elsewhere or, with --clock tsc on x86-64 Linux, the
+ * invariant TSC scaled by a factor calibrated against CLOCK_MONOTONIC. The
+ * cost of a clock read is measured once per run and subtracted from every
+ * test's time, which matters for tests that take tens of nanoseconds.
+ */
+typedef struct {
+    bool use_tsc;
+    bool has_cpu_clock;
+    uint64_t tsc_base;
+    uint64_t ns_base;
+    uint64_t tsc_mult;        // nanoseconds per tick, 32.32 fixed point
+    uint64_t overhead_ns;     // one tec_now_ns() call
+    uint64_t window_wall_ns;  // an empty _tec_timestamp()/_tec_elapsed() pair
+    uint64_t window_cpu_ns;
+} tec_clock_t;
+
+tec_clock_t tec_clock;
+
 #ifdef _WIN32
-double tec_get_time(void) {
-    // we don't care if `QueryPerformanceFrequency` or `QueryPerformanceCounter`
-    // fails, so we don't care about fallback and proper cleanup if something
-    // goes wrong :)
-    // we just pretends that everything will always work just fine :)
+uint64_t tec_now_ns(void) {
     static LARGE_INTEGER frequency;
     static int initialized = 0;
 
@@ -684,15 +1957,343 @@ double tec_get_time(void) {
     LARGE_INTEGER counter;
     QueryPerformanceCounter(&counter);
 
-    return (double)counter.QuadPart / (double)frequency.QuadPart;
+    uint64_t ticks = (uint64_t)counter.QuadPart;
+    uint64_t freq = (uint64_t)frequency.QuadPart;
+    return ticks / freq * 1000000000ull + ticks % freq * 1000000000ull / freq;
+}
+
+uint64_t tec_thread_cpu_ns(void) {
+    FILETIME created, exited, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &created, &exited, &kernel,
+                        &user)) {
+        return 0;
+    }
+    uint64_t k = ((uint64_t)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime;
+    uint64_t u = ((uint64_t)user.dwHighDateTime << 32) | user.dwLowDateTime;
+    return (k + u) * 100; // FILETIME counts 100 ns intervals
+}
+#else
+#ifdef TEC_HAVE_VIRTUAL_TIME
+/*
+ * TEC_VIRTUAL_TIME: this file defines clock_gettime, clock_nanosleep,
+ * nanosleep, usleep, sleep and poll for the whole test binary. On the thread
+ * of a virtual-time test they read and advance a simulated clock, so a sleep
+ * returns at once. Everywhere else, and for the runner's own timing, they
+ * forward to libc.
+ */
+typedef struct {
+    uint64_t monotonic_base; // real clocks when the test started
+    uint64_t realtime_base;
+    uint64_t advanced_ns; // slept so far
+} tec_virtual_clock_t;
+
+tec_virtual_clock_t tec_virtual_clock;
+TEC_THREAD_LOCAL bool _tec_virtual_time_on;
+
+// libc's definition of a function that this file replaces.
+void *_tec_libc_symbol(const char *name) {
+    static void *libc;
+    if (libc == NULL)
+        libc = dlopen("libc.so.6", RTLD_LAZY | RTLD_NOLOAD);
+    return libc ? dlsym(libc, name) : NULL;
+}
+
+int _tec_real_clock_gettime(clockid_t clock, struct timespec *ts) {
+    static int (*real)(clockid_t, struct timespec *);
+    if (real == NULL) {
+        void *sym = _tec_libc_symbol("clock_gettime");
+        if (sym == NULL)
+            return (int)syscall(SYS_clock_gettime, clock, ts);
+        memcpy(&real, &sym, sizeof(real));
+    }
+    return real(clock, ts);
+}
+
+int _tec_real_poll(struct pollfd *fds, nfds_t n, int timeout) {
+    static int (*real)(struct pollfd *, nfds_t, int);
+    if (real == NULL) {
+        void *sym = _tec_libc_symbol("poll");
+        if (sym == NULL) {
+            struct timespec ts;
+            ts.tv_sec = timeout / 1000;
+            ts.tv_nsec = (long)(timeout % 1000) * 1000000L;
+            // ppoll takes no timeout as "forever", like poll's -1.
+            return (int)syscall(SYS_ppoll, fds, n, timeout < 0 ? NULL : &ts,
+                                NULL, 0);
+        }
+        memcpy(&real, &sym, sizeof(real));
+    }
+    return real(fds, n, timeout);
+}
+
+int _tec_real_clock_nanosleep(clockid_t clock, int flags,
+                              const struct timespec *req,
+                              struct timespec *rem) {
+    static int (*real)(clockid_t, int, const struct timespec *,
+                       struct timespec *);
+    if (real == NULL) {
+        void *sym = _tec_libc_symbol("clock_nanosleep");
+        if (sym == NULL)
+            return (int)syscall(SYS_clock_nanosleep, clock, flags, req, rem);
+        memcpy(&real, &sym, sizeof(real));
+    }
+    return real(clock, flags, req, rem);
+}
+
+uint64_t _tec_virtual_now(clockid_t clock) {
+    bool realtime = clock == CLOCK_REALTIME || clock == CLOCK_REALTIME_COARSE;
+    return (realtime ? tec_virtual_clock.realtime_base
+                     : tec_virtual_clock.monotonic_base) +
+           tec_virtual_clock.advanced_ns;
+}
+
+// clocks that the simulated clock replaces; CPU-time clocks stay real.
+bool _tec_virtual_clock_id(clockid_t clock) {
+    return clock == CLOCK_MONOTONIC || clock == CLOCK_MONOTONIC_RAW ||
+           clock == CLOCK_MONOTONIC_COARSE || clock == CLOCK_BOOTTIME ||
+           clock == CLOCK_REALTIME || clock == CLOCK_REALTIME_COARSE;
+}
+
+/*
+ * the asm labels give these libc's names without redeclaring libc's
+ * prototypes, which differ in exception specifications and fortify wrappers.
+ */
+int _tec_vt_clock_gettime(clockid_t clock, struct timespec *ts) __asm__(
+    "clock_gettime");
+int _tec_vt_clock_nanosleep(clockid_t clock, int flags,
+                            const struct timespec *req,
+                            struct timespec *rem) __asm__("clock_nanosleep");
+int _tec_vt_nanosleep(const struct timespec *req,
+                      struct timespec *rem) __asm__("nanosleep");
+int _tec_vt_usleep(useconds_t us) __asm__("usleep");
+unsigned int _tec_vt_sleep(unsigned int seconds) __asm__("sleep");
+int _tec_vt_poll(struct pollfd *fds, nfds_t n, int timeout) __asm__("poll");
+
+int _tec_vt_clock_gettime(clockid_t clock, struct timespec *ts) {
+    if (!_tec_virtual_time_on || !_tec_virtual_clock_id(clock))
+        return _tec_real_clock_gettime(clock, ts);
+    uint64_t now = _tec_virtual_now(clock);
+    ts->tv_sec = (time_t)(now / 1000000000ull);
+    ts->tv_nsec = (long)(now % 1000000000ull);
+    return 0;
+}
+
+int _tec_vt_clock_nanosleep(clockid_t clock, int flags,
+                            const struct timespec *req,
+                            struct timespec *rem) {
+    if (!_tec_virtual_time_on || !_tec_virtual_clock_id(clock))
+        return _tec_real_clock_nanosleep(clock, flags, req, rem);
+    if (req->tv_sec < 0 || req->tv_nsec < 0 || req->tv_nsec >= 1000000000L)
+        return EINVAL;
+    uint64_t ns =
+        (uint64_t)req->tv_sec * 1000000000ull + (uint64_t)req->tv_nsec;
+    if (flags & TIMER_ABSTIME) {
+        uint64_t now = _tec_virtual_now(clock);
+        ns = ns > now ? ns - now : 0;
+    }
+    tec_virtual_clock.advanced_ns += ns;
+    return 0;
+}
+
+int _tec_vt_nanosleep(const struct timespec *req, struct timespec *rem) {
+    int err = _tec_vt_clock_nanosleep(CLOCK_REALTIME, 0, req, rem);
+    if (err != 0) {
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+int _tec_vt_usleep(useconds_t us) {
+    struct timespec req;
+    req.tv_sec = (time_t)(us / 1000000);
+    req.tv_nsec = (long)(us % 1000000) * 1000;
+    return _tec_vt_nanosleep(&req, NULL);
+}
+
+unsigned int _tec_vt_sleep(unsigned int seconds) {
+    struct timespec req;
+    req.tv_sec = (time_t)seconds;
+    req.tv_nsec = 0;
+    struct timespec rem = req;
+    if (_tec_vt_nanosleep(&req, &rem) != 0)
+        return (unsigned int)rem.tv_sec;
+    return 0;
+}
+
+int _tec_vt_poll(struct pollfd *fds, nfds_t n, int timeout) {
+    if (!_tec_virtual_time_on || timeout == 0)
+        return _tec_real_poll(fds, n, timeout);
+    int ready = _tec_real_poll(fds, n, 0);
+    if (ready != 0 || timeout < 0) // nothing to simulate an endless wait with
+        return ready != 0 ? ready : _tec_real_poll(fds, n, timeout);
+    tec_virtual_clock.advanced_ns += (uint64_t)timeout * 1000000ull;
+    return 0;
+}
+#else
+#define _tec_real_clock_gettime clock_gettime
+#endif
+
+uint64_t _tec_monotonic_ns(void) {
+    struct timespec ts;
+    _tec_real_clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+uint64_t tec_now_ns(void) {
+#ifdef TEC_HAVE_TSC
+    if (tec_clock.use_tsc) {
+        // split the product so it cannot overflow 64 bits.
+        uint64_t ticks = __rdtsc() - tec_clock.tsc_base;
+        return tec_clock.ns_base + (ticks >> 32) * tec_clock.tsc_mult +
+               (((ticks & 0xffffffffull) * tec_clock.tsc_mult) >> 32);
+    }
+#endif
+    return _tec_monotonic_ns();
 }
+
+uint64_t tec_thread_cpu_ns(void) {
+#ifdef CLOCK_THREAD_CPUTIME_ID
+    struct timespec ts;
+    if (_tec_real_clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+        return 0;
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
 #else
-double tec_get_time(void) {
+    return 0;
+#endif
+}
+#endif
+
+// starts the simulated clock at the real time; false if it is unavailable.
+bool _tec_virtual_time_begin(void) {
+#ifdef TEC_HAVE_VIRTUAL_TIME
     struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC, &ts);
-    return ts.tv_sec + ts.tv_nsec * 1e-9;
+    _tec_real_clock_gettime(CLOCK_REALTIME, &ts);
+    tec_virtual_clock.realtime_base =
+        (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+    tec_virtual_clock.monotonic_base = _tec_monotonic_ns();
+    tec_virtual_clock.advanced_ns = 0;
+    _tec_virtual_time_on = true;
+    return true;
+#else
+    return false;
+#endif
+}
+
+void _tec_virtual_time_end(void) {
+#ifdef TEC_HAVE_VIRTUAL_TIME
+    _tec_virtual_time_on = false;
+#endif
 }
+
+// switches tec_now_ns() to the TSC if it is invariant; takes ~20 ms.
+bool _tec_clock_use_tsc(void) {
+#ifdef TEC_HAVE_TSC
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) ||
+        !(edx & (1u << 8))) {
+        return false;
+    }
+    uint64_t ns0 = _tec_monotonic_ns();
+    uint64_t tsc0 = __rdtsc();
+    uint64_t ns1, tsc1;
+    do {
+        ns1 = _tec_monotonic_ns();
+        tsc1 = __rdtsc();
+    } while (ns1 - ns0 < TEC_TSC_CALIBRATION_NS);
+    if (tsc1 <= tsc0)
+        return false;
+    tec_clock.tsc_mult = ((ns1 - ns0) << 32) / (tsc1 - tsc0);
+    tec_clock.tsc_base = tsc1;
+    tec_clock.ns_base = ns1;
+    tec_clock.use_tsc = true;
+    return true;
+#else
+    return false;
 #endif
+}
+
+int _tec_compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// median cost of one call, measured as the gap between back-to-back reads.
+uint64_t _tec_clock_read_cost(uint64_t (*clock)(void)) {
+    uint64_t samples[TEC_CLOCK_OVERHEAD_SAMPLES];
+    for (size_t i = 0; i < TEC_CLOCK_OVERHEAD_SAMPLES; ++i) {
+        uint64_t a = clock();
+        uint64_t b = clock();
+        samples[i] = b - a;
+    }
+    qsort(samples, TEC_CLOCK_OVERHEAD_SAMPLES, sizeof(uint64_t),
+          _tec_compare_u64);
+    return samples[TEC_CLOCK_OVERHEAD_SAMPLES / 2];
+}
+
+void _tec_clock_init(void) {
+    memset(&tec_clock, 0, sizeof(tec_clock));
+    if (tec_context.options.tsc_clock && !_tec_clock_use_tsc()) {
+        fprintf(stderr,
+                "%sWarning: no invariant TSC available, using the default "
+                "clock.%s\n",
+                TEC_YELLOW, TEC_RESET);
+    }
+    tec_clock.overhead_ns = _tec_clock_read_cost(tec_now_ns);
+    tec_clock.has_cpu_clock = tec_thread_cpu_ns() != 0;
+
+    // the cost to subtract is that of the exact sequence a test is timed
+    // with: an empty window, measured the way a test's window is.
+    uint64_t wall[TEC_CLOCK_OVERHEAD_SAMPLES];
+    uint64_t cpu[TEC_CLOCK_OVERHEAD_SAMPLES];
+    tec_clock.window_wall_ns = 0;
+    tec_clock.window_cpu_ns = 0;
+    for (size_t i = 0; i < TEC_CLOCK_OVERHEAD_SAMPLES; ++i) {
+        tec_timestamp_t raw = _tec_elapsed(_tec_timestamp());
+        wall[i] = raw.wall_ns;
+        cpu[i] = raw.cpu_ns;
+    }
+    qsort(wall, TEC_CLOCK_OVERHEAD_SAMPLES, sizeof(uint64_t),
+          _tec_compare_u64);
+    qsort(cpu, TEC_CLOCK_OVERHEAD_SAMPLES, sizeof(uint64_t), _tec_compare_u64);
+    tec_clock.window_wall_ns = wall[TEC_CLOCK_OVERHEAD_SAMPLES / 2];
+    tec_clock.window_cpu_ns = cpu[TEC_CLOCK_OVERHEAD_SAMPLES / 2];
+}
+
+// CPU time is read outside of the wall-clock window, see _tec_elapsed().
+tec_timestamp_t _tec_timestamp(void) {
+    tec_timestamp_t t;
+    t.cpu_ns = tec_clock.has_cpu_clock ? tec_thread_cpu_ns() : 0;
+    t.wall_ns = tec_now_ns();
+    return t;
+}
+
+/*
+ * Time since `start`, minus what an empty window measures, so the reads
+ * themselves don't count. One thread can't use more CPU than wall time;
+ * what is left of the CPU clock's coarser accounting is cut off at that.
+ */
+tec_timestamp_t _tec_elapsed(tec_timestamp_t start) {
+    tec_timestamp_t t;
+    uint64_t wall = tec_now_ns() - start.wall_ns;
+    uint64_t cpu = tec_clock.has_cpu_clock ? tec_thread_cpu_ns() - start.cpu_ns
+                                           : 0;
+    t.wall_ns = wall > tec_clock.window_wall_ns
+                    ? wall - tec_clock.window_wall_ns
+                    : 0;
+    t.cpu_ns =
+        cpu > tec_clock.window_cpu_ns ? cpu - tec_clock.window_cpu_ns : 0;
+    if (t.cpu_ns > t.wall_ns)
+        t.cpu_ns = t.wall_ns;
+    return t;
+}
+
+double tec_get_time(void) { return (double)tec_now_ns() * 1e-9; }
+
+double _tec_seconds_since(uint64_t start_ns) {
+    return (double)(tec_now_ns() - start_ns) * 1e-9;
+}
 
 void tec_format_time(double seconds, char *buf, size_t buf_size) {
     if (seconds >= 1.0) {
@@ -782,356 +2383,5244 @@ void _tec_detect_color_support(void) {
 }
 
 void TEC_POST_FAIL(void) TEC_FUCK_MSVC_EH {
-    tec_context.current_failed++;
-    tec_context.stats.failed_assertions++;
+    _TEC_CTX.current_failed++;
+    _TEC_CTX.stats.failed_assertions++;
 #ifdef __cplusplus
-    throw tec_assertion_failure(tec_context.failure_message);
+    throw tec_assertion_failure(_TEC_CTX.failure_message);
 #else
-    if (tec_context.jump_set)
-        longjmp(tec_context.jump_buffer, TEC_FAIL);
+    if (_TEC_CTX.jump_set)
+        longjmp(_TEC_CTX.jump_buffer, TEC_FAIL);
 #endif
 }
 
 void _tec_skip_impl(const char *reason, int line) TEC_FUCK_MSVC_EH {
     const char *_reason = (reason);
-    snprintf(tec_context.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,
+    snprintf(_TEC_CTX.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,
              TEC_PRE_SPACE "%sSkipped: %s (line %d)\n", tec_skip_prefix,
              _reason, line);
 #ifdef __cplusplus
-    throw tec_skip_test(tec_context.failure_message);
+    throw tec_skip_test(_TEC_CTX.failure_message);
 #else
-    if (tec_context.jump_set)
-        longjmp(tec_context.jump_buffer, TEC_SKIP_e);
+    if (_TEC_CTX.jump_set)
+        longjmp(_TEC_CTX.jump_buffer, TEC_SKIP_e);
 #endif
 }
 
-int tec_compare_entries(const void *a, const void *b) {
-    tec_entry_t *entry_a = (tec_entry_t *)a;
-    tec_entry_t *entry_b = (tec_entry_t *)b;
-    int suite_cmp = strcmp(entry_a->suite, entry_b->suite);
-    if (suite_cmp != 0) {
-        return suite_cmp;
+typedef struct {
+    char *buf;
+    size_t size;
+    size_t len;
+    bool truncated;
+} tec_strbuf_t;
+
+void _tec_sb_appendf(tec_strbuf_t *sb, const char *fmt, ...) {
+    if (sb->truncated || sb->len >= sb->size)
+        return;
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(sb->buf + sb->len, sb->size - sb->len, fmt, args);
+    va_end(args);
+    if (n < 0 || (size_t)n >= sb->size - sb->len) {
+        // drop the partial write so the buffer always ends on a full line.
+        sb->buf[sb->len] = '\0';
+        sb->truncated = true;
+        return;
     }
-    return strcmp(entry_a->name, entry_b->name);
+    sb->len += (size_t)n;
 }
 
-void tec_register(const char *suite, const char *name, const char *file,
-                  tec_func_t func, bool xfail) {
-    if (!suite || !name || !file || !func) {
-        fprintf(stderr, "%sError: NULL argument to tec_register%s\n", TEC_RED,
+typedef struct {
+    const char *ptr;
+    size_t len; /* includes the trailing '\n' when there is one */
+    uint64_t hash;
+} tec_diff_line_t;
+
+typedef struct {
+    const tec_diff_line_t *a;
+    const tec_diff_line_t *b;
+    bool *del; /* del[i]: line i of `a` is not part of the common subsequence */
+    bool *ins; /* ins[j]: line j of `b` is not part of the common subsequence */
+    long *v1;
+    long *v2;
+    long work; /* line comparisons left; below zero the diff gave up */
+} tec_diff_t;
+
+size_t _tec_diff_split_lines(const char *s, size_t len, tec_diff_line_t *out) {
+    size_t count = 0;
+    const char *end = s + len;
+    while (s < end) {
+        const char *nl = (const char *)memchr(s, '\n', (size_t)(end - s));
+        const char *next = nl ? nl + 1 : end;
+        if (out) {
+            uint64_t h = 1469598103934665603ULL; // FNV-1a
+            for (const char *c = s; c < next; ++c) {
+                h = (h ^ (unsigned char)*c) * 1099511628211ULL;
+            }
+            out[count].ptr = s;
+            out[count].len = (size_t)(next - s);
+            out[count].hash = h;
+        }
+        count++;
+        s = next;
+    }
+    return count;
+}
+
+// the first line of s, for reporting it without a diff.
+tec_diff_line_t _tec_diff_line_at(const char *s, size_t len) {
+    tec_diff_line_t line;
+    const char *nl = (const char *)memchr(s, '\n', len);
+    line.ptr = s;
+    line.len = nl ? (size_t)(nl - s) + 1 : len;
+    line.hash = 0;
+    return line;
+}
+
+bool _tec_diff_line_eq(const tec_diff_line_t *x, const tec_diff_line_t *y) {
+    return x->hash == y->hash && x->len == y->len &&
+           memcmp(x->ptr, y->ptr, x->len) == 0;
+}
+
+/*
+ * Myers' middle snake, walking forward from (a0, b0) and backward from
+ * (a1, b1) until the two frontiers overlap. Only two V vectors are kept, so
+ * the whole diff runs in O((N + M) * D) time and O(N + M) space. Texts that
+ * share almost nothing make D as big as N + M, so every line comparison is
+ * charged to d->work and the diff gives up once TEC_DIFF_MAX_WORK is spent.
+ */
+void _tec_diff_bisect(tec_diff_t *d, long a0, long a1, long b0, long b1,
+                      long *split_a, long *split_b) {
+    long n = a1 - a0;
+    long m = b1 - b0;
+    long max_d = (n + m + 1) / 2;
+    long off = max_d;
+    long v_len = 2 * max_d + 2;
+    long delta = n - m;
+    bool front = (delta % 2 != 0);
+    long k1start = 0, k1end = 0, k2start = 0, k2end = 0;
+
+    for (long i = 0; i < v_len; ++i) {
+        d->v1[i] = -1;
+        d->v2[i] = -1;
+    }
+    d->v1[off + 1] = 0;
+    d->v2[off + 1] = 0;
+
+    for (long step = 0; step < max_d; ++step) {
+        if (d->work < 0)
+            break;
+        for (long k1 = -step + k1start; k1 <= step - k1end; k1 += 2) {
+            long k1_off = off + k1;
+            long x1 = (k1 == -step ||
+                       (k1 != step && d->v1[k1_off - 1] < d->v1[k1_off + 1]))
+                          ? d->v1[k1_off + 1]
+                          : d->v1[k1_off - 1] + 1;
+            long y1 = x1 - k1;
+            d->work--;
+            while (x1 < n && y1 < m &&
+                   _tec_diff_line_eq(&d->a[a0 + x1], &d->b[b0 + y1])) {
+                x1++;
+                y1++;
+                d->work--;
+            }
+            d->v1[k1_off] = x1;
+            if (x1 > n) {
+                k1end += 2;
+            } else if (y1 > m) {
+                k1start += 2;
+            } else if (front) {
+                long k2_off = off + delta - k1;
+                if (k2_off >= 0 && k2_off < v_len && d->v2[k2_off] != -1 &&
+                    x1 >= n - d->v2[k2_off]) {
+                    *split_a = a0 + x1;
+                    *split_b = b0 + y1;
+                    return;
+                }
+            }
+        }
+
+        for (long k2 = -step + k2start; k2 <= step - k2end; k2 += 2) {
+            long k2_off = off + k2;
+            long x2 = (k2 == -step ||
+                       (k2 != step && d->v2[k2_off - 1] < d->v2[k2_off + 1]))
+                          ? d->v2[k2_off + 1]
+                          : d->v2[k2_off - 1] + 1;
+            long y2 = x2 - k2;
+            d->work--;
+            while (x2 < n && y2 < m &&
+                   _tec_diff_line_eq(&d->a[a1 - x2 - 1], &d->b[b1 - y2 - 1])) {
+                x2++;
+                y2++;
+                d->work--;
+            }
+            d->v2[k2_off] = x2;
+            if (x2 > n) {
+                k2end += 2;
+            } else if (y2 > m) {
+                k2start += 2;
+            } else if (!front) {
+                long k1_off = off + delta - k2;
+                if (k1_off >= 0 && k1_off < v_len && d->v1[k1_off] != -1) {
+                    long x1 = d->v1[k1_off];
+                    long y1 = off + x1 - k1_off;
+                    if (x1 >= n - x2) {
+                        *split_a = a0 + x1;
+                        *split_b = b0 + y1;
+                        return;
+                    }
+                }
+            }
+        }
+    }
+    // no overlap: nothing in common, everything is replaced.
+    *split_a = a1;
+    *split_b = b0;
+}
+
+void _tec_diff_compare(tec_diff_t *d, long a0, long a1, long b0, long b1) {
+    if (d->work < 0)
+        return;
+    while (a0 < a1 && b0 < b1 && _tec_diff_line_eq(&d->a[a0], &d->b[b0])) {
+        a0++;
+        b0++;
+    }
+    while (a1 > a0 && b1 > b0 &&
+           _tec_diff_line_eq(&d->a[a1 - 1], &d->b[b1 - 1])) {
+        a1--;
+        b1--;
+    }
+    if (a0 == a1) {
+        for (long j = b0; j < b1; ++j)
+            d->ins[j] = true;
+        return;
+    }
+    if (b0 == b1) {
+        for (long i = a0; i < a1; ++i)
+            d->del[i] = true;
+        return;
+    }
+    long split_a, split_b;
+    _tec_diff_bisect(d, a0, a1, b0, b1, &split_a, &split_b);
+    _tec_diff_compare(d, a0, split_a, b0, split_b);
+    _tec_diff_compare(d, split_a, a1, split_b, b1);
+}
+
+void _tec_diff_emit_line(tec_strbuf_t *sb, char tag, const char *color,
+                         const tec_diff_line_t *line) {
+    int len = (int)line->len;
+    bool has_newline = len > 0 && line->ptr[len - 1] == '\n';
+    if (has_newline)
+        len--;
+    bool cut = len > TEC_DIFF_MAX_LINE;
+    _tec_sb_appendf(sb, TEC_PRE_SPACE "%s%s%c%.*s%s%s\n", tec_line_prefix,
+                    color, tag, cut ? TEC_DIFF_MAX_LINE : len, line->ptr,
+                    cut ? "..." : "", TEC_RESET);
+    if (!has_newline) {
+        _tec_sb_appendf(sb, TEC_PRE_SPACE "%s\\ No newline at end of text\n",
+                        tec_line_prefix);
+    }
+}
+
+void _tec_diff_emit_hunks(tec_strbuf_t *sb, const tec_diff_t *d, size_t na,
+                          size_t nb, size_t first_line) {
+    const size_t ctx = TEC_DIFF_CONTEXT;
+    size_t i = 0, j = 0;
+    size_t equal_run = 0;
+    while (!sb->truncated) {
+        while (i < na && j < nb && !d->del[i] && !d->ins[j]) {
+            i++;
+            j++;
+            equal_run++;
+        }
+        if (i >= na && j >= nb)
+            break;
+
+        size_t lead = equal_run < ctx ? equal_run : ctx;
+        size_t hunk_a = i - lead, hunk_b = j - lead;
+        size_t end_a, end_b;
+        for (;;) {
+            while (i < na && d->del[i])
+                i++;
+            while (j < nb && d->ins[j])
+                j++;
+            size_t run = 0;
+            while (i + run < na && j + run < nb && !d->del[i + run] &&
+                   !d->ins[j + run] && run <= 2 * ctx) {
+                run++;
+            }
+            bool at_end = (i + run >= na && j + run >= nb);
+            if (run > 2 * ctx || at_end) {
+                size_t tail = run < ctx ? run : ctx;
+                end_a = i + tail;
+                end_b = j + tail;
+                i += run;
+                j += run;
+                equal_run = run;
+                break;
+            }
+            i += run;
+            j += run;
+        }
+
+        // like diff -u, an empty side names the line before the hunk.
+        _tec_sb_appendf(sb, TEC_PRE_SPACE "%s%s@@ -%zu,%zu +%zu,%zu @@%s\n",
+                        tec_line_prefix, TEC_CYAN,
+                        first_line + hunk_a + (end_a > hunk_a),
+                        end_a - hunk_a, first_line + hunk_b + (end_b > hunk_b),
+                        end_b - hunk_b, TEC_RESET);
+        size_t x = hunk_a, y = hunk_b;
+        while ((x < end_a || y < end_b) && !sb->truncated) {
+            if (x < end_a && d->del[x]) {
+                _tec_diff_emit_line(sb, '-', TEC_RED, &d->a[x++]);
+            } else if (y < end_b && d->ins[y]) {
+                _tec_diff_emit_line(sb, '+', TEC_GREEN, &d->b[y++]);
+            } else {
+                _tec_diff_emit_line(sb, ' ', "", &d->a[x]);
+                x++;
+                y++;
+            }
+        }
+    }
+}
+
+bool _tec_text_eq(const char *a, const char *b, const char *a_expr,
+                  const char *b_expr, int line) {
+    if (a == NULL || b == NULL) {
+        if (a == b)
+            return true;
+        snprintf(_TEC_CTX.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,
+                 TEC_PRE_SPACE
+                 "%sText mismatch: %s is %s, %s is %s (line %d)\n",
+                 tec_fail_prefix, a_expr, a ? "not NULL" : "NULL", b_expr,
+                 b ? "not NULL" : "NULL", line);
+        return false;
+    }
+
+    size_t la = strlen(a);
+    size_t lb = strlen(b);
+    size_t shorter = la < lb ? la : lb;
+
+    // common prefix, in blocks first so huge equal heads stay cheap.
+    size_t p = 0;
+    while (p + 4096 <= shorter && memcmp(a + p, b + p, 4096) == 0)
+        p += 4096;
+    while (p < shorter && a[p] == b[p])
+        p++;
+    if (p == la && p == lb)
+        return true;
+
+    size_t start = p;
+    while (start > 0 && a[start - 1] != '\n')
+        start--;
+    size_t mismatch_line = start;
+
+    // common suffix, never reaching back into the prefix.
+    size_t s = 0;
+    size_t s_max = shorter - start;
+    while (s + 4096 <= s_max &&
+           memcmp(a + la - s - 4096, b + lb - s - 4096, 4096) == 0)
+        s += 4096;
+    while (s < s_max && a[la - 1 - s] == b[lb - 1 - s])
+        s++;
+    size_t end_a = la - s;
+    size_t end_b = lb - s;
+    // both ends have to sit on a line boundary; the bytes after them are
+    // identical, so moving them together keeps the suffix common.
+    while (end_a < la && ((end_a > start && a[end_a - 1] != '\n') ||
+                          (end_b > start && b[end_b - 1] != '\n'))) {
+        end_a++;
+        end_b++;
+    }
+
+    // widen the window by the context lines the hunks will print.
+    for (int c = 0; c < TEC_DIFF_CONTEXT && start > 0; ++c) {
+        start--;
+        while (start > 0 && a[start - 1] != '\n')
+            start--;
+    }
+    for (int c = 0; c < TEC_DIFF_CONTEXT && end_a < la; ++c) {
+        const char *nl = (const char *)memchr(a + end_a, '\n', la - end_a);
+        size_t next = nl ? (size_t)(nl - a) + 1 : la;
+        end_b += next - end_a;
+        end_a = next;
+    }
+
+    size_t first_line = 0;
+    for (const char *c = a; (c = (const char *)memchr(c, '\n',
+                                                     (size_t)(a + start - c)));
+         ++c) {
+        first_line++;
+    }
+
+    tec_strbuf_t sb;
+    sb.buf = _TEC_CTX.failure_message;
+    sb.size = TEC_MAX_FAILURE_MESSAGE_LEN - 64; // room for the truncation note
+    sb.len = 0;
+    sb.truncated = false;
+    _tec_sb_appendf(&sb, TEC_PRE_SPACE "%sText mismatch (line %d)\n",
+                    tec_fail_prefix, line);
+    _tec_sb_appendf(&sb, TEC_PRE_SPACE "%s%s--- %s%s\n", tec_line_prefix,
+                    TEC_RED, a_expr, TEC_RESET);
+    _tec_sb_appendf(&sb, TEC_PRE_SPACE "%s%s+++ %s%s\n", tec_line_prefix,
+                    TEC_GREEN, b_expr, TEC_RESET);
+
+    size_t na = _tec_diff_split_lines(a + start, end_a - start, NULL);
+    size_t nb = _tec_diff_split_lines(b + start, end_b - start, NULL);
+    size_t max_d = (na + nb + 1) / 2;
+    tec_diff_t d;
+    tec_diff_line_t *lines_a =
+        (tec_diff_line_t *)malloc((na + 1) * sizeof(tec_diff_line_t));
+    tec_diff_line_t *lines_b =
+        (tec_diff_line_t *)malloc((nb + 1) * sizeof(tec_diff_line_t));
+    d.del = (bool *)calloc(na + 1, sizeof(bool));
+    d.ins = (bool *)calloc(nb + 1, sizeof(bool));
+    d.v1 = (long *)malloc((2 * max_d + 2) * sizeof(long));
+    d.v2 = (long *)malloc((2 * max_d + 2) * sizeof(long));
+    if (!lines_a || !lines_b || !d.del || !d.ins || !d.v1 || !d.v2) {
+        _tec_sb_appendf(&sb,
+                        TEC_PRE_SPACE "%sTexts first differ at byte %zu "
+                                      "(out of memory for a diff)\n",
+                        tec_line_prefix, p);
+    } else {
+        _tec_diff_split_lines(a + start, end_a - start, lines_a);
+        _tec_diff_split_lines(b + start, end_b - start, lines_b);
+        d.a = lines_a;
+        d.b = lines_b;
+        d.work = TEC_DIFF_MAX_WORK;
+        _tec_diff_compare(&d, 0, (long)na, 0, (long)nb);
+        if (d.work >= 0) {
+            _tec_diff_emit_hunks(&sb, &d, na, nb, first_line);
+        } else {
+            size_t line_no = 1;
+            for (const char *c = a; (c = (const char *)memchr(
+                                         c, '\n', (size_t)(a + p - c)));
+                 ++c) {
+                line_no++;
+            }
+            tec_diff_line_t line_a =
+                _tec_diff_line_at(a + mismatch_line, la - mismatch_line);
+            tec_diff_line_t line_b =
+                _tec_diff_line_at(b + mismatch_line, lb - mismatch_line);
+            _tec_sb_appendf(&sb,
+                            TEC_PRE_SPACE "%sTexts are too different for a "
+                                          "line diff; first difference at "
+                                          "line %zu, byte %zu:\n",
+                            tec_line_prefix, line_no, p);
+            if (line_a.len > 0)
+                _tec_diff_emit_line(&sb, '-', TEC_RED, &line_a);
+            if (line_b.len > 0)
+                _tec_diff_emit_line(&sb, '+', TEC_GREEN, &line_b);
+        }
+    }
+    free(lines_a);
+    free(lines_b);
+    free(d.del);
+    free(d.ins);
+    free(d.v1);
+    free(d.v2);
+
+    if (sb.truncated) {
+        sb.truncated = false;
+        sb.size = TEC_MAX_FAILURE_MESSAGE_LEN;
+        _tec_sb_appendf(&sb, TEC_PRE_SPACE "%s... (diff truncated)\n",
+                        tec_line_prefix);
+    }
+    return false;
+}
+
+#ifdef _WIN32
+#define TEC_MKDIR(path) _mkdir(path)
+#else
+#define TEC_MKDIR(path) mkdir(path, 0777)
+#endif
+
+bool _tec_mkdirs(const char *path) {
+    char buf[TEC_PATH_MAX];
+    size_t len = strlen(path);
+    if (len == 0 || len >= sizeof(buf))
+        return false;
+    memcpy(buf, path, len + 1);
+    for (size_t i = 1; i <= len; ++i) {
+        if (buf[i] == '/' || buf[i] == '\\' || buf[i] == '\0') {
+            char saved = buf[i];
+            buf[i] = '\0';
+            if (TEC_MKDIR(buf) != 0 && errno != EEXIST) {
+                return false;
+            }
+            buf[i] = saved;
+        }
+    }
+    return true;
+}
+
+// finds the first differing byte, `memcmp` in blocks keeps it vectorized.
+size_t _tec_first_mismatch(const unsigned char *a, const unsigned char *b,
+                           size_t len) {
+    size_t i = 0;
+    while (i + 4096 <= len && memcmp(a + i, b + i, 4096) == 0)
+        i += 4096;
+    while (i < len && a[i] == b[i])
+        i++;
+    return i;
+}
+
+bool _tec_snapshot_write(const char *path, const void *data, size_t len) {
+    char dir[TEC_PATH_MAX];
+    char tmp[TEC_PATH_MAX + 32];
+    snprintf(dir, sizeof(dir), "%s", path);
+    char *f_slash = strrchr(dir, '/');
+    char *b_slash = strrchr(dir, '\\');
+    char *last_slash = (f_slash > b_slash) ? f_slash : b_slash;
+    if (last_slash) {
+        *last_slash = '\0';
+        if (!_tec_mkdirs(dir))
+            return false;
+    }
+
+#ifdef _WIN32
+    snprintf(tmp, sizeof(tmp), "%s.tmp.%lu", path,
+             (unsigned long)GetCurrentProcessId());
+#else
+    snprintf(tmp, sizeof(tmp), "%s.tmp.%ld", path, (long)getpid());
+#endif
+    FILE *f = fopen(tmp, "wb");
+    if (!f)
+        return false;
+    bool ok = (len == 0 || fwrite(data, 1, len, f) == len);
+    ok = (fflush(f) == 0) && ok;
+#ifndef _WIN32
+    ok = ok && fsync(fileno(f)) == 0;
+#endif
+    ok = (fclose(f) == 0) && ok;
+    // the golden is replaced in one step, readers never see a partial file.
+#ifdef _WIN32
+    ok = ok && MoveFileExA(tmp, path, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    ok = ok && rename(tmp, path) == 0;
+#endif
+    if (!ok)
+        remove(tmp);
+    return ok;
+}
+
+bool _tec_snapshot_check(const char *name, const void *data, size_t len,
+                         int line) {
+    const tec_entry_t *test = tec_context.current_test;
+    const char *file = test ? test->file : "";
+    const char *suite = test ? test->suite : "default";
+    const char *f_slash = strrchr(file, '/');
+    const char *b_slash = strrchr(file, '\\');
+    const char *last_slash = (f_slash > b_slash) ? f_slash : b_slash;
+    int dir_len = last_slash ? (int)(last_slash - file) : 1;
+    const char *dir = last_slash ? file : ".";
+
+    char path[TEC_PATH_MAX];
+    snprintf(path, sizeof(path), "%.*s/" TEC_SNAPSHOT_DIR "/%s/%s.snap",
+             dir_len, dir, suite, name);
+
+    bool exists = false;
+    size_t golden_len = 0;
+    size_t mismatch = 0;
+    int expected_byte = -1;
+    int actual_byte = -1;
+#ifdef _WIN32
+    FILE *f = fopen(path, "rb");
+    if (f) {
+        exists = true;
+        unsigned char chunk[4096];
+        const unsigned char *bytes = (const unsigned char *)data;
+        size_t n;
+        mismatch = (size_t)-1;
+        while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+            if (mismatch == (size_t)-1 && golden_len < len) {
+                size_t cmp = (len - golden_len < n) ? len - golden_len : n;
+                size_t at = _tec_first_mismatch(chunk, bytes + golden_len, cmp);
+                if (at < cmp) {
+                    mismatch = golden_len + at;
+                    expected_byte = chunk[at];
+                    actual_byte = bytes[mismatch];
+                }
+            }
+            golden_len += n;
+        }
+        fclose(f);
+        if (mismatch == (size_t)-1)
+            mismatch = golden_len < len ? golden_len : len;
+    }
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd >= 0) {
+        struct stat st;
+        if (fstat(fd, &st) == 0) {
+            exists = true;
+            golden_len = (size_t)st.st_size;
+            size_t common = golden_len < len ? golden_len : len;
+            mismatch = common;
+            if (golden_len > 0) {
+                // compared in place: the golden is never copied into memory.
+                void *map =
+                    mmap(NULL, golden_len, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (map != MAP_FAILED) {
+                    const unsigned char *golden = (const unsigned char *)map;
+                    mismatch = _tec_first_mismatch(
+                        golden, (const unsigned char *)data, common);
+                    if (mismatch < common) {
+                        expected_byte = golden[mismatch];
+                        actual_byte = ((const unsigned char *)data)[mismatch];
+                    }
+                    munmap(map, golden_len);
+                } else {
+                    exists = false;
+                }
+            }
+        }
+        close(fd);
+    }
+#endif
+
+    bool equal = exists && golden_len == len && mismatch == len;
+    if (equal)
+        return true;
+
+    if (tec_context.options.update_snapshots) {
+        if (_tec_snapshot_write(path, data, len)) {
+            tec_context.stats.updated_snapshots++;
+            return true;
+        }
+        snprintf(_TEC_CTX.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,
+                 TEC_PRE_SPACE "%sFailed to update snapshot '%s' (line %d)\n"
+                 TEC_PRE_SPACE "%sFile: %.300s (%s)\n",
+                 tec_fail_prefix, name, line, tec_line_prefix, path,
+                 strerror(errno));
+        return false;
+    }
+
+    if (!exists) {
+        snprintf(_TEC_CTX.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,
+                 TEC_PRE_SPACE "%sSnapshot '%s' is missing (line %d)\n"
+                 TEC_PRE_SPACE "%sFile: %.300s\n"
+                 TEC_PRE_SPACE "%sRun with --update-snapshots to record it.\n",
+                 tec_fail_prefix, name, line, tec_line_prefix, path,
+                 tec_line_prefix);
+        return false;
+    }
+
+    char detail[128];
+    if (expected_byte >= 0) {
+        snprintf(detail, sizeof(detail),
+                 "first difference at offset %zu (expected 0x%02x, got 0x%02x)",
+                 mismatch, (unsigned)expected_byte, (unsigned)actual_byte);
+    } else {
+        snprintf(detail, sizeof(detail),
+                 "identical for the first %zu bytes, then the %s ends",
+                 mismatch, len < golden_len ? "actual data" : "snapshot");
+    }
+    snprintf(_TEC_CTX.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,
+             TEC_PRE_SPACE "%sSnapshot '%s' does not match (line %d)\n"
+             TEC_PRE_SPACE "%sFile:     %.300s\n"
+             TEC_PRE_SPACE "%sExpected: %zu bytes\n"
+             TEC_PRE_SPACE "%sActual:   %zu bytes, %s\n"
+             TEC_PRE_SPACE "%sRun with --update-snapshots to accept it.\n",
+             tec_fail_prefix, name, line, tec_line_prefix, path,
+             tec_line_prefix, golden_len, tec_line_prefix, len, detail,
+             tec_line_prefix);
+    return false;
+}
+
+uint64_t tec_ulp_distance_f32(float a, float b) {
+    if (a != a || b != b)
+        return UINT64_MAX;
+    uint32_t ua, ub;
+    memcpy(&ua, &a, sizeof(ua));
+    memcpy(&ub, &b, sizeof(ub));
+    // map sign-magnitude onto one monotonic scale, -0.0 and +0.0 meet in 0.
+    const uint32_t sign = 0x80000000u;
+    uint32_t ka = (ua & sign) ? sign - (ua & ~sign) : sign + ua;
+    uint32_t kb = (ub & sign) ? sign - (ub & ~sign) : sign + ub;
+    return ka > kb ? (uint64_t)(ka - kb) : (uint64_t)(kb - ka);
+}
+
+uint64_t tec_ulp_distance_f64(double a, double b) {
+    if (a != a || b != b)
+        return UINT64_MAX;
+    uint64_t ua, ub;
+    memcpy(&ua, &a, sizeof(ua));
+    memcpy(&ub, &b, sizeof(ub));
+    const uint64_t sign = 0x8000000000000000ULL;
+    uint64_t ka = (ua & sign) ? sign - (ua & ~sign) : sign + ua;
+    uint64_t kb = (ub & sign) ? sign - (ub & ~sign) : sign + ub;
+    return ka > kb ? ka - kb : kb - ka;
+}
+
+/*
+ * The all-good path of TEC_ASSERT_ARRAY_NEAR. GCC and Clang get explicit
+ * 16-byte vectors (native on SSE2 and NEON): |x - y| is a sign-bit mask and
+ * every lane within tolerance subtracts the all-ones compare result from its
+ * counter. NaN compares false, so it counts as far. Counters are folded every
+ * TEC_VEC_FOLD iterations so lanes never overflow.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+#define TEC_HAVE_VECTOR_EXT
+#define TEC_VEC_FOLD (1u << 20)
+typedef float tec_vf32_t __attribute__((vector_size(16)));
+typedef int32_t tec_vi32_t __attribute__((vector_size(16)));
+typedef double tec_vf64_t __attribute__((vector_size(16)));
+typedef int64_t tec_vi64_t __attribute__((vector_size(16)));
+#endif
+
+size_t _tec_count_far_f32(const float *a, const float *b, size_t n,
+                          float tol) {
+    size_t i = 0;
+    size_t near = 0;
+#ifdef TEC_HAVE_VECTOR_EXT
+    const size_t lanes = sizeof(tec_vf32_t) / sizeof(float);
+    tec_vf32_t vtol;
+    tec_vi32_t abs_mask;
+    for (size_t k = 0; k < lanes; ++k) {
+        vtol[k] = tol;
+        abs_mask[k] = INT32_MAX;
+    }
+    while (i + lanes <= n) {
+        tec_vi32_t acc = {0};
+        for (size_t it = 0; it < TEC_VEC_FOLD && i + lanes <= n;
+             ++it, i += lanes) {
+            tec_vf32_t x, y;
+            memcpy(&x, a + i, sizeof(x));
+            memcpy(&y, b + i, sizeof(y));
+            tec_vf32_t d = (tec_vf32_t)((tec_vi32_t)(x - y) & abs_mask);
+            acc -= (d <= vtol);
+        }
+        for (size_t k = 0; k < lanes; ++k)
+            near += (uint32_t)acc[k];
+    }
+#endif
+    for (; i < n; ++i) {
+        float d = a[i] - b[i];
+        d = d < 0.0f ? -d : d;
+        near += (d <= tol);
+    }
+    return n - near;
+}
+
+size_t _tec_count_far_f64(const double *a, const double *b, size_t n,
+                          double tol) {
+    size_t i = 0;
+    size_t near = 0;
+#ifdef TEC_HAVE_VECTOR_EXT
+    const size_t lanes = sizeof(tec_vf64_t) / sizeof(double);
+    tec_vf64_t vtol;
+    tec_vi64_t abs_mask;
+    for (size_t k = 0; k < lanes; ++k) {
+        vtol[k] = tol;
+        abs_mask[k] = INT64_MAX;
+    }
+    while (i + lanes <= n) {
+        tec_vi64_t acc = {0};
+        for (size_t it = 0; it < TEC_VEC_FOLD && i + lanes <= n;
+             ++it, i += lanes) {
+            tec_vf64_t x, y;
+            memcpy(&x, a + i, sizeof(x));
+            memcpy(&y, b + i, sizeof(y));
+            tec_vf64_t d = (tec_vf64_t)((tec_vi64_t)(x - y) & abs_mask);
+            acc -= (d <= vtol);
+        }
+        for (size_t k = 0; k < lanes; ++k)
+            near += (uint64_t)acc[k];
+    }
+#endif
+    for (; i < n; ++i) {
+        double d = a[i] - b[i];
+        d = d < 0.0 ? -d : d;
+        near += (d <= tol);
+    }
+    return n - near;
+}
+
+#define TEC_ERR_HIST_BUCKETS 6
+
+// kind is checked at compile time by TEC_ASSERT_ARRAY_NEAR.
+bool _tec_array_near(const void *a, const void *b, size_t n, int kind,
+                     double tol, const char *a_expr, const char *b_expr,
+                     int line) {
+    if (n == 0)
+        return true;
+    if (a == NULL || b == NULL) {
+        snprintf(_TEC_CTX.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,
+                 TEC_PRE_SPACE "%sArray nearness got a NULL array: %s or %s "
+                               "(line %d)\n",
+                 tec_fail_prefix, a_expr, b_expr, line);
+        return false;
+    }
+
+    bool is_float = kind == TEC_KIND_FLOAT;
+    size_t far =
+        is_float ? _tec_count_far_f32((const float *)a, (const float *)b, n,
+                                      (float)tol)
+                 : _tec_count_far_f64((const double *)a, (const double *)b, n,
+                                      tol);
+    if (far == 0)
+        return true;
+
+    // slow path, failures only: max error, first index and a histogram in
+    // decades of the tolerance.
+    static const char *const bucket_names[TEC_ERR_HIST_BUCKETS] = {
+        "<=10x", "<=100x", "<=1e3x", "<=1e4x", ">1e4x", "nan"};
+    size_t hist[TEC_ERR_HIST_BUCKETS] = {0};
+    double max_err = 0.0;
+    size_t max_idx = 0;
+    size_t first_idx = n;
+    double ref = tol > 0.0 ? tol : DBL_MIN;
+    for (size_t i = 0; i < n; ++i) {
+        double x = is_float ? (double)((const float *)a)[i]
+                            : ((const double *)a)[i];
+        double y = is_float ? (double)((const float *)b)[i]
+                            : ((const double *)b)[i];
+        double d = _TEC_FABS(x - y);
+        if (d <= tol)
+            continue;
+        if (first_idx == n)
+            first_idx = i;
+        if (d != d) {
+            hist[TEC_ERR_HIST_BUCKETS - 1]++;
+            if (max_err == max_err) {
+                max_err = d;
+                max_idx = i;
+            }
+            continue;
+        }
+        size_t bucket = 0;
+        for (double edge = ref * 10.0;
+             bucket < TEC_ERR_HIST_BUCKETS - 2 && d > edge; edge *= 10.0) {
+            bucket++;
+        }
+        hist[bucket]++;
+        if (max_err == max_err && d > max_err) {
+            max_err = d;
+            max_idx = i;
+        }
+    }
+
+    double max_a = is_float ? (double)((const float *)a)[max_idx]
+                            : ((const double *)a)[max_idx];
+    double max_b = is_float ? (double)((const float *)b)[max_idx]
+                            : ((const double *)b)[max_idx];
+    char hist_buf[TEC_TMP_STRBUF_LEN];
+    size_t used = 0;
+    for (size_t i = 0; i < TEC_ERR_HIST_BUCKETS && used < sizeof(hist_buf);
+         ++i) {
+        int w = snprintf(hist_buf + used, sizeof(hist_buf) - used, "%s%s: %zu",
+                         i ? ", " : "", bucket_names[i], hist[i]);
+        if (w < 0)
+            break;
+        used += (size_t)w;
+    }
+    snprintf(_TEC_CTX.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,
+             TEC_PRE_SPACE "%sArray nearness failed (line %d)\n"
+             TEC_PRE_SPACE "%sExpected: %s and %s within %g (%zu %s)\n"
+             TEC_PRE_SPACE "%sActual:   %zu element(s) out of tolerance, "
+                           "first at index %zu\n"
+             TEC_PRE_SPACE "%sMax error: %g at index %zu (%.9g vs %.9g)\n"
+             TEC_PRE_SPACE "%sErrors (x tolerance): %s\n",
+             tec_fail_prefix, line, tec_line_prefix, a_expr, b_expr, tol, n,
+             is_float ? "floats" : "doubles", tec_line_prefix, far, first_idx,
+             tec_line_prefix, max_err, max_idx, max_a, max_b,
+             tec_line_prefix, hist_buf);
+    return false;
+}
+
+void tec_latency_reset(tec_latency_recorder *rec) {
+    memset(rec, 0, sizeof(*rec));
+}
+
+uint64_t _tec_latency_bucket_upper(size_t idx) {
+    if (idx < TEC_LATENCY_SUB_COUNT)
+        return (uint64_t)idx;
+    unsigned shift = (unsigned)(idx / TEC_LATENCY_HALF_COUNT) - 1;
+    uint64_t sub = (uint64_t)(idx - (size_t)shift * TEC_LATENCY_HALF_COUNT);
+    return ((sub + 1) << shift) - 1;
+}
+
+// reports the highest value equivalent to the bucket holding the percentile,
+// so the result never understates a latency.
+uint64_t tec_latency_percentile(const tec_latency_recorder *rec, double pct) {
+    if (rec->count == 0)
+        return 0;
+    if (pct >= 100.0)
+        return rec->max;
+    double exact = pct / 100.0 * (double)rec->count;
+    uint64_t rank = (uint64_t)exact;
+    if ((double)rank < exact)
+        rank++;
+    if (rank < 1)
+        rank = 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < TEC_LATENCY_BUCKETS; ++i) {
+        seen += rec->buckets[i];
+        if (seen >= rank) {
+            uint64_t upper = _tec_latency_bucket_upper(i);
+            return upper < rec->max ? upper : rec->max;
+        }
+    }
+    return rec->max;
+}
+
+void tec_latency_report(const tec_latency_recorder *rec, const char *name) {
+    tec_latency_row_t *row = NULL;
+    for (size_t i = 0; i < tec_context.latency_row_count; ++i) {
+        if (strcmp(tec_context.latency_rows[i].name, name) == 0) {
+            row = &tec_context.latency_rows[i];
+            break;
+        }
+    }
+    if (row == NULL) {
+        if (tec_context.latency_row_count >= TEC_LATENCY_MAX_ROWS)
+            return;
+        row = &tec_context.latency_rows[tec_context.latency_row_count++];
+    }
+    row->name = name;
+    row->count = rec->count;
+    row->p50 = tec_latency_percentile(rec, 50.0);
+    row->p90 = tec_latency_percentile(rec, 90.0);
+    row->p99 = tec_latency_percentile(rec, 99.0);
+    row->p999 = tec_latency_percentile(rec, 99.9);
+    row->max = rec->max;
+}
+
+bool _tec_percentile_le(const tec_latency_recorder *rec, const char *rec_expr,
+                        double pct, uint64_t budget_ns, int line) {
+    char budget_buf[32];
+    char actual_buf[32];
+    char max_buf[32];
+    tec_latency_report(rec, rec_expr);
+    tec_format_time((double)budget_ns * 1e-9, budget_buf, sizeof(budget_buf));
+    if (rec->count == 0) {
+        snprintf(_TEC_CTX.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,
+                 TEC_PRE_SPACE "%sPercentile assertion failed (line %d)\n"
+                 TEC_PRE_SPACE "%sExpected: p%g of %s <= %s\n" TEC_PRE_SPACE
+                 "%sActual:   no samples recorded\n",
+                 tec_fail_prefix, line, tec_line_prefix, pct, rec_expr,
+                 budget_buf, tec_line_prefix);
+        return false;
+    }
+    uint64_t actual = tec_latency_percentile(rec, pct);
+    if (actual <= budget_ns)
+        return true;
+    tec_format_time((double)actual * 1e-9, actual_buf, sizeof(actual_buf));
+    tec_format_time((double)rec->max * 1e-9, max_buf, sizeof(max_buf));
+    snprintf(_TEC_CTX.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,
+             TEC_PRE_SPACE "%sPercentile assertion failed (line %d)\n"
+             TEC_PRE_SPACE "%sExpected: p%g of %s <= %s\n" TEC_PRE_SPACE
+             "%sActual:   p%g = %s (%" PRIu64 " samples, max %s)\n",
+             tec_fail_prefix, line, tec_line_prefix, pct, rec_expr,
+             budget_buf, tec_line_prefix, pct, actual_buf, rec->count,
+             max_buf);
+    return false;
+}
+
+void _tec_print_latency_rows(void) {
+    for (size_t i = 0; i < tec_context.latency_row_count; ++i) {
+        const tec_latency_row_t *row = &tec_context.latency_rows[i];
+        char p50[32], p90[32], p99[32], p999[32], max[32];
+        tec_format_time((double)row->p50 * 1e-9, p50, sizeof(p50));
+        tec_format_time((double)row->p90 * 1e-9, p90, sizeof(p90));
+        tec_format_time((double)row->p99 * 1e-9, p99, sizeof(p99));
+        tec_format_time((double)row->p999 * 1e-9, p999, sizeof(p999));
+        tec_format_time((double)row->max * 1e-9, max, sizeof(max));
+        printf(TEC_PRE_SPACE "%s%s: n=%" PRIu64
+                             "  p50 %s  p90 %s  p99 %s  p99.9 %s  max %s%s\n",
+               TEC_GRAY, row->name, row->count, p50, p90, p99, p999, max,
+               TEC_RESET);
+    }
+}
+
+/*
+ * Benchmarks. A TEC_BENCH body is one iteration. The runner calls it
+ * `--bench-warmup` times, then doubles the iteration count until a batch
+ * takes TEC_BENCH_SAMPLE_NS, and times TEC_BENCH_SAMPLES batches of that
+ * size. A benchmark whose batches vary by more than `--bench-cv` percent is
+ * reported as unstable instead of being trusted.
+ */
+int _tec_compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Newton's method, so that the header does not need -lm.
+double _tec_sqrt(double x) {
+    if (x <= 0.0)
+        return 0.0;
+    double r = x > 1.0 ? x : 1.0;
+    for (int i = 0; i < 2048; ++i) {
+        double next = 0.5 * (r + x / r);
+        if (next >= r)
+            break;
+        r = next;
+    }
+    return r;
+}
+
+uint64_t _tec_bench_batch(tec_func_t body, uint64_t iterations) {
+    _tec_profile_mark();
+    uint64_t start = tec_now_ns();
+    for (uint64_t i = 0; i < iterations; ++i)
+        body();
+    uint64_t took = tec_now_ns() - start;
+    _tec_arena_reset();
+    return took > tec_clock.overhead_ns ? took - tec_clock.overhead_ns : 0;
+}
+
+#ifdef _WIN32
+typedef int tec_bench_priority_t;
+#else
+typedef struct {
+    int policy;
+    struct sched_param param;
+} tec_bench_priority_t;
+#endif
+
+// --bench-priority: the highest real-time priority while a benchmark runs.
+bool _tec_bench_raise_priority(tec_bench_priority_t *saved) {
+#ifdef _WIN32
+    *saved = GetThreadPriority(GetCurrentThread());
+    return SetThreadPriority(GetCurrentThread(),
+                             THREAD_PRIORITY_TIME_CRITICAL) != 0;
+#else
+    struct sched_param param;
+    saved->policy = sched_getscheduler(0);
+    if (saved->policy < 0 || sched_getparam(0, &saved->param) != 0)
+        return false;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = sched_get_priority_max(SCHED_FIFO);
+    return sched_setscheduler(0, SCHED_FIFO, &param) == 0;
+#endif
+}
+
+void _tec_bench_restore_priority(const tec_bench_priority_t *saved) {
+#ifdef _WIN32
+    SetThreadPriority(GetCurrentThread(), *saved);
+#else
+    sched_setscheduler(0, saved->policy, &saved->param);
+#endif
+}
+
+// --bench-pin: keeps the runner on one CPU so benchmarks do not migrate.
+bool _tec_bench_pin(int cpu) {
+#if defined(_WIN32)
+    if (cpu >= (int)(sizeof(DWORD_PTR) * 8))
+        return false;
+    return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu) != 0;
+#elif defined(__linux__) && defined(SYS_sched_setaffinity)
+    // a raw mask, so that CPU_SET() and _GNU_SOURCE are not needed.
+    unsigned long mask[16];
+    size_t bits = sizeof(unsigned long) * 8;
+    if (cpu < 0 || (size_t)cpu >= sizeof(mask) * 8)
+        return false;
+    memset(mask, 0, sizeof(mask));
+    mask[(size_t)cpu / bits] = 1ul << ((size_t)cpu % bits);
+    return syscall(SYS_sched_setaffinity, 0, sizeof(mask), mask) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+/*
+ * TEC_BENCH_THREADS: for 1, 2, 4, ... threads, every worker runs its warmup,
+ * waits at a spin barrier so that all of them start together, and then
+ * calls the body until the runner raises `stop`. Each worker counts its
+ * calls in its own cache line, so the counters do not slow each other down.
+ * Like TEC_CONCURRENT, workers assert into private contexts, and the first
+ * one that fails stops the run.
+ */
+TEC_THREAD_LOCAL size_t _tec_thread_index;
+
+typedef struct {
+    uint64_t ops;
+    uint64_t elapsed_ns;
+    char pad[TEC_CACHE_LINE - 2 * sizeof(uint64_t)];
+} tec_bench_counter_t;
+
+typedef struct {
+    tec_func_t body;
+    size_t threads;
+    volatile long arrived;
+    volatile long stop;
+    volatile long failures; // workers that failed or skipped
+    size_t first;           // the first of them
+    tec_bench_counter_t *counters; // cache-line aligned, one per thread
+} tec_bench_run_t;
+
+typedef struct {
+    tec_bench_run_t *run;
+    tec_context_t *context;
+    size_t index;
+    bool arrived; // passed the start barrier's counter
+    JUMP_CODES result;
+#ifdef _WIN32
+    HANDLE handle;
+#else
+    pthread_t handle;
+#endif
+} tec_bench_worker_t;
+
+void _tec_bench_worker_loop(tec_bench_worker_t *worker) TEC_FUCK_MSVC_EH {
+    tec_bench_run_t *run = worker->run;
+    tec_bench_counter_t *counter = &run->counters[worker->index];
+    for (size_t i = 0; i < tec_context.options.bench_warmup &&
+                       !_TEC_ATOMIC_LOAD(&run->stop);
+         ++i)
+        run->body();
+
+    worker->arrived = true;
+    _TEC_ATOMIC_ADD(&run->arrived, 1);
+    while (_TEC_ATOMIC_LOAD(&run->arrived) < (long)run->threads)
+        _TEC_CPU_RELAX();
+    uint64_t start = tec_now_ns();
+    while (!_TEC_ATOMIC_LOAD(&run->stop)) {
+        run->body();
+        counter->ops++;
+    }
+    counter->elapsed_ns = tec_now_ns() - start;
+}
+
+#ifdef _WIN32
+DWORD WINAPI _tec_bench_worker_main(LPVOID arg) {
+#else
+void *_tec_bench_worker_main(void *arg) {
+#endif
+    tec_bench_worker_t *worker = (tec_bench_worker_t *)arg;
+    tec_bench_run_t *run = worker->run;
+    JUMP_CODES result = TEC_INITIAL;
+    _tec_thread_context = worker->context;
+    _tec_thread_index = worker->index;
+    if (tec_context.options.bench_pin_set)
+        _tec_bench_pin(tec_context.options.bench_pin + (int)worker->index);
+#ifdef __cplusplus
+    try {
+        _tec_bench_worker_loop(worker);
+    } catch (const tec_assertion_failure &) {
+        result = TEC_FAIL;
+    } catch (const tec_skip_test &) {
+        result = TEC_SKIP_e;
+    } catch (const std::exception &e) {
+        _TEC_CTX.current_failed++;
+        snprintf(_TEC_CTX.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,
+                 TEC_PRE_SPACE_SHORT
+                 "%sTest threw an unhandled std::exception: %s\n",
+                 tec_fail_prefix, e.what());
+        result = TEC_FAIL;
+    } catch (...) {
+        _TEC_CTX.current_failed++;
+        snprintf(_TEC_CTX.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,
+                 TEC_PRE_SPACE_SHORT "%sTest threw an unknown C++ exception.\n",
+                 tec_fail_prefix);
+        result = TEC_FAIL;
+    }
+#else
+    _TEC_CTX.jump_set = true;
+    int jump_val = setjmp(_TEC_CTX.jump_buffer);
+    if (jump_val == TEC_INITIAL)
+        _tec_bench_worker_loop(worker);
+    else
+        result = (JUMP_CODES)jump_val;
+    _TEC_CTX.jump_set = false;
+#endif
+    worker->result = result;
+    if (result != TEC_INITIAL) {
+        if (_TEC_ATOMIC_ADD(&run->failures, 1) == 0)
+            run->first = worker->index;
+        _TEC_ATOMIC_STORE(&run->stop, 1);
+        // the others may still be waiting for it at the start barrier.
+        if (!worker->arrived)
+            _TEC_ATOMIC_ADD(&run->arrived, 1);
+    }
+#ifdef _WIN32
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+void _tec_sleep_ns(uint64_t ns) {
+#ifdef _WIN32
+    Sleep((DWORD)(ns / 1000000));
+#else
+    struct timespec ts;
+    ts.tv_sec = (time_t)(ns / 1000000000ull);
+    ts.tv_nsec = (long)(ns % 1000000000ull);
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+#endif
+}
+
+size_t _tec_cpu_count(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? info.dwNumberOfProcessors : 1;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (size_t)n : 1;
+#endif
+}
+
+/*
+ * returns false if the threads could not be started, or if the body failed or
+ * skipped on one of them: `*failed` then says which, and
+ * tec_context.failure_message where.
+ */
+bool _tec_bench_throughput(tec_func_t body, size_t threads,
+                           tec_bench_throughput_t *out, JUMP_CODES *failed) {
+    tec_bench_run_t run;
+    memset(&run, 0, sizeof(run));
+    run.body = body;
+    run.threads = threads;
+    *failed = TEC_INITIAL;
+    void *block = calloc(threads + 1, sizeof(tec_bench_counter_t));
+    tec_bench_worker_t *workers =
+        (tec_bench_worker_t *)calloc(threads, sizeof(tec_bench_worker_t));
+    tec_context_t *contexts =
+        (tec_context_t *)malloc(threads * sizeof(tec_context_t));
+    if (block == NULL || workers == NULL || contexts == NULL) {
+        free(block);
+        free(workers);
+        free(contexts);
+        return false;
+    }
+    // calloc only promises max_align_t, round up to a cache line.
+    run.counters = (tec_bench_counter_t *)(((uintptr_t)block + TEC_CACHE_LINE -
+                                            1) &
+                                           ~(uintptr_t)(TEC_CACHE_LINE - 1));
+    // the loader keeps the threads' TLS blocks for the next threads.
+    bool recording = _tec_leak_record(false);
+    size_t started = 0;
+    for (; started < threads; ++started) {
+        _tec_fork_context(&contexts[started]);
+        workers[started].run = &run;
+        workers[started].context = &contexts[started];
+        workers[started].index = started;
+#ifdef _WIN32
+        workers[started].handle = CreateThread(
+            NULL, 0, _tec_bench_worker_main, &workers[started], 0, NULL);
+        if (workers[started].handle == NULL)
+            break;
+#else
+        if (pthread_create(&workers[started].handle, NULL,
+                           _tec_bench_worker_main, &workers[started]) != 0)
+            break;
+#endif
+    }
+    _tec_leak_record(recording);
+    if (started < threads) {
+        // release the ones that started; they wait for the missing threads.
+        _TEC_ATOMIC_STORE(&run.stop, 1);
+        _TEC_ATOMIC_ADD(&run.arrived, (long)(threads - started));
+    } else {
+        while (_TEC_ATOMIC_LOAD(&run.arrived) < (long)threads)
+            _tec_sleep_ns(100000);
+        // a failing worker raises `stop` itself.
+        uint64_t until = tec_now_ns() + TEC_BENCH_THREAD_RUN_NS;
+        while (!_TEC_ATOMIC_LOAD(&run.stop) && tec_now_ns() < until)
+            _tec_sleep_ns(1000000);
+        _TEC_ATOMIC_STORE(&run.stop, 1);
+    }
+    for (size_t i = 0; i < started; ++i) {
+#ifdef _WIN32
+        WaitForSingleObject(workers[i].handle, INFINITE);
+        CloseHandle(workers[i].handle);
+#else
+        pthread_join(workers[i].handle, NULL);
+#endif
+        _tec_merge_context(&contexts[i]);
+    }
+    if (run.failures > 0) {
+        const tec_bench_worker_t *first = &workers[run.first];
+        snprintf(tec_context.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,
+                 "%s", contexts[run.first].failure_message);
+        *failed = first->result;
+        if (*failed == TEC_FAIL) {
+            size_t used = strlen(tec_context.failure_message);
+            snprintf(tec_context.failure_message + used,
+                     TEC_MAX_FAILURE_MESSAGE_LEN - used,
+                     TEC_PRE_SPACE "%sOn thread %zu (of %zu)%s\n",
+                     tec_line_prefix, first->index, threads,
+                     run.failures > 1 ? ", other threads failed too" : "");
+        }
+    }
+    bool ok = started == threads && run.failures == 0;
+    if (ok) {
+        double total = 0.0;
+        out->threads = threads;
+        for (size_t i = 0; i < threads; ++i) {
+            const tec_bench_counter_t *c = &run.counters[i];
+            double rate = c->elapsed_ns > 0 ? (double)c->ops * 1e9 /
+                                                  (double)c->elapsed_ns
+                                            : 0.0;
+            total += rate;
+            if (i == 0 || rate < out->min_thread)
+                out->min_thread = rate;
+            if (i == 0 || rate > out->max_thread)
+                out->max_thread = rate;
+        }
+        double mean = total / (double)threads;
+        out->ops_per_s = total;
+        out->spread_pct =
+            mean > 0.0 ? (out->max_thread - out->min_thread) / mean * 100.0
+                       : 0.0;
+    }
+    free(workers);
+    free(contexts);
+    free(block);
+    return ok;
+}
+
+// returns TEC_INITIAL, or how the body failed on one of the workers.
+JUMP_CODES _tec_bench_threads(const tec_entry_t *test,
+                              tec_bench_result_t *result) {
+    size_t max_threads =
+        test->max_threads > 0 ? test->max_threads : _tec_cpu_count();
+    size_t threads = 1;
+    while (result->throughput_count < TEC_BENCH_MAX_POINTS) {
+        tec_bench_throughput_t *point =
+            &result->throughput[result->throughput_count];
+        JUMP_CODES failed;
+        if (!_tec_bench_throughput(test->func, threads, point, &failed)) {
+            if (failed != TEC_INITIAL)
+                return failed;
+            fprintf(stderr,
+                    "%sWarning: could not start %zu benchmark threads.%s\n",
+                    TEC_YELLOW, threads, TEC_RESET);
+            break;
+        }
+        double single = result->throughput[0].ops_per_s;
+        point->scaling_pct = single > 0.0 ? point->ops_per_s /
+                                                ((double)threads * single) *
+                                                100.0
+                                          : 0.0;
+        result->throughput_count++;
+        if (threads >= max_threads)
+            break;
+        threads = threads * 2 > max_threads ? max_threads : threads * 2;
+    }
+    return TEC_INITIAL;
+}
+
+void _tec_format_rate(double per_s, char *buf, size_t size) {
+    if (per_s >= 1e9)
+        snprintf(buf, size, "%.2f Gops/s", per_s * 1e-9);
+    else if (per_s >= 1e6)
+        snprintf(buf, size, "%.2f Mops/s", per_s * 1e-6);
+    else if (per_s >= 1e3)
+        snprintf(buf, size, "%.2f kops/s", per_s * 1e-3);
+    else
+        snprintf(buf, size, "%.2f ops/s", per_s);
+}
+
+void _tec_print_throughput(const tec_bench_throughput_t *point) {
+    char total[32], slowest[32], fastest[32];
+    _tec_format_rate(point->ops_per_s, total, sizeof(total));
+    _tec_format_rate(point->min_thread, slowest, sizeof(slowest));
+    _tec_format_rate(point->max_thread, fastest, sizeof(fastest));
+    printf(TEC_PRE_SPACE "%sthreads=%-3zu %s  (per thread %s .. %s, "
+                         "scaling %.0f%%, spread %.1f%%)%s\n",
+           TEC_GRAY, point->threads, total, slowest, fastest,
+           point->scaling_pct, point->spread_pct, TEC_RESET);
+}
+
+tec_bench_priority_t tec_bench_saved_priority;
+bool tec_bench_priority_raised;
+
+// restores the scheduling priority, also when the benchmark failed.
+void _tec_bench_end(void) {
+    if (tec_bench_priority_raised) {
+        _tec_bench_restore_priority(&tec_bench_saved_priority);
+        tec_bench_priority_raised = false;
+    }
+}
+
+void _tec_bench_measure(tec_func_t body, tec_bench_point_t *point) {
+    _tec_bench_batch(body, tec_context.options.bench_warmup);
+
+    uint64_t iterations = 1;
+    while (iterations < TEC_BENCH_MAX_ITERATIONS &&
+           _tec_bench_batch(body, iterations) < TEC_BENCH_SAMPLE_NS) {
+        iterations *= 2;
+    }
+
+    double per_iteration[TEC_BENCH_SAMPLES];
+    double sum = 0.0;
+    for (size_t i = 0; i < TEC_BENCH_SAMPLES; ++i) {
+        per_iteration[i] =
+            (double)_tec_bench_batch(body, iterations) / (double)iterations;
+        sum += per_iteration[i];
+    }
+
+    double mean = sum / TEC_BENCH_SAMPLES;
+    double squares = 0.0;
+    for (size_t i = 0; i < TEC_BENCH_SAMPLES; ++i) {
+        double d = per_iteration[i] - mean;
+        squares += d * d;
+    }
+    qsort(per_iteration, TEC_BENCH_SAMPLES, sizeof(double),
+          _tec_compare_doubles);
+    point->iterations = iterations;
+    point->mean_ns = mean;
+    point->median_ns = per_iteration[TEC_BENCH_SAMPLES / 2];
+    point->min_ns = per_iteration[0];
+    point->stddev_ns = _tec_sqrt(squares / (TEC_BENCH_SAMPLES - 1));
+    point->cv_pct = mean > 0.0 ? point->stddev_ns / mean * 100.0 : 0.0;
+    point->unstable = point->cv_pct > tec_context.options.bench_cv_pct;
+}
+
+// log2 without libm: the exponent, then the mantissa bit by bit.
+double _tec_log2(double x) {
+    if (x <= 0.0)
+        return 0.0;
+    double result = 0.0;
+    while (x >= 2.0) {
+        x *= 0.5;
+        result += 1.0;
+    }
+    while (x < 1.0) {
+        x *= 2.0;
+        result -= 1.0;
+    }
+    double bit = 0.5;
+    for (int i = 0; i < 30; ++i, bit *= 0.5) {
+        x *= x;
+        if (x >= 2.0) {
+            x *= 0.5;
+            result += bit;
+        }
+    }
+    return result;
+}
+
+double _tec_complexity_model(tec_complexity c, double n) {
+    switch (c) {
+    case TEC_O_1:
+        return 1.0;
+    case TEC_O_LOG_N:
+        return _tec_log2(n);
+    case TEC_O_N:
+        return n;
+    case TEC_O_N_LOG_N:
+        return n * _tec_log2(n);
+    default:
+        return n * n;
+    }
+}
+
+const char *tec_complexity_name(tec_complexity c) {
+    static const char *const names[TEC_COMPLEXITY_COUNT] = {
+        "O(1)", "O(log n)", "O(n)", "O(n log n)", "O(n^2)"};
+    return (unsigned)c < TEC_COMPLEXITY_COUNT ? names[c] : "O(?)";
+}
+
+/*
+ * Least-squares fit of time = coefficient * f(n) for every model; the one
+ * with the smallest RMS error wins. Needs at least 3 sizes.
+ */
+void _tec_bench_fit(tec_bench_result_t *result) {
+    size_t k = result->point_count;
+    if (k < 3)
+        return;
+    double mean_time = 0.0;
+    for (size_t i = 0; i < k; ++i)
+        mean_time += result->points[i].median_ns;
+    mean_time /= (double)k;
+    if (mean_time <= 0.0)
+        return;
+    for (int c = 0; c < TEC_COMPLEXITY_COUNT; ++c) {
+        double tf = 0.0, ff = 0.0;
+        for (size_t i = 0; i < k; ++i) {
+            double f = _tec_complexity_model((tec_complexity)c,
+                                             (double)result->points[i].n);
+            tf += result->points[i].median_ns * f;
+            ff += f * f;
+        }
+        if (ff <= 0.0)
+            continue;
+        double coefficient = tf / ff;
+        double error = 0.0;
+        for (size_t i = 0; i < k; ++i) {
+            double f = _tec_complexity_model((tec_complexity)c,
+                                             (double)result->points[i].n);
+            double d = result->points[i].median_ns - coefficient * f;
+            error += d * d;
+        }
+        double rms_pct = _tec_sqrt(error / (double)k) / mean_time * 100.0;
+        if (!result->fitted || rms_pct < result->rms_pct) {
+            result->fitted = true;
+            result->complexity = (tec_complexity)c;
+            result->coefficient = coefficient;
+            result->rms_pct = rms_pct;
+        }
+    }
+}
+
+bool _tec_expect_complexity(tec_complexity bound, int line) {
+    const tec_entry_t *test = tec_context.current_test;
+    if (test != NULL && test->range_hi > 0) {
+        // checked by _tec_bench_body once the sweep is done.
+        tec_context.bench.has_bound = true;
+        tec_context.bench.bound = bound;
+        tec_context.bench.bound_line = line;
+        return true;
+    }
+    snprintf(_TEC_CTX.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,
+             TEC_PRE_SPACE "%sComplexity assertion failed (line %d)\n"
+             TEC_PRE_SPACE "%sTEC_ASSERT_COMPLEXITY_LE only works in a "
+                           "TEC_BENCH_RANGE benchmark\n",
+             tec_fail_prefix, line, tec_line_prefix);
+    return false;
+}
+
+bool _tec_complexity_check(const tec_bench_result_t *result) {
+    if (result->fitted && result->complexity <= result->bound)
+        return true;
+    if (!result->fitted) {
+        snprintf(_TEC_CTX.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,
+                 TEC_PRE_SPACE "%sComplexity assertion failed (line %d)\n"
+                 TEC_PRE_SPACE "%sExpected: %s or better\n"
+                 TEC_PRE_SPACE "%sActual:   no fit, %zu size(s) measured "
+                               "(need 3)\n",
+                 tec_fail_prefix, result->bound_line, tec_line_prefix,
+                 tec_complexity_name(result->bound), tec_line_prefix,
+                 result->point_count);
+        return false;
+    }
+    snprintf(_TEC_CTX.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,
+             TEC_PRE_SPACE "%sComplexity assertion failed (line %d)\n"
+             TEC_PRE_SPACE "%sExpected: %s or better\n"
+             TEC_PRE_SPACE "%sActual:   %s (%.4g ns per unit, RMS %.1f%%)\n",
+             tec_fail_prefix, result->bound_line, tec_line_prefix,
+             tec_complexity_name(result->bound), tec_line_prefix,
+             tec_complexity_name(result->complexity), result->coefficient,
+             result->rms_pct);
+    return false;
+}
+
+// runs tec_context.current_test as a benchmark; called instead of its body.
+void _tec_bench_body(void) TEC_FUCK_MSVC_EH {
+    const tec_entry_t *test = tec_context.current_test;
+    tec_bench_result_t *result = &tec_context.bench;
+    static bool warned_priority = false;
+    // SCHED_FIFO workers sharing a CPU would never hand it back to each
+    // other or to the runner, so thread benchmarks keep the normal policy.
+    if (tec_context.options.bench_priority && test->max_threads == 0) {
+        tec_bench_priority_raised =
+            _tec_bench_raise_priority(&tec_bench_saved_priority);
+        if (!tec_bench_priority_raised && !warned_priority) {
+            warned_priority = true;
+            fprintf(stderr,
+                    "%sWarning: could not raise the scheduling priority for "
+                    "benchmarks (needs privileges).%s\n",
+                    TEC_YELLOW, TEC_RESET);
+        }
+    }
+    bool unstable = false;
+    if (test->max_threads > 0) {
+        JUMP_CODES failed = _tec_bench_threads(test, result);
+        if (failed != TEC_INITIAL) {
+            _tec_bench_end();
+            _tec_raise(failed);
+        }
+    } else if (test->range_hi == 0) {
+        result->n = 0;
+        _tec_bench_measure(test->func, &result->points[0]);
+        result->point_count = 1;
+        unstable = result->points[0].unstable;
+    } else {
+        // lo, lo * 8, lo * 64, ... and always hi itself.
+        size_t n = test->range_lo > 0 ? test->range_lo : 1;
+        while (result->point_count < TEC_BENCH_MAX_POINTS) {
+            tec_bench_point_t *point = &result->points[result->point_count];
+            result->n = n;
+            point->n = n;
+            _tec_bench_measure(test->func, point);
+            result->point_count++;
+            unstable = unstable || point->unstable;
+            if (n >= test->range_hi)
+                break;
+            n = n > test->range_hi / TEC_BENCH_RANGE_MULTIPLIER
+                    ? test->range_hi
+                    : n * TEC_BENCH_RANGE_MULTIPLIER;
+        }
+        _tec_bench_fit(result);
+    }
+    _tec_bench_end();
+    if (unstable)
+        tec_context.stats.unstable_benchmarks++;
+    if (result->has_bound) {
+        tec_context.stats.total_assertions++;
+        if (!_tec_complexity_check(result)) {
+            TEC_POST_FAIL();
+        } else {
+            TEC_POST_PASS();
+        }
+    }
+}
+
+void _tec_print_bench_point(const tec_bench_point_t *point, bool sweep) {
+    char mean[32], median[32], min[32], size[32] = "";
+    tec_format_time(point->mean_ns * 1e-9, mean, sizeof(mean));
+    tec_format_time(point->median_ns * 1e-9, median, sizeof(median));
+    tec_format_time(point->min_ns * 1e-9, min, sizeof(min));
+    if (sweep)
+        snprintf(size, sizeof(size), "n=%-10zu ", point->n);
+    printf(TEC_PRE_SPACE "%s%s%s/op  (median %s, min %s, CV %.1f%%, "
+                         "%d x %" PRIu64 " runs)%s\n",
+           TEC_GRAY, size, mean, median, min, point->cv_pct,
+           TEC_BENCH_SAMPLES, point->iterations, TEC_RESET);
+    if (point->unstable) {
+        printf(TEC_PRE_SPACE "%sUnstable: CV %.1f%% is above %.1f%%, do not "
+                             "trust this result%s\n",
+               TEC_YELLOW, point->cv_pct, tec_context.options.bench_cv_pct,
+               TEC_RESET);
+    }
+}
+
+void _tec_print_virtual_time(const tec_entry_t *test) {
+#ifdef TEC_HAVE_VIRTUAL_TIME
+    char slept[32];
+    if (!test->virtual_time || tec_virtual_clock.advanced_ns == 0)
+        return;
+    tec_format_time((double)tec_virtual_clock.advanced_ns * 1e-9, slept,
+                    sizeof(slept));
+    printf(TEC_PRE_SPACE "%sVirtual time: slept %s%s\n", TEC_GRAY, slept,
+           TEC_RESET);
+#else
+    (void)test;
+#endif
+}
+
+void _tec_print_bench_result(void) {
+    const tec_bench_result_t *result = &tec_context.bench;
+    const tec_entry_t *test = tec_context.current_test;
+    bool sweep = test != NULL && test->range_hi > 0;
+    for (size_t i = 0; i < result->point_count; ++i)
+        _tec_print_bench_point(&result->points[i], sweep);
+    for (size_t i = 0; i < result->throughput_count; ++i)
+        _tec_print_throughput(&result->throughput[i]);
+    if (result->fitted) {
+        printf(TEC_PRE_SPACE "%sComplexity: %s, %.4g ns per unit, RMS %.1f%%"
+                             "%s\n",
+               TEC_GRAY, tec_complexity_name(result->complexity),
+               result->coefficient, result->rms_pct, TEC_RESET);
+    }
+}
+
+#ifdef __linux__
+// first line of a sysfs file, or false if it cannot be read.
+bool _tec_read_sysfs(const char *path, char *buf, size_t size) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL)
+        return false;
+    bool ok = fgets(buf, (int)size, f) != NULL;
+    fclose(f);
+    if (ok)
+        buf[strcspn(buf, "\n")] = '\0';
+    return ok;
+}
+#endif
+
+/*
+ * Printed once before the first benchmark: how noisy the timer is and
+ * whether frequency scaling or turbo can make results drift.
+ */
+void _tec_bench_probe(void) {
+    static uint64_t gaps[TEC_BENCH_PROBE_READS];
+    uint64_t last = tec_now_ns();
+    for (size_t i = 0; i < TEC_BENCH_PROBE_READS; ++i) {
+        uint64_t now = tec_now_ns();
+        gaps[i] = now - last;
+        last = now;
+    }
+    qsort(gaps, TEC_BENCH_PROBE_READS, sizeof(uint64_t), _tec_compare_u64);
+    char median[32], p99[32], max[32];
+    tec_format_time((double)gaps[TEC_BENCH_PROBE_READS / 2] * 1e-9, median,
+                    sizeof(median));
+    tec_format_time((double)gaps[TEC_BENCH_PROBE_READS * 99 / 100] * 1e-9, p99,
+                    sizeof(p99));
+    tec_format_time((double)gaps[TEC_BENCH_PROBE_READS - 1] * 1e-9, max,
+                    sizeof(max));
+    printf("%sBenchmarks:%s timer gap median %s, p99 %s, max %s\n", TEC_BLUE,
+           TEC_RESET, median, p99, max);
+
+    if (tec_context.options.bench_pin_set) {
+        printf(TEC_PRE_SPACE_SHORT "pinned to CPU %d\n",
+               tec_context.options.bench_pin);
+    }
+#ifdef __linux__
+    char path[128];
+    char value[64];
+    int cpu = tec_context.options.bench_pin_set ? tec_context.options.bench_pin
+                                                : 0;
+    snprintf(path, sizeof(path),
+             "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_governor", cpu);
+    if (_tec_read_sysfs(path, value, sizeof(value)) &&
+        strcmp(value, "performance") != 0) {
+        printf(TEC_PRE_SPACE_SHORT "%sCPU %d governor is '%s': frequency "
+                                   "scaling is active%s\n",
+               TEC_YELLOW, cpu, value, TEC_RESET);
+    }
+    if ((_tec_read_sysfs("/sys/devices/system/cpu/intel_pstate/no_turbo",
+                         value, sizeof(value)) &&
+         strcmp(value, "0") == 0) ||
+        (_tec_read_sysfs("/sys/devices/system/cpu/cpufreq/boost", value,
+                         sizeof(value)) &&
+         strcmp(value, "1") == 0)) {
+        printf(TEC_PRE_SPACE_SHORT "%sturbo/boost is enabled%s\n", TEC_YELLOW,
+               TEC_RESET);
+    }
+#endif
+}
+
+/*
+ * TEC_CONCURRENT: the body runs `iterations` times on each of `threads`
+ * workers that a barrier releases together. Every worker asserts into its
+ * own copy of tec_context (see _TEC_CTX), so no buffer or counter is shared.
+ * The first worker to fail or skip stops the others, and the runner merges
+ * the copies back before it reports the test.
+ */
+typedef struct {
+    tec_func_t body;
+    size_t threads;
+    size_t iterations;
+    volatile long arrived;
+    volatile long stop;
+    volatile long failures; // workers that failed or skipped
+    size_t first;           // the first of them
+} tec_concurrent_run_t;
+
+typedef struct {
+    tec_concurrent_run_t *run;
+    tec_context_t *context;
+    size_t index;
+    size_t iteration; // the one that failed, or iterations if none did
+    JUMP_CODES result;
+#ifdef _WIN32
+    HANDLE handle;
+#else
+    pthread_t handle;
+#endif
+} tec_concurrent_worker_t;
+
+void _tec_concurrent_loop(tec_concurrent_worker_t *worker) TEC_FUCK_MSVC_EH {
+    tec_concurrent_run_t *run = worker->run;
+    for (; worker->iteration < run->iterations; ++worker->iteration) {
+        if (_TEC_ATOMIC_LOAD(&run->stop))
+            break;
+        run->body();
+    }
+}
+
+#ifdef _WIN32
+DWORD WINAPI _tec_concurrent_worker_main(LPVOID arg) {
+#else
+void *_tec_concurrent_worker_main(void *arg) {
+#endif
+    tec_concurrent_worker_t *worker = (tec_concurrent_worker_t *)arg;
+    tec_concurrent_run_t *run = worker->run;
+    JUMP_CODES result = TEC_INITIAL;
+    _tec_thread_context = worker->context;
+    _tec_thread_index = worker->index;
+
+    _TEC_ATOMIC_ADD(&run->arrived, 1);
+    while (_TEC_ATOMIC_LOAD(&run->arrived) < (long)run->threads)
+        _TEC_CPU_RELAX();
+#ifdef __cplusplus
+    try {
+        _tec_concurrent_loop(worker);
+    } catch (const tec_assertion_failure &) {
+        result = TEC_FAIL;
+    } catch (const tec_skip_test &) {
+        result = TEC_SKIP_e;
+    } catch (const std::exception &e) {
+        _TEC_CTX.current_failed++;
+        snprintf(_TEC_CTX.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,
+                 TEC_PRE_SPACE_SHORT
+                 "%sTest threw an unhandled std::exception: %s\n",
+                 tec_fail_prefix, e.what());
+        result = TEC_FAIL;
+    } catch (...) {
+        _TEC_CTX.current_failed++;
+        snprintf(_TEC_CTX.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,
+                 TEC_PRE_SPACE_SHORT "%sTest threw an unknown C++ exception.\n",
+                 tec_fail_prefix);
+        result = TEC_FAIL;
+    }
+#else
+    _TEC_CTX.jump_set = true;
+    int jump_val = setjmp(_TEC_CTX.jump_buffer);
+    if (jump_val == TEC_INITIAL)
+        _tec_concurrent_loop(worker);
+    else
+        result = (JUMP_CODES)jump_val;
+    _TEC_CTX.jump_set = false;
+#endif
+    worker->result = result;
+    if (result != TEC_INITIAL) {
+        if (_TEC_ATOMIC_ADD(&run->failures, 1) == 0)
+            run->first = worker->index;
+        _TEC_ATOMIC_STORE(&run->stop, 1);
+    }
+#ifdef _WIN32
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+// a private copy of tec_context for a test body that runs somewhere else.
+void _tec_fork_context(tec_context_t *context) {
+    memcpy(context, &tec_context, sizeof(tec_context_t));
+    context->stats.total_assertions = 0;
+    context->stats.passed_assertions = 0;
+    context->stats.failed_assertions = 0;
+    context->current_passed = 0;
+    context->current_failed = 0;
+    context->jump_set = false;
+    context->failure_message[0] = '\0';
+}
+
+// adds the assertions counted in a private copy back to tec_context.
+void _tec_merge_context(const tec_context_t *context) {
+    tec_context.stats.total_assertions += context->stats.total_assertions;
+    tec_context.stats.passed_assertions += context->stats.passed_assertions;
+    tec_context.stats.failed_assertions += context->stats.failed_assertions;
+    tec_context.current_passed += context->current_passed;
+    tec_context.current_failed += context->current_failed;
+}
+
+// ends the test the way TEC_POST_FAIL or TEC_SKIP would, without counting.
+void _tec_raise(JUMP_CODES result) TEC_FUCK_MSVC_EH {
+#ifdef __cplusplus
+    if (result == TEC_SKIP_e)
+        throw tec_skip_test(tec_context.failure_message);
+    throw tec_assertion_failure(tec_context.failure_message);
+#else
+    if (tec_context.jump_set)
+        longjmp(tec_context.jump_buffer, result);
+#endif
+}
+
+// body of a TEC_VIRTUAL_TIME test on a platform without the interposers.
+void _tec_virtual_time_missing(void) TEC_FUCK_MSVC_EH {
+    snprintf(tec_context.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,
+             TEC_PRE_SPACE "%sSkipped: virtual time needs glibc on a 64-bit "
+                           "system\n",
+             tec_skip_prefix);
+    _tec_raise(TEC_SKIP_e);
+}
+
+void _tec_concurrent_body(void) TEC_FUCK_MSVC_EH {
+    const tec_entry_t *test = tec_context.current_test;
+    tec_concurrent_run_t run;
+    memset(&run, 0, sizeof(run));
+    run.body = test->func;
+    run.threads = test->threads > 0 ? test->threads : _tec_cpu_count();
+    run.iterations = test->iterations;
+    tec_concurrent_worker_t *workers = (tec_concurrent_worker_t *)calloc(
+        run.threads, sizeof(tec_concurrent_worker_t));
+    tec_context_t *contexts =
+        (tec_context_t *)malloc(run.threads * sizeof(tec_context_t));
+    if (workers == NULL || contexts == NULL) {
+        free(workers);
+        free(contexts);
+        snprintf(tec_context.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,
+                 TEC_PRE_SPACE "%sCould not allocate %zu concurrent workers\n",
+                 tec_fail_prefix, run.threads);
+        TEC_POST_FAIL();
+        return;
+    }
+
+    // the loader keeps the threads' TLS blocks for the next threads.
+    bool recording = _tec_leak_record(false);
+    size_t started = 0;
+    for (; started < run.threads; ++started) {
+        tec_concurrent_worker_t *worker = &workers[started];
+        tec_context_t *context = &contexts[started];
+        _tec_fork_context(context);
+        worker->run = &run;
+        worker->context = context;
+        worker->index = started;
+#ifdef _WIN32
+        worker->handle = CreateThread(NULL, 0, _tec_concurrent_worker_main,
+                                      worker, 0, NULL);
+        if (worker->handle == NULL)
+            break;
+#else
+        if (pthread_create(&worker->handle, NULL, _tec_concurrent_worker_main,
+                           worker) != 0)
+            break;
+#endif
+    }
+    _tec_leak_record(recording);
+    if (started < run.threads) {
+        // release the ones that started; they wait for the missing threads.
+        _TEC_ATOMIC_STORE(&run.stop, 1);
+        _TEC_ATOMIC_ADD(&run.arrived, (long)(run.threads - started));
+    }
+    for (size_t i = 0; i < started; ++i) {
+#ifdef _WIN32
+        WaitForSingleObject(workers[i].handle, INFINITE);
+        CloseHandle(workers[i].handle);
+#else
+        pthread_join(workers[i].handle, NULL);
+#endif
+        _tec_merge_context(&contexts[i]);
+    }
+
+    JUMP_CODES result = TEC_INITIAL;
+    if (started < run.threads) {
+        snprintf(tec_context.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,
+                 TEC_PRE_SPACE "%sCould not start concurrent worker %zu of "
+                               "%zu\n",
+                 tec_fail_prefix, started + 1, run.threads);
+        tec_context.current_failed++;
+        result = TEC_FAIL;
+    } else if (run.failures > 0) {
+        const tec_concurrent_worker_t *first = &workers[run.first];
+        snprintf(tec_context.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,
+                 "%s", contexts[run.first].failure_message);
+        result = first->result;
+        if (result == TEC_FAIL) {
+            size_t used = strlen(tec_context.failure_message);
+            snprintf(tec_context.failure_message + used,
+                     TEC_MAX_FAILURE_MESSAGE_LEN - used,
+                     TEC_PRE_SPACE "%sOn thread %zu (of %zu), iteration %zu "
+                                   "of %zu%s\n",
+                     tec_line_prefix, first->index, run.threads,
+                     first->iteration + 1, run.iterations,
+                     run.failures > 1 ? ", other threads failed too" : "");
+        }
+    }
+    free(workers);
+    free(contexts);
+    if (result != TEC_INITIAL)
+        _tec_raise(result);
+}
+
+/*
+ * --capture: while a test body runs, fd 1 and fd 2 point at two memfds that
+ * are created once and truncated before every test, so the test's output
+ * does not interleave with the runner's and can be asserted on. The output is
+ * printed only when the test fails.
+ */
+#ifndef _WIN32
+// anonymous in-memory file (memfd on Linux, an unlinked tmpfile elsewhere).
+int _tec_memfd_create(const char *name) {
+#if defined(__linux__) && defined(SYS_memfd_create)
+    int fd = (int)syscall(SYS_memfd_create, name, 0);
+    if (fd >= 0)
+        return fd;
+#endif
+    (void)name;
+    FILE *tmp = tmpfile();
+    if (tmp == NULL)
+        return -1;
+    int fd_copy = dup(fileno(tmp));
+    fclose(tmp);
+    return fd_copy;
+}
+
+// maps what has been written to `fd` so far, or returns NULL if it is empty.
+const char *_tec_map_fd(int fd, size_t *len) {
+    struct stat st;
+    *len = 0;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+        return NULL;
+    void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED)
+        return NULL;
+    *len = (size_t)st.st_size;
+    return (const char *)data;
+}
+#endif
+
+// returns true if this call started capturing.
+bool _tec_capture_begin(void) {
+#ifdef _WIN32
+    return false;
+#else
+    if (tec_context.capture.active)
+        return false;
+    if (!tec_context.capture.ready) {
+        tec_context.capture.out_fd = _tec_memfd_create("tec-stdout");
+        tec_context.capture.err_fd = _tec_memfd_create("tec-stderr");
+        if (tec_context.capture.out_fd < 0 || tec_context.capture.err_fd < 0) {
+            if (tec_context.capture.out_fd >= 0)
+                close(tec_context.capture.out_fd);
+            if (tec_context.capture.err_fd >= 0)
+                close(tec_context.capture.err_fd);
+            return false;
+        }
+        tec_context.capture.ready = true;
+    }
+    fflush(stdout);
+    fflush(stderr);
+    if (ftruncate(tec_context.capture.out_fd, 0) != 0 ||
+        ftruncate(tec_context.capture.err_fd, 0) != 0) {
+        return false;
+    }
+    lseek(tec_context.capture.out_fd, 0, SEEK_SET);
+    lseek(tec_context.capture.err_fd, 0, SEEK_SET);
+    tec_context.capture.saved_out = dup(STDOUT_FILENO);
+    tec_context.capture.saved_err = dup(STDERR_FILENO);
+    dup2(tec_context.capture.out_fd, STDOUT_FILENO);
+    dup2(tec_context.capture.err_fd, STDERR_FILENO);
+    tec_context.capture.active = true;
+    return true;
+#endif
+}
+
+void _tec_capture_end(void) {
+#ifndef _WIN32
+    if (!tec_context.capture.active)
+        return;
+    fflush(stdout);
+    fflush(stderr);
+    dup2(tec_context.capture.saved_out, STDOUT_FILENO);
+    dup2(tec_context.capture.saved_err, STDERR_FILENO);
+    close(tec_context.capture.saved_out);
+    close(tec_context.capture.saved_err);
+    tec_context.capture.active = false;
+#endif
+}
+
+void _tec_capture_close(void) {
+#ifndef _WIN32
+    _tec_capture_end();
+    if (tec_context.capture.ready) {
+        close(tec_context.capture.out_fd);
+        close(tec_context.capture.err_fd);
+        tec_context.capture.ready = false;
+    }
+#endif
+}
+
+void _tec_print_captured(const char *label, int fd) {
+#ifdef _WIN32
+    (void)label;
+    (void)fd;
+#else
+    size_t len;
+    const char *data = _tec_map_fd(fd, &len);
+    if (data == NULL)
+        return;
+    size_t shown = len < TEC_CAPTURE_SHOW_MAX ? len : TEC_CAPTURE_SHOW_MAX;
+    printf(TEC_PRE_SPACE "%s%sCaptured %s (%zu bytes):%s\n", tec_line_prefix,
+           TEC_GRAY, label, len, TEC_RESET);
+    const char *line = data;
+    const char *end = data + shown;
+    while (line < end) {
+        const char *nl = (const char *)memchr(line, '\n', (size_t)(end - line));
+        size_t line_len = nl ? (size_t)(nl - line) : (size_t)(end - line);
+        printf(TEC_PRE_SPACE "%s  %.*s\n", tec_line_prefix, (int)line_len,
+               line);
+        line += line_len + (nl ? 1 : 0);
+    }
+    if (shown < len) {
+        printf(TEC_PRE_SPACE "%s  ... %zu more bytes\n", tec_line_prefix,
+               len - shown);
+    }
+    munmap((void *)data, len);
+#endif
+}
+
+void _tec_print_captured_output(void) {
+    // the memfds outlive the last captured test; only replay for this one.
+    if (!tec_context.capture.ready || !tec_context.options.capture)
+        return;
+    _tec_print_captured("stdout", tec_context.capture.out_fd);
+    _tec_print_captured("stderr", tec_context.capture.err_fd);
+}
+
+/*
+ * Scratch space: tec_scratch_dir() makes one directory per test on a tmpfs
+ * (/dev/shm if it is there), and tec_memfd_open() makes anonymous in-memory
+ * files. Both are removed after the test's teardown fixture has run.
+ */
+typedef struct {
+    bool used;                    // anything was created for this test
+    char dir[TEC_PATH_MAX];       // "" until tec_scratch_dir() is called
+    int fds[TEC_SCRATCH_MAX_FDS]; // from tec_memfd_open()
+    size_t fd_count;
+    uint64_t bytes; // left behind by the last test
+} tec_scratch_t;
+
+tec_scratch_t tec_scratch;
+#ifndef _WIN32
+// TEC_CONCURRENT workers may ask for the directory at the same time.
+pthread_mutex_t _tec_scratch_lock = PTHREAD_MUTEX_INITIALIZER;
+
+const char *_tec_scratch_root(void) {
+    struct stat st;
+    const char *tmpdir = getenv("TMPDIR");
+    if (stat("/dev/shm", &st) == 0 && S_ISDIR(st.st_mode) &&
+        access("/dev/shm", W_OK) == 0)
+        return "/dev/shm";
+    return tmpdir && *tmpdir ? tmpdir : "/tmp";
+}
+#endif
+
+const char *tec_scratch_dir(void) {
+#ifdef _WIN32
+    return NULL;
+#else
+    const char *dir = NULL;
+    pthread_mutex_lock(&_tec_scratch_lock);
+    if (tec_scratch.dir[0] == '\0') {
+        snprintf(tec_scratch.dir, sizeof(tec_scratch.dir),
+                 "%s/tec-scratch-XXXXXX", _tec_scratch_root());
+        if (mkdtemp(tec_scratch.dir) == NULL)
+            tec_scratch.dir[0] = '\0';
+        else
+            tec_scratch.used = true;
+    }
+    if (tec_scratch.dir[0] != '\0')
+        dir = tec_scratch.dir;
+    pthread_mutex_unlock(&_tec_scratch_lock);
+    return dir;
+#endif
+}
+
+int tec_memfd_open(const char *name) {
+#ifdef _WIN32
+    (void)name;
+    return -1;
+#else
+    int fd = -1;
+    pthread_mutex_lock(&_tec_scratch_lock);
+    if (tec_scratch.fd_count < TEC_SCRATCH_MAX_FDS) {
+        fd = _tec_memfd_create(name);
+        if (fd >= 0) {
+            tec_scratch.fds[tec_scratch.fd_count++] = fd;
+            tec_scratch.used = true;
+        }
+    } else {
+        errno = EMFILE;
+    }
+    pthread_mutex_unlock(&_tec_scratch_lock);
+    return fd;
+#endif
+}
+
+#ifndef _WIN32
+// removes `path` and everything below it, returns the bytes its files held.
+uint64_t _tec_scratch_remove(const char *path) {
+    uint64_t bytes = 0;
+    DIR *dir = opendir(path);
+    if (dir != NULL) {
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL) {
+            char child[TEC_PATH_MAX];
+            struct stat st;
+            if (strcmp(entry->d_name, ".") == 0 ||
+                strcmp(entry->d_name, "..") == 0)
+                continue;
+            snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+            if (lstat(child, &st) != 0)
+                continue;
+            if (S_ISDIR(st.st_mode)) {
+                bytes += _tec_scratch_remove(child);
+                continue;
+            }
+            if (S_ISREG(st.st_mode))
+                bytes += (uint64_t)st.st_size;
+            unlink(child);
+        }
+        closedir(dir);
+    }
+    rmdir(path);
+    return bytes;
+}
+#endif
+
+// runs after the test's teardown fixture.
+void _tec_scratch_cleanup(void) {
+#ifndef _WIN32
+    tec_scratch.bytes = 0;
+    for (size_t i = 0; i < tec_scratch.fd_count; ++i) {
+        struct stat st;
+        if (fstat(tec_scratch.fds[i], &st) == 0)
+            tec_scratch.bytes += (uint64_t)st.st_size;
+        close(tec_scratch.fds[i]);
+    }
+    tec_scratch.fd_count = 0;
+    if (tec_scratch.dir[0] != '\0') {
+        tec_scratch.bytes += _tec_scratch_remove(tec_scratch.dir);
+        tec_scratch.dir[0] = '\0';
+    }
+#endif
+}
+
+void _tec_format_bytes(uint64_t bytes, char *buf, size_t buf_size) {
+    static const char *const units[] = {"KiB", "MiB", "GiB", "TiB"};
+    if (bytes < 1024) {
+        snprintf(buf, buf_size, "%" PRIu64 " B", bytes);
+        return;
+    }
+    double value = (double)bytes / 1024.0;
+    size_t unit = 0;
+    while (value >= 1024.0 && unit + 1 < sizeof(units) / sizeof(units[0])) {
+        value /= 1024.0;
+        unit++;
+    }
+    snprintf(buf, buf_size, "%.1f %s", value, units[unit]);
+}
+
+/*
+ * --leak-check: this file defines malloc, calloc, realloc and free (and in
+ * C++ the global operator new and delete) for the whole test binary. While a
+ * test body runs, blocks that its thread allocates go into an open-addressing
+ * table keyed by address, with the return address of the call; free takes
+ * them out again. Whatever is left when the body returns has leaked. Outside
+ * of that window each call costs a flag check.
+ */
+#ifdef TEC_HAVE_LEAK_CHECK
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void __libc_free(void *ptr);
+#define _TEC_RAW_MALLOC(size) __libc_malloc(size)
+#define _TEC_RAW_FREE(ptr) __libc_free(ptr)
+
+typedef struct {
+    uintptr_t ptr; // 0 marks a free slot
+    size_t size;
+    void *site; // where malloc was called from
+} tec_leak_slot_t;
+
+typedef struct {
+    tec_leak_slot_t *slots;
+    size_t capacity; // a power of two, at most half full
+    size_t count;
+    bool overflowed; // the table could not grow, some blocks went untracked
+    bool lock;
+    bool active; // a test body is running, free must look blocks up
+} tec_leak_table_t;
+
+tec_leak_table_t tec_leaks;
+TEC_THREAD_LOCAL bool _tec_leak_recording;
+
+size_t _tec_leak_home(uintptr_t ptr, size_t capacity) {
+    uint64_t h = (uint64_t)(ptr >> 4) * 0x9e3779b97f4a7c15ull;
+    return (size_t)(h ^ (h >> 32)) & (capacity - 1);
+}
+
+void _tec_leak_lock(void) {
+    while (__atomic_test_and_set(&tec_leaks.lock, __ATOMIC_ACQUIRE))
+        _TEC_CPU_RELAX();
+}
+
+void _tec_leak_unlock(void) {
+    __atomic_clear(&tec_leaks.lock, __ATOMIC_RELEASE);
+}
+
+bool _tec_leak_grow(void) {
+    size_t capacity = tec_leaks.capacity ? tec_leaks.capacity * 2 : 4096;
+    tec_leak_slot_t *slots =
+        (tec_leak_slot_t *)__libc_calloc(capacity, sizeof(tec_leak_slot_t));
+    if (slots == NULL)
+        return false;
+    for (size_t i = 0; i < tec_leaks.capacity; ++i) {
+        if (tec_leaks.slots[i].ptr == 0)
+            continue;
+        size_t j = _tec_leak_home(tec_leaks.slots[i].ptr, capacity);
+        while (slots[j].ptr != 0)
+            j = (j + 1) & (capacity - 1);
+        slots[j] = tec_leaks.slots[i];
+    }
+    __libc_free(tec_leaks.slots);
+    tec_leaks.slots = slots;
+    tec_leaks.capacity = capacity;
+    return true;
+}
+
+// call with the lock held.
+void _tec_leak_insert(void *ptr, size_t size, void *site) {
+    if ((tec_leaks.count + 1) * 2 > tec_leaks.capacity && !_tec_leak_grow()) {
+        tec_leaks.overflowed = true;
+        return;
+    }
+    size_t i = _tec_leak_home((uintptr_t)ptr, tec_leaks.capacity);
+    while (tec_leaks.slots[i].ptr != 0)
+        i = (i + 1) & (tec_leaks.capacity - 1);
+    tec_leaks.slots[i].ptr = (uintptr_t)ptr;
+    tec_leaks.slots[i].size = size;
+    tec_leaks.slots[i].site = site;
+    tec_leaks.count++;
+}
+
+// call with the lock held; false if `ptr` was not tracked.
+bool _tec_leak_remove(void *ptr, tec_leak_slot_t *removed) {
+    if (tec_leaks.capacity == 0)
+        return false;
+    size_t mask = tec_leaks.capacity - 1;
+    size_t i = _tec_leak_home((uintptr_t)ptr, tec_leaks.capacity);
+    while (tec_leaks.slots[i].ptr != (uintptr_t)ptr) {
+        if (tec_leaks.slots[i].ptr == 0)
+            return false;
+        i = (i + 1) & mask;
+    }
+    if (removed != NULL)
+        *removed = tec_leaks.slots[i];
+    // shifts back the slots after it, so lookups need no tombstones.
+    size_t hole = i;
+    for (size_t j = (i + 1) & mask; tec_leaks.slots[j].ptr != 0;
+         j = (j + 1) & mask) {
+        size_t home =
+            _tec_leak_home(tec_leaks.slots[j].ptr, tec_leaks.capacity);
+        if (((j - home) & mask) >= ((j - hole) & mask)) {
+            tec_leaks.slots[hole] = tec_leaks.slots[j];
+            hole = j;
+        }
+    }
+    tec_leaks.slots[hole].ptr = 0;
+    tec_leaks.count--;
+    return true;
+}
+
+void _tec_leak_track(void *ptr, size_t size, void *site) {
+    _tec_leak_lock();
+    _tec_leak_insert(ptr, size, site);
+    _tec_leak_unlock();
+}
+
+void *_tec_lc_malloc(size_t size) __asm__("malloc");
+void *_tec_lc_calloc(size_t n, size_t size) __asm__("calloc");
+void *_tec_lc_realloc(void *ptr, size_t size) __asm__("realloc");
+void _tec_lc_free(void *ptr) __asm__("free");
+
+void *_tec_lc_malloc(size_t size) {
+    void *ptr = __libc_malloc(size);
+    if (_tec_leak_recording && ptr != NULL)
+        _tec_leak_track(ptr, size, __builtin_return_address(0));
+    return ptr;
+}
+
+void *_tec_lc_calloc(size_t n, size_t size) {
+    void *ptr = __libc_calloc(n, size);
+    if (_tec_leak_recording && ptr != NULL)
+        _tec_leak_track(ptr, n * size, __builtin_return_address(0));
+    return ptr;
+}
+
+void *_tec_lc_realloc(void *old, size_t size) {
+    tec_leak_slot_t slot;
+    bool tracked = false;
+    if (old != NULL && __atomic_load_n(&tec_leaks.active, __ATOMIC_RELAXED)) {
+        _tec_leak_lock();
+        tracked = _tec_leak_remove(old, &slot);
+        _tec_leak_unlock();
+    }
+    void *ptr = __libc_realloc(old, size);
+    if (tracked && ptr == NULL && size != 0) {
+        _tec_leak_track(old, slot.size, slot.site); // still allocated
+    } else if (ptr != NULL && tracked) {
+        _tec_leak_track(ptr, size, slot.site);
+    } else if (ptr != NULL && old == NULL && _tec_leak_recording) {
+        _tec_leak_track(ptr, size, __builtin_return_address(0));
+    }
+    return ptr;
+}
+
+void _tec_lc_free(void *ptr) {
+    // before the block can be handed out again.
+    if (ptr != NULL && __atomic_load_n(&tec_leaks.active, __ATOMIC_RELAXED)) {
+        _tec_leak_lock();
+        _tec_leak_remove(ptr, NULL);
+        _tec_leak_unlock();
+    }
+    __libc_free(ptr);
+}
+
+#ifdef __cplusplus
+} // extern "C"
+
+/*
+ * libstdc++'s operator new calls malloc itself, which would make every `new`
+ * look like it came from inside libstdc++; these record their own caller.
+ */
+void *_tec_leak_new(std::size_t size, void *site, bool nothrow) {
+    if (size == 0)
+        size = 1;
+    void *ptr;
+    while ((ptr = __libc_malloc(size)) == NULL) {
+        std::new_handler handler = std::get_new_handler();
+        if (handler == NULL) {
+            if (nothrow)
+                return NULL;
+            throw std::bad_alloc();
+        }
+        if (!nothrow) {
+            handler();
+            continue;
+        }
+        try {
+            handler();
+        } catch (...) {
+            return NULL;
+        }
+    }
+    if (_tec_leak_recording)
+        _tec_leak_track(ptr, size, site);
+    return ptr;
+}
+
+__attribute__((noinline)) void *operator new(std::size_t size) {
+    return _tec_leak_new(size, __builtin_return_address(0), false);
+}
+
+__attribute__((noinline)) void *operator new[](std::size_t size) {
+    return _tec_leak_new(size, __builtin_return_address(0), false);
+}
+
+__attribute__((noinline)) void *operator new(std::size_t size,
+                                             const std::nothrow_t &) noexcept {
+    return _tec_leak_new(size, __builtin_return_address(0), true);
+}
+
+__attribute__((noinline)) void *
+operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+    return _tec_leak_new(size, __builtin_return_address(0), true);
+}
+
+void operator delete(void *ptr) noexcept { _tec_lc_free(ptr); }
+
+void operator delete[](void *ptr) noexcept { _tec_lc_free(ptr); }
+
+void operator delete(void *ptr, std::size_t) noexcept { _tec_lc_free(ptr); }
+
+void operator delete[](void *ptr, std::size_t) noexcept { _tec_lc_free(ptr); }
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept {
+    _tec_lc_free(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept {
+    _tec_lc_free(ptr);
+}
+
+extern "C" {
+#endif
+#else
+#define _TEC_RAW_MALLOC(size) malloc(size)
+#define _TEC_RAW_FREE(ptr) free(ptr)
+#endif
+
+// starts recording the allocations of the calling thread.
+void _tec_leak_begin(void) {
+#ifdef TEC_HAVE_LEAK_CHECK
+    if (!tec_context.options.leak_check)
+        return;
+    _tec_leak_lock();
+    if (tec_leaks.count > 0)
+        memset(tec_leaks.slots, 0,
+               tec_leaks.capacity * sizeof(tec_leak_slot_t));
+    tec_leaks.count = 0;
+    tec_leaks.overflowed = false;
+    _tec_leak_unlock();
+    __atomic_store_n(&tec_leaks.active, true, __ATOMIC_RELAXED);
+    _tec_leak_recording = true;
+#endif
+}
+
+void _tec_leak_end(void) {
+#ifdef TEC_HAVE_LEAK_CHECK
+    _tec_leak_recording = false;
+    __atomic_store_n(&tec_leaks.active, false, __ATOMIC_RELAXED);
+#endif
+}
+
+// pauses (false) or resumes recording around the runner's own allocations
+// inside a test body; returns whether it was recording.
+bool _tec_leak_record(bool on) {
+#ifdef TEC_HAVE_LEAK_CHECK
+    bool was = _tec_leak_recording;
+    _tec_leak_recording = on;
+    return was;
+#else
+    (void)on;
+    return false;
+#endif
+}
+
+#ifdef TEC_HAVE_LEAK_CHECK
+typedef struct {
+    void *site;
+    size_t bytes;
+    size_t blocks;
+} tec_leak_site_t;
+
+int _tec_compare_leak_sites(const void *a, const void *b) {
+    uintptr_t x = (uintptr_t)((const tec_leak_site_t *)a)->site;
+    uintptr_t y = (uintptr_t)((const tec_leak_site_t *)b)->site;
+    return (x > y) - (x < y);
+}
+
+int _tec_compare_leak_bytes(const void *a, const void *b) {
+    size_t x = ((const tec_leak_site_t *)a)->bytes;
+    size_t y = ((const tec_leak_site_t *)b)->bytes;
+    return (x < y) - (x > y);
+}
+
+// "/path/bin(func+0x1a) [0x..]" to "bin(func+0x1a)".
+void _tec_leak_site_name(void *site, char *out, size_t size) {
+    char **symbols = backtrace_symbols(&site, 1);
+    if (symbols == NULL) {
+        snprintf(out, size, "%p", site);
+        return;
+    }
+    const char *name = symbols[0];
+    const char *open = strchr(name, '(');
+    for (const char *c = name; *c && (open == NULL || c < open); ++c) {
+        if (*c == '/')
+            name = c + 1;
+    }
+    const char *end = strstr(name, " [");
+    snprintf(out, size, "%.*s", end ? (int)(end - name) : (int)strlen(name),
+             name);
+    free(symbols);
+}
+#endif
+
+// appends the leak report of the test that just ran; true if it leaked.
+bool _tec_leak_check(void) {
+#ifdef TEC_HAVE_LEAK_CHECK
+    if (!tec_context.options.leak_check || tec_leaks.count == 0)
+        return false;
+    tec_leak_site_t *sites =
+        (tec_leak_site_t *)malloc(tec_leaks.count * sizeof(tec_leak_site_t));
+    if (sites == NULL)
+        return false;
+    size_t blocks = 0;
+    size_t bytes = 0;
+    for (size_t i = 0; i < tec_leaks.capacity; ++i) {
+        const tec_leak_slot_t *slot = &tec_leaks.slots[i];
+        if (slot->ptr == 0)
+            continue;
+        sites[blocks].site = slot->site;
+        sites[blocks].bytes = slot->size;
+        sites[blocks].blocks = 1;
+        bytes += slot->size;
+        blocks++;
+    }
+    qsort(sites, blocks, sizeof(*sites), _tec_compare_leak_sites);
+    size_t site_count = 0;
+    for (size_t i = 0; i < blocks; ++i) {
+        if (site_count > 0 && sites[site_count - 1].site == sites[i].site) {
+            sites[site_count - 1].bytes += sites[i].bytes;
+            sites[site_count - 1].blocks++;
+        } else {
+            sites[site_count++] = sites[i];
+        }
+    }
+    qsort(sites, site_count, sizeof(*sites), _tec_compare_leak_bytes);
+
+    size_t used = strlen(tec_context.failure_message);
+    snprintf(tec_context.failure_message + used,
+             TEC_MAX_FAILURE_MESSAGE_LEN - used,
+             TEC_PRE_SPACE "%sLeaked %zu bytes in %zu block(s)%s:\n",
+             tec_context.options.leak_warn ? tec_skip_prefix : tec_fail_prefix,
+             bytes, blocks,
+             tec_leaks.overflowed ? " (or more, the table was full)" : "");
+    for (size_t i = 0; i < site_count && i < TEC_LEAK_MAX_SITES; ++i) {
+        char name[TEC_TMP_STRBUF_LEN];
+        _tec_leak_site_name(sites[i].site, name, sizeof(name));
+        used = strlen(tec_context.failure_message);
+        snprintf(tec_context.failure_message + used,
+                 TEC_MAX_FAILURE_MESSAGE_LEN - used,
+                 TEC_PRE_SPACE "%s  %zu bytes in %zu block(s) from %s\n",
+                 tec_line_prefix, sites[i].bytes, sites[i].blocks, name);
+    }
+    if (site_count > TEC_LEAK_MAX_SITES) {
+        used = strlen(tec_context.failure_message);
+        snprintf(tec_context.failure_message + used,
+                 TEC_MAX_FAILURE_MESSAGE_LEN - used,
+                 TEC_PRE_SPACE "%s  ... and %zu more call site(s)\n",
+                 tec_line_prefix, site_count - TEC_LEAK_MAX_SITES);
+    }
+    free(sites);
+    tec_context.stats.leaking_tests++;
+    return true;
+#else
+    return false;
+#endif
+}
+
+/*
+ * tec_arena_alloc(): a bump allocator for a test's short-lived objects. The
+ * runner rewinds it when the test body ends, and keeps its blocks for the
+ * next test; they are freed only when the run ends.
+ */
+typedef struct tec_arena_block {
+    struct tec_arena_block *next;
+    size_t size; // usable bytes after this header
+} tec_arena_block_t;
+
+typedef struct {
+    tec_arena_block_t *first;
+    tec_arena_block_t *current;
+    size_t used; // bytes taken from `current`
+} tec_arena_t;
+
+tec_arena_t tec_arena;
+
+void *tec_arena_alloc(size_t size, size_t align) {
+    if (align == 0)
+        align = TEC_ARENA_ALIGN;
+    if ((align & (align - 1)) != 0 || size > SIZE_MAX / 2 - align)
+        return NULL;
+    tec_arena_block_t *block = tec_arena.current;
+    while (block != NULL) {
+        uintptr_t base = (uintptr_t)(block + 1);
+        uintptr_t at = (base + tec_arena.used + align - 1) & ~(align - 1);
+        size_t offset = (size_t)(at - base);
+        if (offset <= block->size && size <= block->size - offset) {
+            tec_arena.used = offset + size;
+            return (void *)at;
+        }
+        if (block->next == NULL)
+            break;
+        // a block kept from an earlier test.
+        block = block->next;
+        tec_arena.current = block;
+        tec_arena.used = 0;
+    }
+    size_t need = size + align;
+    size_t block_size =
+        need > TEC_ARENA_BLOCK_SIZE ? need : TEC_ARENA_BLOCK_SIZE;
+    tec_arena_block_t *fresh =
+        (tec_arena_block_t *)_TEC_RAW_MALLOC(sizeof(tec_arena_block_t) +
+                                             block_size);
+    if (fresh == NULL)
+        return NULL;
+    fresh->next = NULL;
+    fresh->size = block_size;
+    if (block == NULL)
+        tec_arena.first = fresh;
+    else
+        block->next = fresh;
+    tec_arena.current = fresh;
+    tec_arena.used = 0;
+    return tec_arena_alloc(size, align);
+}
+
+void _tec_arena_reset(void) {
+    tec_arena.current = tec_arena.first;
+    tec_arena.used = 0;
+}
+
+void _tec_arena_free(void) {
+    tec_arena_block_t *block = tec_arena.first;
+    while (block != NULL) {
+        tec_arena_block_t *next = block->next;
+        _TEC_RAW_FREE(block);
+        block = next;
+    }
+    memset(&tec_arena, 0, sizeof(tec_arena));
+}
+
+void _tec_print_scratch(void) {
+    char bytes[32];
+    if (!tec_scratch.used)
+        return;
+    tec_scratch.used = false;
+    _tec_format_bytes(tec_scratch.bytes, bytes, sizeof(bytes));
+    printf(TEC_PRE_SPACE "%sScratch: wrote %s%s\n", TEC_GRAY, bytes,
+           TEC_RESET);
+}
+
+// printable, single-line excerpt of `data` for failure messages.
+void _tec_excerpt(const char *data, size_t len, char *buf, size_t size) {
+    size_t out = 0;
+    for (size_t i = 0; i < len && out + 4 < size; ++i) {
+        unsigned char c = (unsigned char)data[i];
+        if (c == '\n' && out + 5 < size) {
+            buf[out++] = '\\';
+            buf[out++] = 'n';
+        } else {
+            buf[out++] = (c < 0x20 || c == 0x7f) ? '?' : (char)c;
+        }
+        if (i + 1 < len && out + 4 >= size) {
+            memcpy(buf + out, "...", 3);
+            out += 3;
+        }
+    }
+    buf[out] = '\0';
+}
+
+bool _tec_stdout_check(const char *expected, bool exact, const char *expr,
+                       int line) {
+#ifdef _WIN32
+    (void)expected;
+    (void)exact;
+    (void)expr;
+    _tec_skip_impl("stdout capture is not supported on Windows", line);
+    return false;
+#else
+    if (!tec_context.capture.active) {
+        _tec_skip_impl("stdout is not captured, run with --capture", line);
+        return false;
+    }
+    size_t len;
+    size_t want = expected ? strlen(expected) : 0;
+    bool ok = false;
+    fflush(stdout);
+    const char *data = _tec_map_fd(tec_context.capture.out_fd, &len);
+    if (exact) {
+        ok = len == want && (want == 0 || memcmp(data, expected, want) == 0);
+    } else if (want == 0) {
+        ok = true;
+    } else if (len >= want) {
+        // memchr for the first byte, then memcmp; no copy of the capture.
+        const char *p = data;
+        const char *last = data + (len - want);
+        while (p <= last) {
+            p = (const char *)memchr(p, expected[0], (size_t)(last - p) + 1);
+            if (p == NULL)
+                break;
+            if (memcmp(p, expected, want) == 0) {
+                ok = true;
+                break;
+            }
+            p++;
+        }
+    }
+    if (!ok) {
+        char want_buf[TEC_CAPTURE_EXCERPT];
+        char got_buf[TEC_CAPTURE_EXCERPT];
+        bool literal = expr[0] == '"';
+        _tec_excerpt(expected ? expected : "", want, want_buf,
+                     sizeof(want_buf));
+        _tec_excerpt(data ? data : "", len, got_buf, sizeof(got_buf));
+        snprintf(_TEC_CTX.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,
+                 TEC_PRE_SPACE "%sStdout assertion failed (line %d)\n"
+                 TEC_PRE_SPACE "%sExpected: stdout %s \"%s\"%s%s%s\n"
+                 TEC_PRE_SPACE "%sActual:   %zu bytes: \"%s\"\n",
+                 tec_fail_prefix, line, tec_line_prefix,
+                 exact ? "equal to" : "containing", want_buf,
+                 literal ? "" : " (", literal ? "" : expr, literal ? "" : ")",
+                 tec_line_prefix, len, got_buf);
+    }
+    if (data)
+        munmap((void *)data, len);
+    return ok;
+#endif
+}
+
+int tec_compare_entries(const void *a, const void *b) {
+    tec_entry_t *entry_a = (tec_entry_t *)a;
+    tec_entry_t *entry_b = (tec_entry_t *)b;
+    int suite_cmp = strcmp(entry_a->suite, entry_b->suite);
+    if (suite_cmp != 0) {
+        return suite_cmp;
+    }
+    return strcmp(entry_a->name, entry_b->name);
+}
+
+tec_entry_t *tec_register(const char *suite, const char *name,
+                          const char *file, tec_func_t func, bool xfail) {
+    if (!suite || !name || !file || !func) {
+        fprintf(stderr, "%sError: NULL argument to tec_register%s\n", TEC_RED,
+                TEC_RESET);
+        return NULL;
+    }
+
+    if (tec_context.registry.tec_count >= tec_context.registry.tec_capacity) {
+        tec_context.registry.tec_capacity =
+            tec_context.registry.tec_capacity == 0
+                ? 8
+                : tec_context.registry.tec_capacity * 2;
+        tec_entry_t *new_registry = (tec_entry_t *)realloc(
+            tec_context.registry.entries,
+            tec_context.registry.tec_capacity * sizeof(tec_entry_t));
+
+        if (new_registry == NULL) {
+            fprintf(stderr,
+                    "%sError: Failed to allocate memory for test "
+                    "registry%s\n",
+                    TEC_RED, TEC_RESET);
+            free(tec_context.registry.entries);
+            free(tec_context.registry.suites);
+            exit(1);
+        }
+
+        tec_context.registry.entries = new_registry;
+    }
+
+    tec_context.registry.entries[tec_context.registry.tec_count].suite = suite;
+    tec_context.registry.entries[tec_context.registry.tec_count].name = name;
+    tec_context.registry.entries[tec_context.registry.tec_count].file = file;
+    tec_context.registry.entries[tec_context.registry.tec_count].func = func;
+    tec_context.registry.entries[tec_context.registry.tec_count].xfail = xfail;
+    tec_entry_t *entry =
+        &tec_context.registry.entries[tec_context.registry.tec_count++];
+    entry->budget_ms = 0.0;
+    entry->timeout_s = 0.0;
+    entry->elapsed = 0.0;
+    entry->cpu_elapsed = 0.0;
+    entry->outcome = NULL;
+    entry->bench = false;
+    entry->range_lo = 0;
+    entry->range_hi = 0;
+    entry->max_threads = 0;
+    entry->concurrent = false;
+    entry->threads = 0;
+    entry->iterations = 0;
+    entry->async = false;
+    entry->virtual_time = false;
+    entry->compile_time = false;
+    return entry;
+}
+
+// finds the suite or adds it to the registry.
+tec_suite_t *_tec_suite_get(const char *suite_name) {
+    tec_suite_t *suite = NULL;
+    for (size_t i = 0; i < tec_context.registry.suite_count; ++i) {
+        if (strcmp(tec_context.registry.suites[i].name, suite_name) == 0) {
+            suite = &tec_context.registry.suites[i];
+            break;
+        }
+    }
+    if (suite == NULL) {
+        if (tec_context.registry.suite_count >=
+            tec_context.registry.suite_capacity) {
+            tec_context.registry.suite_capacity =
+                tec_context.registry.suite_capacity == 0
+                    ? 4
+                    : tec_context.registry.suite_capacity * 2;
+            tec_suite_t *new_suites = (tec_suite_t *)realloc(
+                tec_context.registry.suites,
+                tec_context.registry.suite_capacity * sizeof(tec_suite_t));
+            if (!new_suites) {
+                fprintf(stderr,
+                        "%sError: Failed to allocate memory for suite "
+                        "registry%s\n",
+                        TEC_RED, TEC_RESET);
+                free(tec_context.registry.entries);
+                free(tec_context.registry.suites);
+                exit(1);
+            }
+            tec_context.registry.suites = new_suites;
+        }
+        suite =
+            &tec_context.registry.suites[tec_context.registry.suite_count++];
+        memset(suite, 0, sizeof(tec_suite_t));
+        suite->name = suite_name;
+    }
+    return suite;
+}
+
+void tec_register_fixture(const char *suite_name, tec_fixture_func_t func,
+                          tec_fixture_type fixture_type) {
+    tec_suite_t *suite = _tec_suite_get(suite_name);
+    switch (fixture_type) {
+    case TEC_SUITE_SETUP:
+        suite->setup = func;
+        break;
+    case TEC_SUITE_TEARDOWN:
+        suite->teardown = func;
+        break;
+    case TEC_TEST_SETUP:
+        suite->test_setup = func;
+        break;
+    case TEC_TEST_TEARDOWN:
+        suite->test_teardown = func;
+        break;
+    case TEC_FIXTURE_RESET:
+        suite->fixture_reset = func;
+        break;
+    case TEC_FIXTURE_RELEASE:
+        suite->fixture_release = func;
+        break;
+    }
+}
+
+void tec_register_fixture_storage(const char *suite_name, size_t size) {
+    _tec_suite_get(suite_name)->fixture_size = size;
+}
+
+tec_suite_t *tec_find_suite(const char *name) {
+    if (!name)
+        return NULL;
+    for (size_t i = 0; i < tec_context.registry.suite_count; ++i) {
+        if (strcmp(tec_context.registry.suites[i].name, name) == 0) {
+            return &tec_context.registry.suites[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * `elapsed` is the wall time in seconds; the runner sets test->cpu_elapsed
+ * before calling this and records the verdict left in tec_context.outcome
+ * (see _tec_finish_test).
+ */
+void tec_process_test_result(JUMP_CODES jump_val, const tec_entry_t *test,
+                             double elapsed) {
+    _tec_virtual_time_end();
+    _tec_leak_end();
+    _tec_arena_reset();
+    _tec_bench_end();
+    _tec_profile_end();
+    _tec_capture_end();
+    char wall_buf[32];
+    char time_buf[80];
+    tec_format_time(elapsed, wall_buf, sizeof(wall_buf));
+    if (tec_clock.has_cpu_clock) {
+        char cpu_buf[32];
+        tec_format_time(test->cpu_elapsed, cpu_buf, sizeof(cpu_buf));
+        snprintf(time_buf, sizeof(time_buf), "%s, cpu %s", wall_buf, cpu_buf);
+    } else {
+        snprintf(time_buf, sizeof(time_buf), "%s", wall_buf);
+    }
+
+    bool body_failed =
+        (jump_val == TEC_FAIL || tec_context.current_failed > 0);
+    // leaks and time budgets are verdicts of their own: they fail the test,
+    // but only the body decides between xfail and xpass.
+    bool has_failed = body_failed;
+    // a failed assertion skips the body's cleanup, so only passes are checked.
+    bool leaked = false;
+    if (jump_val != TEC_SKIP_e && !body_failed && _tec_leak_check()) {
+        leaked = true;
+        if (!tec_context.options.leak_warn)
+            has_failed = true;
+    }
+    bool over_budget = false;
+    double budget_ms = test->budget_ms > 0.0
+                           ? test->budget_ms
+                           : tec_context.options.max_test_time_ms;
+    if (jump_val != TEC_SKIP_e && budget_ms > 0.0 &&
+        elapsed * 1e3 > budget_ms) {
+        char budget_buf[32];
+        size_t used = strlen(tec_context.failure_message);
+        over_budget = true;
+        tec_context.stats.over_budget_tests++;
+        tec_format_time(budget_ms * 1e-3, budget_buf, sizeof(budget_buf));
+        snprintf(tec_context.failure_message + used,
+                 TEC_MAX_FAILURE_MESSAGE_LEN - used,
+                 TEC_PRE_SPACE "%sOver time budget: took %s, budget %s\n",
+                 tec_context.options.budget_warn ? tec_skip_prefix
+                                                 : tec_fail_prefix,
+                 wall_buf, budget_buf);
+        if (!tec_context.options.budget_warn) {
+            has_failed = true;
+        }
+    }
+    if (jump_val == TEC_SKIP_e) {
+        tec_context.stats.skipped_tests++;
+        tec_context.outcome = "skipped";
+        printf(TEC_PRE_SPACE_SHORT "%s%s %s(%s)%s\n", tec_skip_prefix,
+               test->name, TEC_GRAY, time_buf, TEC_RESET);
+        printf("%s", tec_context.failure_message);
+        _tec_print_latency_rows();
+        _tec_print_bench_result();
+        _tec_print_virtual_time(test);
+        return;
+    }
+    if (test->xfail) {
+        if (body_failed) {
+            tec_context.stats.xfailed_tests++;
+            tec_context.outcome = "xfailed";
+            printf(TEC_PRE_SPACE_SHORT "%s%s (expected failure) %s(%s)%s\n",
+                   tec_pass_prefix, test->name, TEC_GRAY, time_buf, TEC_RESET);
+        } else {
+            tec_context.stats.xpassed_tests++;
+            tec_context.outcome = "xpassed";
+            printf(TEC_PRE_SPACE_SHORT "%s%s (unexpected success) %s(%s)%s\n",
+                   tec_fail_prefix, test->name, TEC_GRAY, time_buf, TEC_RESET);
+            if (over_budget || leaked) {
+                printf("%s", tec_context.failure_message);
+            }
+        }
+    } else {
+        if (has_failed) {
+            tec_context.stats.failed_tests++;
+            tec_context.outcome = "failed";
+            if (tec_context.crash_signal != NULL) {
+                printf(TEC_PRE_SPACE_SHORT "%s%s - crashed with %s %s(%s)%s\n",
+                       tec_fail_prefix, test->name, tec_context.crash_signal,
+                       TEC_GRAY, time_buf, TEC_RESET);
+            } else if (tec_context.current_failed == 0 && leaked) {
+                printf(TEC_PRE_SPACE_SHORT "%s%s - leaked memory %s(%s)%s\n",
+                       tec_fail_prefix, test->name, TEC_GRAY, time_buf,
+                       TEC_RESET);
+            } else if (tec_context.current_failed == 0) {
+                printf(TEC_PRE_SPACE_SHORT
+                       "%s%s - exceeded time budget %s(%s)%s\n",
+                       tec_fail_prefix, test->name, TEC_GRAY, time_buf,
+                       TEC_RESET);
+            } else {
+                printf(TEC_PRE_SPACE_SHORT
+                       "%s%s - %zu assertion(s) failed %s(%s)%s\n",
+                       tec_fail_prefix, test->name, tec_context.current_failed,
+                       TEC_GRAY, time_buf, TEC_RESET);
+            }
+            printf("%s", tec_context.failure_message);
+            _tec_print_captured_output();
+        } else {
+            tec_context.stats.passed_tests++;
+            tec_context.outcome = "passed";
+            printf(TEC_PRE_SPACE_SHORT "%s%s %s(%s)%s\n", tec_pass_prefix,
+                   test->name, TEC_GRAY, time_buf, TEC_RESET);
+            if (over_budget || leaked) {
+                printf("%s", tec_context.failure_message);
+            }
+        }
+    }
+    _tec_print_latency_rows();
+    _tec_print_bench_result();
+    _tec_print_virtual_time(test);
+}
+
+void _tec_finish_test(JUMP_CODES jump_val, tec_entry_t *test,
+                      tec_timestamp_t start) {
+    tec_timestamp_t taken = _tec_elapsed(start);
+#ifdef TEC_HAVE_ASYNC
+    // it ran earlier, interleaved with the other async tests of its suite.
+    if (test->async)
+        _tec_async_elapsed(test, &taken.wall_ns, &taken.cpu_ns);
+#endif
+    test->cpu_elapsed = (double)taken.cpu_ns * 1e-9;
+    test->elapsed = (double)taken.wall_ns * 1e-9;
+    tec_process_test_result(jump_val, test, test->elapsed);
+    test->outcome = tec_context.outcome;
+}
+
+void _tec_note_suite_time(const char *name, double elapsed) {
+    if (tec_context.options.durations == 0)
+        return;
+    if (tec_context.registry.suite_times == NULL) {
+        // suites are contiguous after sorting, so there are at most as many
+        // suites as tests.
+        tec_context.registry.suite_times = (tec_suite_time_t *)calloc(
+            tec_context.registry.tec_count, sizeof(tec_suite_time_t));
+        if (tec_context.registry.suite_times == NULL)
+            return;
+    }
+    tec_suite_time_t *slot =
+        &tec_context.registry
+             .suite_times[tec_context.registry.suite_time_count++];
+    slot->name = name;
+    slot->elapsed = elapsed;
+}
+
+int _tec_compare_test_durations(const void *a, const void *b) {
+    double da = (*(const tec_entry_t *const *)a)->elapsed;
+    double db = (*(const tec_entry_t *const *)b)->elapsed;
+    return (da < db) - (da > db);
+}
+
+int _tec_compare_suite_durations(const void *a, const void *b) {
+    double da = ((const tec_suite_time_t *)a)->elapsed;
+    double db = ((const tec_suite_time_t *)b)->elapsed;
+    return (da < db) - (da > db);
+}
+
+void _tec_print_durations(double total_elapsed) {
+    size_t limit = tec_context.options.durations;
+    size_t ran = 0;
+    char time_buf[32];
+    char cpu_buf[32];
+    char name_buf[TEC_TMP_STRBUF_LEN];
+    const tec_entry_t **ranked = (const tec_entry_t **)malloc(
+        (tec_context.registry.tec_count + 1) * sizeof(*ranked));
+    if (ranked == NULL)
+        return;
+    for (size_t i = 0; i < tec_context.registry.tec_count; ++i) {
+        if (tec_context.registry.entries[i].outcome != NULL)
+            ranked[ran++] = &tec_context.registry.entries[i];
+    }
+    qsort(ranked, ran, sizeof(*ranked), _tec_compare_test_durations);
+    if (total_elapsed <= 0.0)
+        total_elapsed = 1e-9;
+
+    printf("\n%sSlowest %zu test(s):%s\n", TEC_BLUE,
+           ran < limit ? ran : limit, TEC_RESET);
+    for (size_t i = 0; i < ran && i < limit; ++i) {
+        tec_format_time(ranked[i]->elapsed, time_buf, sizeof(time_buf));
+        tec_format_time(ranked[i]->cpu_elapsed, cpu_buf, sizeof(cpu_buf));
+        snprintf(name_buf, sizeof(name_buf), "%s.%s", ranked[i]->suite,
+                 ranked[i]->name);
+        printf(TEC_PRE_SPACE_SHORT "%12s %5.1f%%  %s%12s cpu%s  %s\n",
+               time_buf, ranked[i]->elapsed / total_elapsed * 100.0, TEC_GRAY,
+               tec_clock.has_cpu_clock ? cpu_buf : "-", TEC_RESET, name_buf);
+    }
+    free(ranked);
+
+    size_t suites = tec_context.registry.suite_time_count;
+    qsort(tec_context.registry.suite_times, suites, sizeof(tec_suite_time_t),
+          _tec_compare_suite_durations);
+    printf("%sSlowest %zu suite(s):%s\n", TEC_BLUE,
+           suites < limit ? suites : limit, TEC_RESET);
+    for (size_t i = 0; i < suites && i < limit; ++i) {
+        const tec_suite_time_t *suite = &tec_context.registry.suite_times[i];
+        tec_format_time(suite->elapsed, time_buf, sizeof(time_buf));
+        printf(TEC_PRE_SPACE_SHORT "%12s %5.1f%%  %s\n", time_buf,
+               suite->elapsed / total_elapsed * 100.0, suite->name);
+    }
+}
+
+void tec_print_usage(const char *prog_name) {
+    printf("Usage: %s [options]\n", prog_name);
+    printf("\nOptions:\n");
+
+    printf(
+        "  -f, --filter <pattern>  Run tests whose name contains <pattern>.\n"
+        "                          Matches against 'suite.test' by default.\n"
+        "                          Prefix with '!' to exclude matches.\n");
+
+    printf(
+        "  --file                  Apply filters to the test filename instead\n"
+        "                          of the test name.\n");
+
+    printf(
+        "  --fail-fast             Stop execution after the first failure or\n"
+        "                          unexpected success (XPASS).\n");
+
+    printf(
+        "  --update-snapshots      Record missing snapshots and overwrite the\n"
+        "                          ones that no longer match.\n");
+
+    printf(
+        "  --max-test-time <ms>    Fail any test that runs longer than <ms>\n"
+        "                          milliseconds. TEC_BUDGET tests use their\n"
+        "                          own budget instead.\n");
+
+    printf(
+        "  --budget-warn           Report tests over their time budget as\n"
+        "                          warnings instead of failures.\n");
+
+    printf(
+        "  --timeout <sec>         Abort the run with a report and a\n"
+        "                          backtrace if a test runs longer than <sec>\n"
+        "                          seconds. TEC_TIMEOUT tests use their own\n"
+        "                          limit.\n");
+
+    printf(
+        "  --catch-signals         Report SIGSEGV, SIGFPE and SIGBUS in a\n"
+        "                          test as a failure and keep going\n"
+        "                          (C only).\n");
+
+    printf(
+        "  --clock <name>          Clock for test times: 'monotonic'\n"
+        "                          (default) or 'tsc' (calibrated TSC,\n"
+        "                          x86-64 Linux only).\n");
+
+    printf(
+        "  --bench                 Also run benchmarks (TEC_BENCH*), which\n"
+        "                          are skipped by default.\n");
+
+    printf(
+        "  --bench-pin <cpu>       Pin the runner to one CPU for stable\n"
+        "                          benchmark results.\n");
+
+    printf(
+        "  --bench-warmup <n>      Untimed iterations before each benchmark\n"
+        "                          (default 10).\n");
+
+    printf(
+        "  --bench-priority        Run benchmarks with the highest real-time\n"
+        "                          priority (needs privileges).\n");
+
+    printf(
+        "  --bench-cv <pct>        Flag benchmarks whose samples vary by more\n"
+        "                          than <pct> percent (default 5).\n");
+
+    printf(
+        "  --capture               Capture each test's stdout and stderr and\n"
+        "                          show them only if the test fails.\n");
+
+    printf(
+        "  --leak-check            Fail passing tests whose body leaves\n"
+        "                          memory allocated, naming the call sites\n"
+        "                          (glibc only).\n");
+
+    printf(
+        "  --leak-warn             Like --leak-check, but report leaks as\n"
+        "                          warnings instead of failures.\n");
+
+    printf(
+        "  --profile <dir>         Sample each test's stacks with SIGPROF and\n"
+        "                          write them to <dir>/<suite>.<test>.folded\n"
+        "                          for flame graph tools.\n");
+
+    printf(
+        "  --trace <file.json>     Write a timeline of suites, tests and\n"
+        "                          fixtures in Chrome Trace Event format.\n");
+
+    printf(
+        "  --durations <n>         Print the <n> slowest tests and suites\n"
+        "                          with their share of the total time.\n");
+
+    printf("  --no-color              Disable colored output.\n");
+    printf("  --ascii                 Use ASCII symbols instead of Unicode.\n");
+
+    printf("  -h, --help              Display this help message.\n");
+
+    printf("\nExamples:\n");
+
+    printf("  %s -f math\n"
+           "      Run all tests whose suite or name contains 'math'.\n",
+           prog_name);
+
+    printf("  %s -f math -f '!division'\n"
+           "      Run all math tests except those containing 'division'.\n",
+           prog_name);
+
+    printf("  %s --file -f math_utils.c\n"
+           "      Run all tests defined in files matching 'math_utils.c'.\n",
+           prog_name);
+
+    printf("  %s --fail-fast\n"
+           "      Stop as soon as a test fails or unexpectedly passes.\n",
+           prog_name);
+}
+
+int tec_parse_args(int argc, char **argv) {
+    tec_context.options.bench_warmup = TEC_BENCH_DEFAULT_WARMUP;
+    tec_context.options.bench_cv_pct = TEC_BENCH_DEFAULT_CV;
+    if (argc < 2) {
+        return 0;
+    }
+    tec_context.options.filters = (char **)calloc(argc, sizeof(char *));
+    if (tec_context.options.filters == NULL) {
+        fprintf(stderr, "%sFailed to allocate memory for filters%s\n", TEC_RED,
                 TEC_RESET);
+        return 1;
+    }
+
+    for (int i = 1; i < argc; ++i) {
+        if ((strcmp(argv[i], "-f") == 0) ||
+            (strcmp(argv[i], "--filter") == 0)) {
+            if (argc > ++i) {
+                tec_context.options
+                    .filters[tec_context.options.filter_count++] = argv[i];
+            } else {
+                fprintf(stderr,
+                        "%sError: Filter option requires an "
+                        "argument.%s\n",
+                        TEC_RED, TEC_RESET);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--file") == 0) {
+            tec_context.options.filter_by_filename = true;
+        } else if (strcmp(argv[i], "--fail-fast") == 0) {
+            tec_context.options.fail_fast = true;
+        } else if (strcmp(argv[i], "--update-snapshots") == 0) {
+            tec_context.options.update_snapshots = true;
+        } else if (strcmp(argv[i], "--max-test-time") == 0) {
+            char *end = NULL;
+            if (argc > ++i) {
+                tec_context.options.max_test_time_ms = strtod(argv[i], &end);
+            }
+            if (end == NULL || end == argv[i] || *end != '\0' ||
+                tec_context.options.max_test_time_ms <= 0.0) {
+                fprintf(stderr,
+                        "%sError: --max-test-time requires a positive number "
+                        "of milliseconds.%s\n",
+                        TEC_RED, TEC_RESET);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--timeout") == 0) {
+            char *end = NULL;
+            if (argc > ++i) {
+                tec_context.options.timeout_s = strtod(argv[i], &end);
+            }
+            if (end == NULL || end == argv[i] || *end != '\0' ||
+                tec_context.options.timeout_s <= 0.0) {
+                fprintf(stderr,
+                        "%sError: --timeout requires a positive number of "
+                        "seconds.%s\n",
+                        TEC_RED, TEC_RESET);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--catch-signals") == 0) {
+            tec_context.options.catch_signals = true;
+        } else if (strcmp(argv[i], "--clock") == 0) {
+            const char *name = argc > ++i ? argv[i] : "";
+            if (strcmp(name, "tsc") == 0) {
+                tec_context.options.tsc_clock = true;
+            } else if (strcmp(name, "monotonic") != 0) {
+                fprintf(stderr,
+                        "%sError: --clock must be 'monotonic' or 'tsc'.%s\n",
+                        TEC_RED, TEC_RESET);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--bench") == 0) {
+            tec_context.options.bench = true;
+        } else if (strcmp(argv[i], "--bench-pin") == 0) {
+            char *end = NULL;
+            long cpu = -1;
+            if (argc > ++i) {
+                cpu = strtol(argv[i], &end, 10);
+            }
+            if (end == NULL || end == argv[i] || *end != '\0' || cpu < 0 ||
+                cpu > 1023) {
+                fprintf(stderr,
+                        "%sError: --bench-pin requires a CPU number.%s\n",
+                        TEC_RED, TEC_RESET);
+                return 1;
+            }
+            tec_context.options.bench_pin = (int)cpu;
+            tec_context.options.bench_pin_set = true;
+        } else if (strcmp(argv[i], "--bench-warmup") == 0) {
+            char *end = NULL;
+            if (argc > ++i) {
+                tec_context.options.bench_warmup =
+                    (size_t)strtoul(argv[i], &end, 10);
+            }
+            if (end == NULL || end == argv[i] || *end != '\0') {
+                fprintf(stderr,
+                        "%sError: --bench-warmup requires a number of "
+                        "iterations.%s\n",
+                        TEC_RED, TEC_RESET);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--bench-cv") == 0) {
+            char *end = NULL;
+            if (argc > ++i) {
+                tec_context.options.bench_cv_pct = strtod(argv[i], &end);
+            }
+            if (end == NULL || end == argv[i] || *end != '\0' ||
+                tec_context.options.bench_cv_pct <= 0.0) {
+                fprintf(stderr,
+                        "%sError: --bench-cv requires a positive "
+                        "percentage.%s\n",
+                        TEC_RED, TEC_RESET);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--bench-priority") == 0) {
+            tec_context.options.bench_priority = true;
+        } else if (strcmp(argv[i], "--capture") == 0) {
+            tec_context.options.capture = true;
+        } else if (strcmp(argv[i], "--leak-check") == 0) {
+            tec_context.options.leak_check = true;
+        } else if (strcmp(argv[i], "--leak-warn") == 0) {
+            tec_context.options.leak_check = true;
+            tec_context.options.leak_warn = true;
+        } else if (strcmp(argv[i], "--trace") == 0) {
+            if (argc > ++i) {
+                tec_context.options.trace_path = argv[i];
+            } else {
+                fprintf(stderr,
+                        "%sError: --trace requires a file name.%s\n",
+                        TEC_RED, TEC_RESET);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--profile") == 0) {
+            if (argc > ++i) {
+                tec_context.options.profile_dir = argv[i];
+            } else {
+                fprintf(stderr,
+                        "%sError: --profile requires a directory.%s\n",
+                        TEC_RED, TEC_RESET);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--budget-warn") == 0) {
+            tec_context.options.budget_warn = true;
+        } else if (strcmp(argv[i], "--durations") == 0) {
+            char *end = NULL;
+            unsigned long n = 0;
+            if (argc > ++i) {
+                n = strtoul(argv[i], &end, 10);
+            }
+            if (end == NULL || end == argv[i] || *end != '\0' || n == 0) {
+                fprintf(stderr,
+                        "%sError: --durations requires a positive count.%s\n",
+                        TEC_RED, TEC_RESET);
+                return 1;
+            }
+            tec_context.options.durations = (size_t)n;
+        } else if (strcmp(argv[i], "--no-color") == 0) {
+            tec_context.options.no_color = true;
+        } else if (strcmp(argv[i], "--ascii") == 0) {
+            tec_context.options.use_ascii = true;
+        } else if (strcmp(argv[i], "-h") == 0 ||
+                   strcmp(argv[i], "--help") == 0) {
+            tec_print_usage(argv[0]);
+            return 1;
+        } else {
+            fprintf(stderr, "%sError: Unknown option '%s'%s\n", TEC_RED,
+                    TEC_RESET, argv[i]);
+            tec_print_usage(argv[0]);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+bool tec_should_run(const tec_entry_t *test) {
+    char full_name_buffer[TEC_TMP_STRBUF_LEN];
+    const char *target_string;
+
+    if (tec_context.options.filter_by_filename) {
+        target_string = test->file;
+    } else {
+        snprintf(full_name_buffer, sizeof(full_name_buffer), "%s.%s",
+                 test->suite, test->name);
+        target_string = full_name_buffer;
+    }
+
+    /* IMPORTANT:
+     * Exclusion filters are vetoes and MUST be evaluated before any inclusion
+     * decision is made. Never early-return on an inclusion match, doing so
+     * allows a later exclusion to be silently ignored depending on filter
+     * order. Accepting a test is a conclusion; excluding a test is a hard stop.
+     *
+     * Historical bug (now fixed):
+     *   ./tests/test_runner -f math -f '!division'
+     *
+     * Target:
+     *   mathutils.division
+     *
+     * A previous implementation returned true as soon as the "math" inclusion
+     * matched, skipping evaluation of the "!division" exclusion and incorrectly
+     * running the test.
+     *
+     * All exclusion filters must be checked before deciding to run a test.
+     */
+    bool has_inclusion_filters = false;
+    bool inclusion_matched = false;
+    for (size_t i = 0; i < tec_context.options.filter_count; ++i) {
+        const char *f = tec_context.options.filters[i];
+        if (f[0] == '!' && f[1] != '\0') {
+            if (strstr(target_string, f + 1) != NULL) {
+                return false;
+            }
+            continue;
+        }
+        has_inclusion_filters = true;
+        if (strstr(target_string, f) != NULL) {
+            inclusion_matched = true;
+        }
+    }
+
+    // If inclusion filters exist, require a match.
+    // Otherwise (only exclusions), allow.
+    return has_inclusion_filters ? inclusion_matched : true;
+}
+
+/*
+ * --catch-signals (C only): SIGSEGV, SIGFPE and SIGBUS raised while a test or
+ * fixture runs are turned into a failure carrying the signal name and the
+ * faulting address, and the runner moves on to the next test. The handlers run
+ * on an alternate stack so stack overflows are caught as well. There is no
+ * fork per test, so a crash can still leave leaked or corrupted state behind.
+ */
+#ifndef _WIN32
+#define TEC_FATAL_SIGNAL_COUNT 3
+#define TEC_ALTSTACK_SIZE 65536
+
+typedef struct {
+    bool installed;
+    void *altstack;
+    stack_t old_altstack;
+    struct sigaction old_actions[TEC_FATAL_SIGNAL_COUNT];
+} tec_signal_guard_t;
+
+tec_signal_guard_t tec_signal_guard;
+const int tec_fatal_signals[TEC_FATAL_SIGNAL_COUNT] = {SIGSEGV, SIGFPE, SIGBUS};
+
+void _tec_describe_signal(const siginfo_t *info, const char **name,
+                          const char **what) {
+    *what = "fatal signal";
+    switch (info->si_signo) {
+    case SIGSEGV:
+        *name = "SIGSEGV";
+        *what = info->si_code == SEGV_ACCERR ? "invalid permissions"
+                                             : "address not mapped";
+        break;
+    case SIGFPE:
+        *name = "SIGFPE";
+        if (info->si_code == FPE_INTDIV)
+            *what = "integer divide by zero";
+        else if (info->si_code == FPE_INTOVF)
+            *what = "integer overflow";
+        else
+            *what = "arithmetic exception";
+        break;
+    case SIGBUS:
+        *name = "SIGBUS";
+        *what = info->si_code == BUS_ADRALN ? "misaligned address"
+                                            : "bus error";
+        break;
+    default:
+        *name = "signal";
+        break;
+    }
+}
+
+void _tec_on_fatal_signal(int sig, siginfo_t *info, void *ucontext) {
+    (void)ucontext;
+    if (!tec_context.signal_jump_set || _tec_thread_context != &tec_context) {
+        // not inside a test, or on a TEC_CONCURRENT worker that the runner
+        // cannot unwind: crash the way we would have without a handler.
+        signal(sig, SIG_DFL);
+        raise(sig);
+        return;
+    }
+    const char *name;
+    const char *what;
+    tec_context.signal_jump_set = 0;
+    _tec_describe_signal(info, &name, &what);
+    tec_context.crash_signal = name;
+    // snprintf is not formally async-signal-safe, but the code that crashed
+    // is a test body, not the runner's own stdio.
+    snprintf(tec_context.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,
+             TEC_PRE_SPACE "%sTest crashed: %s (%s) at address %p\n",
+             tec_fail_prefix, name, what, info->si_addr);
+    siglongjmp(tec_context.signal_jump_buffer, 1);
+}
+
+// returns true if this call installed the handlers.
+bool _tec_signals_install(void) {
+    stack_t ss;
+    struct sigaction sa;
+    if (tec_signal_guard.installed)
+        return false;
+    tec_signal_guard.altstack = malloc(TEC_ALTSTACK_SIZE);
+    if (tec_signal_guard.altstack == NULL)
+        return false;
+    memset(&ss, 0, sizeof(ss));
+    ss.ss_sp = tec_signal_guard.altstack;
+    ss.ss_size = TEC_ALTSTACK_SIZE;
+    sigaltstack(&ss, &tec_signal_guard.old_altstack);
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = _tec_on_fatal_signal;
+    sa.sa_flags = SA_SIGINFO | SA_ONSTACK;
+    sigemptyset(&sa.sa_mask);
+    for (int i = 0; i < TEC_FATAL_SIGNAL_COUNT; ++i) {
+        sigaction(tec_fatal_signals[i], &sa, &tec_signal_guard.old_actions[i]);
+    }
+    tec_signal_guard.installed = true;
+    return true;
+}
+
+void _tec_signals_uninstall(void) {
+    if (!tec_signal_guard.installed)
+        return;
+    for (int i = 0; i < TEC_FATAL_SIGNAL_COUNT; ++i) {
+        sigaction(tec_fatal_signals[i], &tec_signal_guard.old_actions[i],
+                  NULL);
+    }
+    sigaltstack(&tec_signal_guard.old_altstack, NULL);
+    free(tec_signal_guard.altstack);
+    memset(&tec_signal_guard, 0, sizeof(tec_signal_guard));
+}
+#endif
+
+// calls `func`, returning true if it was ended by a fatal signal.
+bool _tec_guarded_call(tec_fixture_func_t func) {
+#ifndef _WIN32
+    if (tec_signal_guard.installed) {
+        // saving the signal mask lets siglongjmp unblock the caught signal.
+        if (sigsetjmp(tec_context.signal_jump_buffer, 1) == 0) {
+            tec_context.signal_jump_set = 1;
+            _tec_profile_mark();
+            func();
+            tec_context.signal_jump_set = 0;
+            return false;
+        }
+        tec_context.current_failed++;
+        return true;
+    }
+#endif
+    _tec_profile_mark();
+    func();
+    return false;
+}
+
+/*
+ * a failed assertion longjmp()s past _tec_guarded_call(), whose frame, and
+ * with it the signal jump buffer, is gone; a later fatal signal must not
+ * jump back into it.
+ */
+void _tec_guarded_call_abandoned(void) {
+#ifndef _WIN32
+    tec_context.signal_jump_set = 0;
+#endif
+}
+
+/*
+ * --trace: spans for suites, tests and fixtures are appended to an in-memory
+ * array while the run goes on and written once, at the end, in the Chrome
+ * Trace Event format (chrome://tracing, ui.perfetto.dev).
+ */
+void _tec_trace_span(const char *category, const char *name,
+                     const char *suite, const char *result, uint64_t start_ns) {
+    if (tec_context.options.trace_path == NULL || tec_context.trace.overflowed)
+        return;
+    if (tec_context.trace.count == tec_context.trace.capacity) {
+        size_t capacity = tec_context.trace.capacity == 0
+                              ? 256
+                              : tec_context.trace.capacity * 2;
+        tec_trace_event_t *events = (tec_trace_event_t *)realloc(
+            tec_context.trace.events, capacity * sizeof(tec_trace_event_t));
+        if (events == NULL) {
+            tec_context.trace.overflowed = true;
+            return;
+        }
+        tec_context.trace.events = events;
+        tec_context.trace.capacity = capacity;
+    }
+    tec_trace_event_t *event =
+        &tec_context.trace.events[tec_context.trace.count++];
+    event->category = category;
+    event->name = name;
+    event->suite = suite;
+    event->result = result;
+    event->start_ns = start_ns;
+    event->end_ns = tec_now_ns();
+}
+
+void _tec_json_string(FILE *f, const char *s) {
+    fputc('"', f);
+    for (; s && *s; ++s) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\')
+            fprintf(f, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(f, "\\u%04x", c);
+        else
+            fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+// trace timestamps are in microseconds; keep the nanoseconds as decimals.
+void _tec_json_us(FILE *f, uint64_t ns) {
+    fprintf(f, "%" PRIu64 ".%03u", ns / 1000, (unsigned)(ns % 1000));
+}
+
+bool _tec_trace_write(uint64_t origin_ns) {
+    const char *path = tec_context.options.trace_path;
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        fprintf(stderr, "%sError: could not write trace to %s.%s\n", TEC_RED,
+                path, TEC_RESET);
+        return false;
+    }
+    fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n", f);
+    fputs("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,"
+          "\"args\":{\"name\":\"tec\"}},\n",
+          f);
+    fputs("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,"
+          "\"args\":{\"name\":\"main\"}}",
+          f);
+    for (size_t i = 0; i < tec_context.trace.count; ++i) {
+        const tec_trace_event_t *event = &tec_context.trace.events[i];
+        uint64_t start = event->start_ns - origin_ns;
+        fputs(",\n{\"name\":", f);
+        _tec_json_string(f, event->name);
+        fputs(",\"cat\":", f);
+        _tec_json_string(f, event->category);
+        fputs(",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":", f);
+        _tec_json_us(f, start);
+        fputs(",\"dur\":", f);
+        _tec_json_us(f, event->end_ns - event->start_ns);
+        if (event->suite != NULL || event->result != NULL) {
+            const char *sep = "{";
+            fputs(",\"args\":", f);
+            if (event->suite != NULL) {
+                fputs("{\"suite\":", f);
+                _tec_json_string(f, event->suite);
+                sep = ",";
+            }
+            if (event->result != NULL) {
+                fprintf(f, "%s\"result\":", sep);
+                _tec_json_string(f, event->result);
+            }
+            fputc('}', f);
+        }
+        fputc('}', f);
+    }
+    fputs("\n]}\n", f);
+    if (fclose(f) != 0) {
+        fprintf(stderr, "%sError: could not write trace to %s.%s\n", TEC_RED,
+                path, TEC_RESET);
+        return false;
+    }
+    if (tec_context.trace.overflowed) {
+        fprintf(stderr,
+                "%sWarning: ran out of memory for --trace, the trace is "
+                "incomplete.%s\n",
+                TEC_YELLOW, TEC_RESET);
+    }
+    return true;
+}
+
+bool _fixture_exec_helper(tec_fixture_func_t func, const char *token) {
+    bool has_failed = false;
+    bool should_print = token == NULL ? false : true;
+    uint64_t start_ns = tec_now_ns();
+#ifdef __cplusplus
+    try {
+        func();
+    } catch (...) {
+        if (should_print) {
+            printf(TEC_PRE_SPACE_SHORT "%s%s Failed!\n", tec_fail_prefix,
+                   token);
+            printf("%s", tec_context.failure_message);
+        }
+        has_failed = true;
+    }
+#else
+    tec_context.jump_set = true;
+    if (setjmp(tec_context.jump_buffer) == TEC_INITIAL) {
+        has_failed = _tec_guarded_call(func);
+    } else {
+        _tec_guarded_call_abandoned();
+        has_failed = true;
+    }
+    tec_context.jump_set = false;
+    if (has_failed && should_print) {
+        printf(TEC_PRE_SPACE_SHORT "%s%s Failed!\n", tec_fail_prefix, token);
+        printf("%s", tec_context.failure_message);
+    }
+#endif
+    // test setup is the only fixture that runs without a token.
+    _tec_trace_span("fixture", token ? token : "Test Setup",
+                    NULL, has_failed ? "failed" : NULL, start_ns);
+    return has_failed;
+}
+
+// TEC_FIXTURE: readies the suite's fixture for the next test; true if failed.
+bool _tec_fixture_prepare(tec_suite_t *suite) {
+    tec_context.fixture = NULL;
+    if (suite == NULL || suite->fixture_size == 0)
+        return false;
+    if (suite->fixture == NULL) {
+        suite->fixture = calloc(1, suite->fixture_size);
+        if (suite->fixture == NULL) {
+            snprintf(tec_context.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,
+                     TEC_PRE_SPACE "%sCould not allocate the %zu-byte "
+                                   "fixture of suite %s\n",
+                     tec_line_prefix, suite->fixture_size, suite->name);
+            return true;
+        }
+    } else if (suite->fixture_reset == NULL) {
+        memset(suite->fixture, 0, suite->fixture_size);
+    }
+    tec_context.fixture = suite->fixture;
+    if (suite->fixture_reset)
+        return _fixture_exec_helper(suite->fixture_reset, NULL);
+    return false;
+}
+
+// runs TEC_FIXTURE_RELEASE after the suite teardown, then frees the fixture.
+void _tec_fixture_free(tec_suite_t *suite) {
+    if (suite == NULL || suite->fixture == NULL)
+        return;
+    tec_context.fixture = suite->fixture;
+    if (suite->fixture_release)
+        _fixture_exec_helper(suite->fixture_release, "Fixture Release");
+    free(suite->fixture);
+    suite->fixture = NULL;
+    tec_context.fixture = NULL;
+}
+
+/*
+ * Watchdog for hung tests. A helper thread sleeps until the running test's
+ * deadline; arming and disarming it around each test costs two uncontended
+ * lock round-trips. If a deadline passes, the watchdog prints which test hung
+ * and for how long, asks the test thread to dump its own backtrace (POSIX:
+ * via a signal, so the frames are the stuck ones) and ends the run, since a
+ * thread cannot be safely cancelled in the middle of arbitrary test code.
+ */
+typedef struct {
+#ifdef _WIN32
+    HANDLE thread;
+    CRITICAL_SECTION lock;
+    CONDITION_VARIABLE wake;
+#else
+    pthread_t thread;
+    pthread_t test_thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+#endif
+    bool running;
+    bool stop;
+    bool armed;
+    const tec_entry_t *test;
+    double limit_s;
+    uint64_t start_ns;
+    uint64_t deadline_ns;
+    volatile sig_atomic_t dumped;
+} tec_watchdog_t;
+
+tec_watchdog_t tec_watchdog;
+
+#ifndef _WIN32
+// the real stderr, even while --capture has redirected fd 2.
+int _tec_report_fd(void) {
+    return tec_context.capture.active ? tec_context.capture.saved_err
+                                      : STDERR_FILENO;
+}
+#endif
+
+void _tec_watchdog_write(const char *msg) {
+#ifdef _WIN32
+    fputs(msg, stderr);
+    fflush(stderr);
+#else
+    int fd = _tec_report_fd();
+    size_t len = strlen(msg);
+    while (len > 0) {
+        ssize_t n = write(fd, msg, len);
+        if (n <= 0)
+            break;
+        msg += n;
+        len -= (size_t)n;
+    }
+#endif
+}
+
+#ifndef _WIN32
+// runs on the hung test's thread, so the frames below are the stuck ones.
+void _tec_watchdog_on_signal(int sig) {
+    (void)sig;
+#ifdef TEC_HAVE_BACKTRACE
+    void *frames[TEC_BACKTRACE_DEPTH];
+    int depth = backtrace(frames, TEC_BACKTRACE_DEPTH);
+    backtrace_symbols_fd(frames, depth, _tec_report_fd());
+#else
+    _tec_watchdog_write("  (backtrace not available on this platform)\n");
+#endif
+    tec_watchdog.dumped = 1;
+}
+#endif
+
+// called with the lock held once the deadline has passed; never returns.
+void _tec_watchdog_fire(void) {
+    char msg[TEC_TMP_STRBUF_LEN * 2];
+    char limit_buf[32];
+    char elapsed_buf[32];
+    const tec_entry_t *test = tec_watchdog.test;
+    tec_format_time(tec_watchdog.limit_s, limit_buf, sizeof(limit_buf));
+    tec_format_time((double)(tec_now_ns() - tec_watchdog.start_ns) * 1e-9,
+                    elapsed_buf, sizeof(elapsed_buf));
+
+#ifdef _WIN32
+    fflush(stdout);
+#else
+    // the test thread may be stuck inside stdio, don't wait for its lock.
+    if (ftrylockfile(stdout) == 0) {
+        fflush(stdout);
+        funlockfile(stdout);
+    }
+#endif
+    snprintf(msg, sizeof(msg),
+             "\n%sTIMEOUT: %s.%s did not finish within %s (running for %s)%s\n"
+             "  at %s\n",
+             TEC_RED, test->suite, test->name, limit_buf, elapsed_buf,
+             TEC_RESET, test->file);
+    _tec_watchdog_write(msg);
+
+#ifdef _WIN32
+    _tec_watchdog_write("  (backtrace not available on this platform)\n");
+#else
+    _tec_watchdog_write("  Backtrace of the test thread:\n");
+    tec_watchdog.dumped = 0;
+    if (pthread_kill(tec_watchdog.test_thread, SIGURG) == 0) {
+        struct timespec pause = {0, 10 * 1000 * 1000};
+        for (int i = 0; i < 200 && !tec_watchdog.dumped; ++i) {
+            nanosleep(&pause, NULL);
+        }
+    }
+#endif
+    snprintf(msg, sizeof(msg), "%sAborting the test run.%s\n", TEC_RED,
+             TEC_RESET);
+    _tec_watchdog_write(msg);
+    _exit(TEC_TIMEOUT_EXIT_CODE);
+}
+
+#ifdef _WIN32
+DWORD WINAPI _tec_watchdog_main(LPVOID arg) {
+    (void)arg;
+    EnterCriticalSection(&tec_watchdog.lock);
+    while (!tec_watchdog.stop) {
+        if (!tec_watchdog.armed) {
+            SleepConditionVariableCS(&tec_watchdog.wake, &tec_watchdog.lock,
+                                     INFINITE);
+            continue;
+        }
+        uint64_t now = tec_now_ns();
+        if (now >= tec_watchdog.deadline_ns)
+            _tec_watchdog_fire();
+        DWORD wait_ms = (DWORD)((tec_watchdog.deadline_ns - now) / 1000000) + 1;
+        SleepConditionVariableCS(&tec_watchdog.wake, &tec_watchdog.lock,
+                                 wait_ms);
+    }
+    LeaveCriticalSection(&tec_watchdog.lock);
+    return 0;
+}
+#else
+void *_tec_watchdog_main(void *arg) {
+    (void)arg;
+    // --profile samples belong to the test thread.
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGPROF);
+    pthread_sigmask(SIG_BLOCK, &mask, NULL);
+    pthread_mutex_lock(&tec_watchdog.lock);
+    while (!tec_watchdog.stop) {
+        if (!tec_watchdog.armed) {
+            pthread_cond_wait(&tec_watchdog.wake, &tec_watchdog.lock);
+            continue;
+        }
+        uint64_t now = tec_now_ns();
+        if (now >= tec_watchdog.deadline_ns)
+            _tec_watchdog_fire();
+        // the condition variable waits on the wall clock; the deadline is
+        // re-checked against the monotonic clock on every wakeup.
+        uint64_t wait_ns = tec_watchdog.deadline_ns - now;
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += (time_t)(wait_ns / 1000000000ull);
+        ts.tv_nsec += (long)(wait_ns % 1000000000ull);
+        if (ts.tv_nsec >= 1000000000L) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&tec_watchdog.wake, &tec_watchdog.lock, &ts);
+    }
+    pthread_mutex_unlock(&tec_watchdog.lock);
+    return NULL;
+}
+#endif
+
+void _tec_watchdog_start(void) {
+    bool needed = tec_context.options.timeout_s > 0.0;
+    for (size_t i = 0; !needed && i < tec_context.registry.tec_count; ++i) {
+        needed = tec_context.registry.entries[i].timeout_s > 0.0;
+    }
+    if (!needed)
+        return;
+    memset(&tec_watchdog, 0, sizeof(tec_watchdog));
+#ifdef _WIN32
+    InitializeCriticalSection(&tec_watchdog.lock);
+    InitializeConditionVariable(&tec_watchdog.wake);
+    tec_watchdog.thread =
+        CreateThread(NULL, 0, _tec_watchdog_main, NULL, 0, NULL);
+    tec_watchdog.running = tec_watchdog.thread != NULL;
+    if (!tec_watchdog.running)
+        DeleteCriticalSection(&tec_watchdog.lock);
+#else
+#ifdef TEC_HAVE_BACKTRACE
+    // the first backtrace() call may load libgcc, do it outside of a handler.
+    void *frame;
+    backtrace(&frame, 1);
+#endif
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = _tec_watchdog_on_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGURG, &sa, NULL);
+    pthread_mutex_init(&tec_watchdog.lock, NULL);
+    pthread_cond_init(&tec_watchdog.wake, NULL);
+    tec_watchdog.running = pthread_create(&tec_watchdog.thread, NULL,
+                                          _tec_watchdog_main, NULL) == 0;
+    if (!tec_watchdog.running) {
+        pthread_cond_destroy(&tec_watchdog.wake);
+        pthread_mutex_destroy(&tec_watchdog.lock);
+    }
+#endif
+    if (!tec_watchdog.running) {
+        fprintf(stderr,
+                "%sWarning: could not start the watchdog thread, timeouts "
+                "are disabled.%s\n",
+                TEC_YELLOW, TEC_RESET);
+    }
+}
+
+void _tec_watchdog_arm(const tec_entry_t *test) {
+    double limit_s =
+        test->timeout_s > 0.0 ? test->timeout_s : tec_context.options.timeout_s;
+    if (!tec_watchdog.running || limit_s <= 0.0)
+        return;
+#ifdef _WIN32
+    EnterCriticalSection(&tec_watchdog.lock);
+#else
+    pthread_mutex_lock(&tec_watchdog.lock);
+    tec_watchdog.test_thread = pthread_self();
+#endif
+    tec_watchdog.test = test;
+    tec_watchdog.limit_s = limit_s;
+    tec_watchdog.start_ns = tec_now_ns();
+    tec_watchdog.deadline_ns =
+        tec_watchdog.start_ns + (uint64_t)(limit_s * 1e9);
+    tec_watchdog.armed = true;
+#ifdef _WIN32
+    WakeConditionVariable(&tec_watchdog.wake);
+    LeaveCriticalSection(&tec_watchdog.lock);
+#else
+    pthread_cond_signal(&tec_watchdog.wake);
+    pthread_mutex_unlock(&tec_watchdog.lock);
+#endif
+}
+
+void _tec_watchdog_disarm(void) {
+    if (!tec_watchdog.running || !tec_watchdog.armed)
+        return;
+#ifdef _WIN32
+    EnterCriticalSection(&tec_watchdog.lock);
+    tec_watchdog.armed = false;
+    LeaveCriticalSection(&tec_watchdog.lock);
+#else
+    pthread_mutex_lock(&tec_watchdog.lock);
+    tec_watchdog.armed = false;
+    pthread_mutex_unlock(&tec_watchdog.lock);
+#endif
+}
+
+// stops the clock of the running test, e.g. while a death-test child runs
+// under its own limit. Returns the time it was stopped at, 0 if not armed.
+uint64_t _tec_watchdog_suspend(void) {
+    uint64_t now = 0;
+    if (!tec_watchdog.running || !tec_watchdog.armed)
+        return 0;
+#ifdef _WIN32
+    EnterCriticalSection(&tec_watchdog.lock);
+    now = tec_now_ns();
+    tec_watchdog.armed = false;
+    LeaveCriticalSection(&tec_watchdog.lock);
+#else
+    pthread_mutex_lock(&tec_watchdog.lock);
+    now = tec_now_ns();
+    tec_watchdog.armed = false;
+    pthread_mutex_unlock(&tec_watchdog.lock);
+#endif
+    return now;
+}
+
+void _tec_watchdog_resume(uint64_t suspended_at) {
+    if (!tec_watchdog.running || suspended_at == 0)
         return;
-    }
+#ifdef _WIN32
+    EnterCriticalSection(&tec_watchdog.lock);
+#else
+    pthread_mutex_lock(&tec_watchdog.lock);
+#endif
+    uint64_t paused = tec_now_ns() - suspended_at;
+    tec_watchdog.start_ns += paused;
+    tec_watchdog.deadline_ns += paused;
+    tec_watchdog.armed = true;
+#ifdef _WIN32
+    WakeConditionVariable(&tec_watchdog.wake);
+    LeaveCriticalSection(&tec_watchdog.lock);
+#else
+    pthread_cond_signal(&tec_watchdog.wake);
+    pthread_mutex_unlock(&tec_watchdog.lock);
+#endif
+}
 
-    if (tec_context.registry.tec_count >= tec_context.registry.tec_capacity) {
-        tec_context.registry.tec_capacity =
-            tec_context.registry.tec_capacity == 0
-                ? 8
-                : tec_context.registry.tec_capacity * 2;
-        tec_entry_t *new_registry = (tec_entry_t *)realloc(
-            tec_context.registry.entries,
-            tec_context.registry.tec_capacity * sizeof(tec_entry_t));
+void _tec_watchdog_stop(void) {
+    if (!tec_watchdog.running)
+        return;
+#ifdef _WIN32
+    EnterCriticalSection(&tec_watchdog.lock);
+    tec_watchdog.stop = true;
+    WakeConditionVariable(&tec_watchdog.wake);
+    LeaveCriticalSection(&tec_watchdog.lock);
+    WaitForSingleObject(tec_watchdog.thread, INFINITE);
+    CloseHandle(tec_watchdog.thread);
+    DeleteCriticalSection(&tec_watchdog.lock);
+#else
+    pthread_mutex_lock(&tec_watchdog.lock);
+    tec_watchdog.stop = true;
+    pthread_cond_signal(&tec_watchdog.wake);
+    pthread_mutex_unlock(&tec_watchdog.lock);
+    pthread_join(tec_watchdog.thread, NULL);
+    pthread_cond_destroy(&tec_watchdog.wake);
+    pthread_mutex_destroy(&tec_watchdog.lock);
+    signal(SIGURG, SIG_DFL);
+#endif
+    tec_watchdog.running = false;
+}
 
-        if (new_registry == NULL) {
-            fprintf(stderr,
-                    "%sError: Failed to allocate memory for test "
-                    "registry%s\n",
-                    TEC_RED, TEC_RESET);
-            free(tec_context.registry.entries);
-            free(tec_context.registry.suites);
-            exit(1);
-        }
+/*
+ * --profile: while a test body runs, ITIMER_PROF delivers SIGPROF every
+ * TEC_PROFILE_INTERVAL_US of CPU time and the handler copies the stack with
+ * backtrace() into buffers allocated up front. Nothing is symbolized until
+ * the end of the run, when every distinct address is resolved once and each
+ * test's samples are written as folded stacks ("a;b;c count").
+ */
+typedef struct {
+    size_t test_index;
+    uint32_t offset; // into tec_profiler.frames
+    uint32_t depth;
+} tec_profile_sample_t;
 
-        tec_context.registry.entries = new_registry;
+typedef struct {
+    bool running;
+    volatile sig_atomic_t armed;
+    size_t test_index;
+    int base_depth; // frames of the runner below the test function
+    tec_profile_sample_t *samples;
+    size_t sample_count;
+    void **frames;
+    size_t frame_count;
+    size_t dropped;
+#if !defined(_WIN32) && defined(TEC_HAVE_BACKTRACE)
+    struct sigaction old_action;
+#endif
+} tec_profiler_t;
+
+tec_profiler_t tec_profiler;
+
+#if !defined(_WIN32) && defined(TEC_HAVE_BACKTRACE)
+// the handler's own frame and the signal trampoline.
+#define TEC_PROFILE_SKIP 2
+
+void _tec_profile_on_signal(int sig) {
+    (void)sig;
+    if (!tec_profiler.armed)
+        return;
+    void *stack[TEC_BACKTRACE_DEPTH];
+    int depth = backtrace(stack, TEC_BACKTRACE_DEPTH);
+    int keep = depth - TEC_PROFILE_SKIP - tec_profiler.base_depth;
+    if (keep <= 0)
+        return;
+    if (tec_profiler.sample_count >= TEC_PROFILE_MAX_SAMPLES ||
+        tec_profiler.frame_count + (size_t)keep > TEC_PROFILE_MAX_FRAMES) {
+        tec_profiler.dropped++;
+        return;
     }
+    tec_profile_sample_t *sample =
+        &tec_profiler.samples[tec_profiler.sample_count++];
+    sample->test_index = tec_profiler.test_index;
+    sample->offset = (uint32_t)tec_profiler.frame_count;
+    sample->depth = (uint32_t)keep;
+    memcpy(&tec_profiler.frames[tec_profiler.frame_count],
+           &stack[TEC_PROFILE_SKIP], (size_t)keep * sizeof(void *));
+    tec_profiler.frame_count += (size_t)keep;
+}
 
-    tec_context.registry.entries[tec_context.registry.tec_count].suite = suite;
-    tec_context.registry.entries[tec_context.registry.tec_count].name = name;
-    tec_context.registry.entries[tec_context.registry.tec_count].file = file;
-    tec_context.registry.entries[tec_context.registry.tec_count].func = func;
-    tec_context.registry.entries[tec_context.registry.tec_count].xfail = xfail;
-    tec_context.registry.tec_count++;
+void _tec_profile_set_timer(long interval_us) {
+    struct itimerval timer;
+    memset(&timer, 0, sizeof(timer));
+    timer.it_interval.tv_usec = interval_us;
+    timer.it_value.tv_usec = interval_us;
+    setitimer(ITIMER_PROF, &timer, NULL);
 }
+#endif
 
-void tec_register_fixture(const char *suite_name, tec_fixture_func_t func,
-                          tec_fixture_type fixture_type) {
-    tec_suite_t *suite = NULL;
-    for (size_t i = 0; i < tec_context.registry.suite_count; ++i) {
-        if (strcmp(tec_context.registry.suites[i].name, suite_name) == 0) {
-            suite = &tec_context.registry.suites[i];
-            break;
+bool _tec_profile_start(void) {
+#if defined(_WIN32) || !defined(TEC_HAVE_BACKTRACE)
+    return false;
+#else
+    memset(&tec_profiler, 0, sizeof(tec_profiler));
+    tec_profiler.samples = (tec_profile_sample_t *)malloc(
+        TEC_PROFILE_MAX_SAMPLES * sizeof(tec_profile_sample_t));
+    tec_profiler.frames =
+        (void **)malloc(TEC_PROFILE_MAX_FRAMES * sizeof(void *));
+    if (tec_profiler.samples == NULL || tec_profiler.frames == NULL) {
+        free(tec_profiler.samples);
+        free(tec_profiler.frames);
+        return false;
+    }
+    // the first backtrace() call may load libgcc, do it outside of a handler.
+    void *frame;
+    backtrace(&frame, 1);
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = _tec_profile_on_signal;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGPROF, &sa, &tec_profiler.old_action);
+    tec_profiler.running = true;
+    return true;
+#endif
+}
+
+void _tec_profile_begin(size_t test_index) {
+#if !defined(_WIN32) && defined(TEC_HAVE_BACKTRACE)
+    if (!tec_profiler.running)
+        return;
+    // until _tec_profile_mark() knows better, cut below the runner.
+    void *stack[TEC_BACKTRACE_DEPTH];
+    tec_profiler.base_depth = backtrace(stack, TEC_BACKTRACE_DEPTH) - 1;
+    tec_profiler.test_index = test_index;
+    tec_profiler.armed = 1;
+    _tec_profile_set_timer(TEC_PROFILE_INTERVAL_US);
+#else
+    (void)test_index;
+#endif
+}
+
+/*
+ * Called right before the body (or a benchmark's batch of calls to it):
+ * every frame from the caller down to main() belongs to the runner and is
+ * cut off the samples. Its own frame stands in for the body's, so it must
+ * not be inlined.
+ */
+#if !defined(_WIN32) && defined(TEC_HAVE_BACKTRACE)
+__attribute__((noinline))
+#endif
+void _tec_profile_mark(void) {
+#if !defined(_WIN32) && defined(TEC_HAVE_BACKTRACE)
+    if (!tec_profiler.armed)
+        return;
+    // the handler must not call backtrace() while this one runs.
+    tec_profiler.armed = 0;
+    void *stack[TEC_BACKTRACE_DEPTH];
+    tec_profiler.base_depth = backtrace(stack, TEC_BACKTRACE_DEPTH) - 1;
+    tec_profiler.armed = 1;
+#endif
+}
+
+void _tec_profile_end(void) {
+#if !defined(_WIN32) && defined(TEC_HAVE_BACKTRACE)
+    if (!tec_profiler.armed)
+        return;
+    _tec_profile_set_timer(0);
+    tec_profiler.armed = 0;
+#endif
+}
+
+#if !defined(_WIN32) && defined(TEC_HAVE_BACKTRACE)
+int _tec_compare_addresses(const void *a, const void *b) {
+    uintptr_t x = (uintptr_t)(*(void *const *)a);
+    uintptr_t y = (uintptr_t)(*(void *const *)b);
+    return (x > y) - (x < y);
+}
+
+int _tec_compare_strings(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// "./bin(func+0x1a) [0x..]" (glibc) or "3 bin 0x.. func + 26" (macOS) to
+// "func", falling back to "bin+0x1a" when the symbol is not exported.
+void _tec_profile_frame_name(const char *symbol, char *out, size_t size) {
+    const char *open = strchr(symbol, '(');
+    if (open != NULL) {
+        const char *plus = strchr(open, '+');
+        const char *close = strchr(open, ')');
+        if (plus != NULL && plus > open + 1 && (!close || plus < close)) {
+            snprintf(out, size, "%.*s", (int)(plus - open - 1), open + 1);
+            return;
         }
+        const char *base = symbol;
+        for (const char *c = symbol; c < open; ++c) {
+            if (*c == '/')
+                base = c + 1;
+        }
+        if (close != NULL && plus != NULL && plus < close) {
+            snprintf(out, size, "%.*s%.*s", (int)(open - base), base,
+                     (int)(close - plus), plus);
+        } else {
+            snprintf(out, size, "%.*s", (int)(open - base), base);
+        }
+        return;
     }
-    if (suite == NULL) {
-        if (tec_context.registry.suite_count >=
-            tec_context.registry.suite_capacity) {
-            tec_context.registry.suite_capacity =
-                tec_context.registry.suite_capacity == 0
-                    ? 4
-                    : tec_context.registry.suite_capacity * 2;
-            tec_suite_t *new_suites = (tec_suite_t *)realloc(
-                tec_context.registry.suites,
-                tec_context.registry.suite_capacity * sizeof(tec_suite_t));
-            if (!new_suites) {
-                fprintf(stderr,
-                        "%sError: Failed to allocate memory for suite "
-                        "registry%s\n",
-                        TEC_RED, TEC_RESET);
-                free(tec_context.registry.entries);
-                free(tec_context.registry.suites);
-                exit(1);
+    const char *p = symbol;
+    for (int field = 0; field < 3 && *p; ++field) {
+        while (*p && *p != ' ')
+            p++;
+        while (*p == ' ')
+            p++;
+    }
+    const char *end = strstr(p, " + ");
+    size_t len = end ? (size_t)(end - p) : strlen(p);
+    snprintf(out, size, "%.*s", (int)len, *p ? p : symbol);
+    if (len == 0)
+        snprintf(out, size, "%s", symbol);
+}
+
+// writes one test's samples [from, to); identical stacks are merged.
+bool _tec_profile_write_test(const tec_entry_t *test, size_t from, size_t to,
+                             void **addresses, char **names,
+                             size_t address_count) {
+    char path[TEC_PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s.%s.folded",
+             tec_context.options.profile_dir, test->suite, test->name);
+    size_t count = to - from;
+    char **lines = (char **)calloc(count, sizeof(char *));
+    if (lines == NULL)
+        return false;
+    bool ok = true;
+    for (size_t i = 0; ok && i < count; ++i) {
+        const tec_profile_sample_t *sample = &tec_profiler.samples[from + i];
+        size_t cap = 64;
+        size_t len = 0;
+        char *line = (char *)malloc(cap);
+        for (uint32_t f = sample->depth; line != NULL && f-- > 0;) {
+            void *addr = tec_profiler.frames[sample->offset + f];
+            void **found = (void **)bsearch(&addr, addresses, address_count,
+                                            sizeof(void *),
+                                            _tec_compare_addresses);
+            const char *name = names[found - addresses];
+            size_t need = len + strlen(name) + 2;
+            if (need > cap) {
+                while (need > cap)
+                    cap *= 2;
+                char *grown = (char *)realloc(line, cap);
+                if (grown == NULL) {
+                    free(line);
+                    line = NULL;
+                    break;
+                }
+                line = grown;
             }
-            tec_context.registry.suites = new_suites;
+            len += (size_t)sprintf(line + len, "%s%s", len ? ";" : "", name);
         }
-        suite =
-            &tec_context.registry.suites[tec_context.registry.suite_count++];
-        memset(suite, 0, sizeof(tec_suite_t));
-        suite->name = suite_name;
+        lines[i] = line;
+        ok = line != NULL;
+    }
+    FILE *f = ok ? fopen(path, "w") : NULL;
+    if (f != NULL) {
+        qsort(lines, count, sizeof(char *), _tec_compare_strings);
+        for (size_t i = 0; i < count;) {
+            size_t run = 1;
+            while (i + run < count && strcmp(lines[i], lines[i + run]) == 0)
+                run++;
+            fprintf(f, "%s %zu\n", lines[i], run);
+            i += run;
+        }
+        ok = fclose(f) == 0;
+    } else {
+        ok = false;
     }
+    for (size_t i = 0; i < count; ++i)
+        free(lines[i]);
+    free(lines);
+    return ok;
+}
+#endif
 
-    switch (fixture_type) {
-    case TEC_SUITE_SETUP:
-        suite->setup = func;
-        break;
-    case TEC_SUITE_TEARDOWN:
-        suite->teardown = func;
-        break;
-    case TEC_TEST_SETUP:
-        suite->test_setup = func;
-        break;
-    case TEC_TEST_TEARDOWN:
-        suite->test_teardown = func;
-        break;
+// returns the number of files written.
+size_t _tec_profile_write(void) {
+#if defined(_WIN32) || !defined(TEC_HAVE_BACKTRACE)
+    return 0;
+#else
+    _tec_profile_end();
+    if (!tec_profiler.running || tec_profiler.sample_count == 0)
+        return 0;
+    if (!_tec_mkdirs(tec_context.options.profile_dir)) {
+        fprintf(stderr, "%sError: could not create %s for --profile.%s\n",
+                TEC_RED, tec_context.options.profile_dir, TEC_RESET);
+        return 0;
+    }
+    // symbolize every distinct address once.
+    void **addresses =
+        (void **)malloc(tec_profiler.frame_count * sizeof(void *));
+    if (addresses == NULL)
+        return 0;
+    memcpy(addresses, tec_profiler.frames,
+           tec_profiler.frame_count * sizeof(void *));
+    qsort(addresses, tec_profiler.frame_count, sizeof(void *),
+          _tec_compare_addresses);
+    size_t unique = 0;
+    for (size_t i = 0; i < tec_profiler.frame_count; ++i) {
+        if (unique == 0 || addresses[unique - 1] != addresses[i])
+            addresses[unique++] = addresses[i];
+    }
+    char **symbols = backtrace_symbols(addresses, (int)unique);
+    char **names = (char **)calloc(unique, sizeof(char *));
+    size_t written = 0;
+    if (symbols != NULL && names != NULL) {
+        for (size_t i = 0; i < unique; ++i) {
+            char name[256];
+            _tec_profile_frame_name(symbols[i], name, sizeof(name));
+            for (char *c = name; *c; ++c) {
+                if (*c == ';' || *c == ' ')
+                    *c = '_';
+            }
+            names[i] = (char *)malloc(strlen(name) + 1);
+            if (names[i] != NULL)
+                strcpy(names[i], name);
+            else
+                names[i] = symbols[i];
+        }
+        // samples of one test are contiguous, the tests ran in order.
+        size_t from = 0;
+        while (from < tec_profiler.sample_count) {
+            size_t index = tec_profiler.samples[from].test_index;
+            size_t to = from + 1;
+            while (to < tec_profiler.sample_count &&
+                   tec_profiler.samples[to].test_index == index)
+                to++;
+            if (_tec_profile_write_test(&tec_context.registry.entries[index],
+                                        from, to, addresses, names, unique))
+                written++;
+            from = to;
+        }
+        for (size_t i = 0; i < unique; ++i) {
+            if (names[i] != symbols[i])
+                free(names[i]);
+        }
     }
+    free(names);
+    free(symbols);
+    free(addresses);
+    if (tec_profiler.dropped > 0) {
+        fprintf(stderr,
+                "%sWarning: --profile buffers were full, %zu sample(s) "
+                "dropped.%s\n",
+                TEC_YELLOW, tec_profiler.dropped, TEC_RESET);
+    }
+    return written;
+#endif
 }
 
-tec_suite_t *tec_find_suite(const char *name) {
-    if (!name)
-        return NULL;
-    for (size_t i = 0; i < tec_context.registry.suite_count; ++i) {
-        if (strcmp(tec_context.registry.suites[i].name, name) == 0) {
-            return &tec_context.registry.suites[i];
+void _tec_profile_stop(void) {
+#if !defined(_WIN32) && defined(TEC_HAVE_BACKTRACE)
+    if (!tec_profiler.running)
+        return;
+    _tec_profile_end();
+    sigaction(SIGPROF, &tec_profiler.old_action, NULL);
+    free(tec_profiler.samples);
+    free(tec_profiler.frames);
+    memset(&tec_profiler, 0, sizeof(tec_profiler));
+#endif
+}
+
+/*
+ * Death tests. Right after registration the runner forks a small,
+ * single-threaded "zygote" that serves death-test requests over a socket. For
+ * the k-th TEC_ASSERT_DEATH of a test, the zygote forks a child that reruns
+ * the test (fixtures included) up to that assertion and executes its
+ * statement with stderr redirected into a memfd the runner passed along with
+ * the request. Forking the zygote instead of the runner keeps each death test
+ * cheap and free of the runner's threads and state.
+ */
+int _tec_death_enter(void) {
+    size_t index = tec_context.death.index++;
+    if (!tec_context.death.in_child)
+        return TEC_DEATH_CHECK;
+    if (index != tec_context.death.target)
+        return TEC_DEATH_SKIP;
+    tec_context.death.reached = true;
+#ifndef _WIN32
+    // 'S': the statement started; a death without it is not the statement's.
+    char started = 'S';
+    if (write(tec_context.death.marker_fd, &started, 1) < 0) {
+        // the zygote then reports the statement as never reached.
+    }
+#endif
+    return TEC_DEATH_RUN;
+}
+
+#ifndef _WIN32
+#ifdef MSG_NOSIGNAL
+#define TEC_MSG_NOSIGNAL MSG_NOSIGNAL
+#else
+#define TEC_MSG_NOSIGNAL 0
+#endif
+
+typedef struct {
+    uint32_t test_index;
+    uint32_t death_index;
+    uint32_t timeout_ms; // 0 means no limit
+} tec_death_request_t;
+
+typedef struct {
+    int status; // waitpid() status of the child
+    char marker; // 0 if the statement killed the child, otherwise why not
+} tec_death_response_t;
+
+bool _tec_send_with_fd(int sock, const void *buf, size_t len, int fd) {
+    struct msghdr msg;
+    struct iovec iov;
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    memset(&msg, 0, sizeof(msg));
+    memset(&control, 0, sizeof(control));
+    iov.iov_base = (void *)buf;
+    iov.iov_len = len;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    return sendmsg(sock, &msg, TEC_MSG_NOSIGNAL) == (ssize_t)len;
+}
+
+bool _tec_recv_with_fd(int sock, void *buf, size_t len, int *fd) {
+    struct msghdr msg;
+    struct iovec iov;
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = buf;
+    iov.iov_len = len;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+    *fd = -1;
+    ssize_t got;
+    do {
+        got = recvmsg(sock, &msg, 0);
+    } while (got < 0 && errno == EINTR);
+    if (got != (ssize_t)len)
+        return false;
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg && cmsg->cmsg_level == SOL_SOCKET &&
+        cmsg->cmsg_type == SCM_RIGHTS) {
+        memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+    }
+    return true;
+}
+
+bool _tec_read_full(int fd, void *buf, size_t len) {
+    char *p = (char *)buf;
+    while (len > 0) {
+        ssize_t got = read(fd, p, len);
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got <= 0)
+            return false;
+        p += got;
+        len -= (size_t)got;
+    }
+    return true;
+}
+
+void _tec_death_exit(char marker) {
+    if (marker != 0 && write(tec_context.death.marker_fd, &marker, 1) < 0) {
+        // nothing left to report to.
+    }
+    _exit(0);
+}
+
+// death-test child: replay the test until the target assertion. Never returns.
+void _tec_death_child_run(const tec_entry_t *test) {
+    tec_suite_t *suite = tec_find_suite(test->suite);
+#ifdef __cplusplus
+    try {
+        if (suite && suite->setup)
+            suite->setup();
+        tec_context.death.index = 0;
+        if (!_tec_fixture_prepare(suite)) {
+            if (suite && suite->test_setup)
+                suite->test_setup();
+            test->func();
         }
+    } catch (...) {
     }
-    return NULL;
+#else
+    tec_context.jump_set = true;
+    if (setjmp(tec_context.jump_buffer) == TEC_INITIAL) {
+        if (suite && suite->setup)
+            suite->setup();
+        tec_context.death.index = 0;
+        if (!_tec_fixture_prepare(suite)) {
+            if (suite && suite->test_setup)
+                suite->test_setup();
+            test->func();
+        }
+    }
+    tec_context.jump_set = false;
+#endif
+    // 'X': the statement threw or failed an assertion, 'U': never got there.
+    _tec_death_exit(tec_context.death.reached ? 'X' : 'U');
 }
 
-void tec_process_test_result(JUMP_CODES jump_val, const tec_entry_t *test,
-                             double elapsed) {
-    char time_buf[32];
-    tec_format_time(elapsed, time_buf, sizeof(time_buf));
+void _tec_zygote_serve(int sock) {
+    for (;;) {
+        tec_death_request_t req;
+        tec_death_response_t resp;
+        int out_fd = -1;
+        int marker[2];
+        if (!_tec_recv_with_fd(sock, &req, sizeof(req), &out_fd))
+            _exit(0);
+        memset(&resp, 0, sizeof(resp));
+        resp.marker = 'F';
+        if (req.test_index < tec_context.registry.tec_count &&
+            pipe(marker) == 0) {
+            pid_t child = fork();
+            if (child == 0) {
+                int devnull = open("/dev/null", O_WRONLY);
+                close(sock);
+                close(marker[0]);
+                if (devnull >= 0) {
+                    dup2(devnull, STDOUT_FILENO);
+                    close(devnull);
+                }
+                if (out_fd >= 0) {
+                    dup2(out_fd, STDERR_FILENO);
+                    close(out_fd);
+                }
+                if (req.timeout_ms > 0) {
+                    struct itimerval limit;
+                    memset(&limit, 0, sizeof(limit));
+                    limit.it_value.tv_sec = req.timeout_ms / 1000;
+                    limit.it_value.tv_usec = (req.timeout_ms % 1000) * 1000;
+                    setitimer(ITIMER_REAL, &limit, NULL);
+                }
+                tec_context.death.in_child = true;
+                tec_context.death.target = req.death_index;
+                tec_context.death.marker_fd = marker[1];
+                _tec_death_child_run(
+                    &tec_context.registry.entries[req.test_index]);
+            }
+            close(marker[1]);
+            if (child > 0) {
+                while (waitpid(child, &resp.status, 0) < 0 && errno == EINTR) {
+                }
+                // 'S' once the statement starts, then the exit marker if the
+                // child got as far as writing one.
+                char got[2] = {0, 0};
+                ssize_t n = read(marker[0], got, sizeof(got));
+                if (n <= 0)
+                    resp.marker = 'U';
+                else if (got[0] != 'S')
+                    resp.marker = got[0];
+                else
+                    resp.marker = n == 2 ? got[1] : 0;
+            }
+            close(marker[0]);
+        }
+        if (out_fd >= 0)
+            close(out_fd);
+        if (write(sock, &resp, sizeof(resp)) != (ssize_t)sizeof(resp))
+            _exit(0);
+    }
+}
 
-    bool has_failed = (jump_val == TEC_FAIL || tec_context.current_failed > 0);
-    if (jump_val == TEC_SKIP_e) {
-        tec_context.stats.skipped_tests++;
-        printf(TEC_PRE_SPACE_SHORT "%s%s %s(%s)%s\n", tec_skip_prefix,
-               test->name, TEC_GRAY, time_buf, TEC_RESET);
-        printf("%s", tec_context.failure_message);
+void _tec_zygote_start(void) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+        return;
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
         return;
     }
-    if (test->xfail) {
-        if (has_failed) {
-            tec_context.stats.xfailed_tests++;
-            printf(TEC_PRE_SPACE_SHORT "%s%s (expected failure) %s(%s)%s\n",
-                   tec_pass_prefix, test->name, TEC_GRAY, time_buf, TEC_RESET);
+    if (pid == 0) {
+        close(fds[0]);
+        _tec_zygote_serve(fds[1]);
+    }
+    close(fds[1]);
+    tec_context.death.zygote_pid = pid;
+    tec_context.death.zygote_fd = fds[0];
+}
+
+void _tec_zygote_stop(void) {
+    if (tec_context.death.zygote_pid <= 0)
+        return;
+    close(tec_context.death.zygote_fd);
+    while (waitpid(tec_context.death.zygote_pid, NULL, 0) < 0 &&
+           errno == EINTR) {
+    }
+    tec_context.death.zygote_pid = 0;
+}
+
+void _tec_describe_death(const tec_death_response_t *resp, double timeout_s,
+                         char *buf, size_t size) {
+    char time_buf[32];
+    switch (resp->marker) {
+    case 'F':
+        snprintf(buf, size, "the fork server could not start a child");
+        return;
+    case 'U':
+        if (WIFSIGNALED(resp->status)) {
+            snprintf(buf, size,
+                     "never reached in the child, which was killed by signal "
+                     "%d (%s) before it",
+                     WTERMSIG(resp->status), strsignal(WTERMSIG(resp->status)));
         } else {
-            tec_context.stats.xpassed_tests++;
-            printf(TEC_PRE_SPACE_SHORT "%s%s (unexpected success) %s(%s)%s\n",
-                   tec_fail_prefix, test->name, TEC_GRAY, time_buf, TEC_RESET);
+            snprintf(buf, size,
+                     "never reached in the child (an earlier assertion failed "
+                     "or the code before it is not repeatable)");
+        }
+        return;
+    case 'R':
+        snprintf(buf, size, "statement returned normally");
+        return;
+    case 'X':
+        snprintf(buf, size,
+                 "statement threw or failed an assertion instead of dying");
+        return;
+    }
+    if (WIFEXITED(resp->status)) {
+        snprintf(buf, size, "exited with status %d",
+                 WEXITSTATUS(resp->status));
+    } else if (WIFSIGNALED(resp->status) && WTERMSIG(resp->status) == SIGALRM &&
+               timeout_s > 0.0) {
+        tec_format_time(timeout_s, time_buf, sizeof(time_buf));
+        snprintf(buf, size, "killed after the %s test timeout", time_buf);
+    } else if (WIFSIGNALED(resp->status)) {
+        snprintf(buf, size, "killed by signal %d (%s)",
+                 WTERMSIG(resp->status), strsignal(WTERMSIG(resp->status)));
+    } else {
+        snprintf(buf, size, "unknown wait status 0x%x", resp->status);
+    }
+}
+
+// reads the whole captured stderr into a NUL-terminated buffer.
+char *_tec_read_captured(int fd, size_t *len) {
+    struct stat st;
+    *len = 0;
+    if (fstat(fd, &st) != 0)
+        return NULL;
+    char *text = (char *)malloc((size_t)st.st_size + 1);
+    if (text == NULL)
+        return NULL;
+    while (*len < (size_t)st.st_size) {
+        ssize_t got = pread(fd, text + *len, (size_t)st.st_size - *len,
+                            (off_t)*len);
+        if (got <= 0)
+            break;
+        *len += (size_t)got;
+    }
+    text[*len] = '\0';
+    return text;
+}
+#endif
+
+bool _tec_death_check(int expected, const char *stderr_regex,
+                      const char *statement, int line) {
+#ifdef _WIN32
+    (void)expected;
+    (void)stderr_regex;
+    (void)statement;
+    _tec_skip_impl("TEC_ASSERT_DEATH needs fork(), which Windows lacks", line);
+    return false;
+#else
+    const tec_entry_t *test = tec_context.current_test;
+    tec_death_request_t req;
+    tec_death_response_t resp;
+    char expected_buf[96];
+    char actual_buf[160];
+    char excerpt[TEC_DEATH_STDERR_EXCERPT + 4];
+    bool has_regex = stderr_regex != NULL && stderr_regex[0] != '\0';
+
+    if (test == NULL || tec_context.death.zygote_pid <= 0) {
+        snprintf(_TEC_CTX.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,
+                 TEC_PRE_SPACE "%sDeath assertion failed (line %d)\n"
+                 TEC_PRE_SPACE "%s%s\n",
+                 tec_fail_prefix, line, tec_line_prefix,
+                 test == NULL ? "TEC_ASSERT_DEATH can only be used in a test"
+                              : "the death-test fork server is not running");
+        return false;
+    }
+
+    double timeout_s =
+        test->timeout_s > 0.0 ? test->timeout_s : tec_context.options.timeout_s;
+    req.test_index = (uint32_t)(test - tec_context.registry.entries);
+    req.death_index = (uint32_t)(tec_context.death.index - 1);
+    req.timeout_ms = (uint32_t)(timeout_s * 1e3);
+
+    int out_fd = _tec_memfd_create("tec-death-stderr");
+    // the child runs under its own time limit, don't count it twice.
+    uint64_t suspended_at = _tec_watchdog_suspend();
+    bool talked = out_fd >= 0 &&
+                  _tec_send_with_fd(tec_context.death.zygote_fd, &req,
+                                    sizeof(req), out_fd) &&
+                  _tec_read_full(tec_context.death.zygote_fd, &resp,
+                                 sizeof(resp));
+    _tec_watchdog_resume(suspended_at);
+    if (!talked) {
+        if (out_fd >= 0)
+            close(out_fd);
+        snprintf(_TEC_CTX.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,
+                 TEC_PRE_SPACE "%sDeath assertion failed (line %d)\n"
+                 TEC_PRE_SPACE "%slost contact with the death-test fork "
+                 "server\n",
+                 tec_fail_prefix, line, tec_line_prefix);
+        return false;
+    }
+
+    size_t err_len = 0;
+    char *err_text = _tec_read_captured(out_fd, &err_len);
+    close(out_fd);
+
+    bool timed_out = resp.marker == 0 && WIFSIGNALED(resp.status) &&
+                     WTERMSIG(resp.status) == SIGALRM && timeout_s > 0.0;
+    bool died = resp.marker == 0 && !timed_out &&
+                (WIFEXITED(resp.status) || WIFSIGNALED(resp.status));
+    bool outcome_ok = died;
+    if (died && expected >= 0x100) {
+        outcome_ok = WIFSIGNALED(resp.status) &&
+                     WTERMSIG(resp.status) == (expected & 0xff);
+    } else if (died && expected >= 0) {
+        outcome_ok = WIFEXITED(resp.status) &&
+                     WEXITSTATUS(resp.status) == (expected & 0xff);
+    }
+
+    bool regex_ok = true;
+    bool regex_valid = true;
+    if (outcome_ok && has_regex) {
+        regex_t re;
+        regex_valid = regcomp(&re, stderr_regex, REG_EXTENDED | REG_NOSUB) == 0;
+        if (regex_valid) {
+            regex_ok = regexec(&re, err_text ? err_text : "", 0, NULL, 0) == 0;
+            regfree(&re);
         }
+    }
+    if (outcome_ok && regex_ok && regex_valid) {
+        free(err_text);
+        return true;
+    }
+
+    if (expected >= 0x100) {
+        snprintf(expected_buf, sizeof(expected_buf), "killed by signal %d (%s)",
+                 expected & 0xff, strsignal(expected & 0xff));
+    } else if (expected >= 0) {
+        snprintf(expected_buf, sizeof(expected_buf), "exit with status %d",
+                 expected & 0xff);
     } else {
-        if (has_failed) {
-            tec_context.stats.failed_tests++;
-            printf(TEC_PRE_SPACE_SHORT
-                   "%s%s - %zu assertion(s) failed %s(%s)%s\n",
-                   tec_fail_prefix, test->name, tec_context.current_failed,
-                   TEC_GRAY, time_buf, TEC_RESET);
-            printf("%s", tec_context.failure_message);
-        } else {
-            tec_context.stats.passed_tests++;
-            printf(TEC_PRE_SPACE_SHORT "%s%s %s(%s)%s\n", tec_pass_prefix,
-                   test->name, TEC_GRAY, time_buf, TEC_RESET);
-        }
+        snprintf(expected_buf, sizeof(expected_buf), "terminate the process");
+    }
+    _tec_describe_death(&resp, timeout_s, actual_buf, sizeof(actual_buf));
+    if (!regex_valid) {
+        snprintf(actual_buf, sizeof(actual_buf), "invalid stderr regex");
+    } else if (!regex_ok) {
+        snprintf(actual_buf, sizeof(actual_buf),
+                 "%s as expected, but stderr did not match",
+                 died ? "died" : "finished");
+    }
+
+    size_t shown = 0;
+    for (size_t i = 0; err_text && i < err_len && shown < sizeof(excerpt) - 4;
+         ++i) {
+        unsigned char c = (unsigned char)err_text[i];
+        excerpt[shown++] = (c < 0x20 || c == 0x7f) ? ' ' : (char)c;
+    }
+    if (err_text && err_len > shown) {
+        memcpy(excerpt + shown, "...", 3);
+        shown += 3;
     }
+    excerpt[shown] = '\0';
+    free(err_text);
+
+    snprintf(_TEC_CTX.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,
+             TEC_PRE_SPACE "%sDeath assertion failed (line %d)\n"
+             TEC_PRE_SPACE "%sStatement: %s\n"
+             TEC_PRE_SPACE "%sExpected: %s%s%s%s\n"
+             TEC_PRE_SPACE "%sActual:   %s\n"
+             TEC_PRE_SPACE "%sStderr:   \"%s\"\n",
+             tec_fail_prefix, line, tec_line_prefix, statement,
+             tec_line_prefix, expected_buf,
+             has_regex ? ", stderr matching /" : "",
+             has_regex ? stderr_regex : "", has_regex ? "/" : "",
+             tec_line_prefix, actual_buf, tec_line_prefix, excerpt);
+    return false;
+#endif
 }
 
-void tec_print_usage(const char *prog_name) {
-    printf("Usage: %s [options]\n", prog_name);
-    printf("\nOptions:\n");
+void _tec_death_survived(void) {
+#ifndef _WIN32
+    _tec_death_exit('R');
+#endif
+}
 
-    printf(
-        "  -f, --filter <pattern>  Run tests whose name contains <pattern>.\n"
-        "                          Matches against 'suite.test' by default.\n"
-        "                          Prefix with '!' to exclude matches.\n");
+#ifdef TEC_HAVE_ASYNC
+/*
+ * TEC_ASYNC: when the runner reaches the first async test of a suite, it
+ * starts every async test of that suite that passes the filters and runs one
+ * epoll loop until all of them have finished. Each test asserts into its own
+ * copy of tec_context, which the loop selects before resuming any coroutine
+ * of that test. The runner then reports the tests in order from what the
+ * loop recorded.
+ */
+#define TEC_ASYNC_MAX_EVENTS 64
 
-    printf(
-        "  --file                  Apply filters to the test filename instead\n"
-        "                          of the test name.\n");
+typedef struct {
+    tec_entry_t *test;
+    void *root; // coroutine frame of the test body, NULL once finished
+    tec_context_t context;
+    bool done;
+    JUMP_CODES result;
+    uint64_t start_ns;
+    uint64_t deadline_ns; // 0 means no timeout
+    uint64_t wall_ns;
+    uint64_t cpu_ns;
+} tec_async_test_t;
 
-    printf(
-        "  --fail-fast             Stop execution after the first failure or\n"
-        "                          unexpected success (XPASS).\n");
+typedef struct {
+    void *handle;    // coroutine to resume
+    size_t test;     // index into tec_async.tests
+    int fd;          // the fd it waits for, or -1 for a timer
+    uint64_t due_ns; // timers only
+} tec_async_wait_t;
 
-    printf("  --no-color              Disable colored output.\n");
-    printf("  --ascii                 Use ASCII symbols instead of Unicode.\n");
+typedef struct {
+    int epoll_fd;
+    tec_async_test_t *tests;
+    size_t count;
+    size_t pending;
+    size_t current; // test whose coroutine is running
+    tec_async_wait_t *waits;
+    size_t wait_count;
+    size_t wait_capacity;
+} tec_async_loop_t;
 
-    printf("  -h, --help              Display this help message.\n");
+tec_async_loop_t tec_async = {-1, NULL, 0, 0, 0, NULL, 0, 0};
 
-    printf("\nExamples:\n");
+typedef std::coroutine_handle<_tec_task_promise<void>> tec_async_root_t;
 
-    printf("  %s -f math\n"
-           "      Run all tests whose suite or name contains 'math'.\n",
-           prog_name);
+void _tec_async_start(void *root) {
+    tec_async.tests[tec_async.current].root = root;
+}
 
-    printf("  %s -f math -f '!division'\n"
-           "      Run all math tests except those containing 'division'.\n",
-           prog_name);
+bool _tec_async_add_wait(void *handle, int fd, uint64_t due_ns) {
+    if (tec_async.wait_count == tec_async.wait_capacity) {
+        size_t capacity =
+            tec_async.wait_capacity ? tec_async.wait_capacity * 2 : 64;
+        bool recording = _tec_leak_record(false);
+        tec_async_wait_t *waits = (tec_async_wait_t *)realloc(
+            tec_async.waits, capacity * sizeof(tec_async_wait_t));
+        _tec_leak_record(recording);
+        if (waits == NULL)
+            return false;
+        tec_async.waits = waits;
+        tec_async.wait_capacity = capacity;
+    }
+    tec_async_wait_t *wait = &tec_async.waits[tec_async.wait_count++];
+    wait->handle = handle;
+    wait->test = tec_async.current;
+    wait->fd = fd;
+    wait->due_ns = due_ns;
+    return true;
+}
 
-    printf("  %s --file -f math_utils.c\n"
-           "      Run all tests defined in files matching 'math_utils.c'.\n",
-           prog_name);
+void _tec_async_remove_wait(size_t i) {
+    if (tec_async.waits[i].fd >= 0)
+        epoll_ctl(tec_async.epoll_fd, EPOLL_CTL_DEL, tec_async.waits[i].fd,
+                  NULL);
+    tec_async.waits[i] = tec_async.waits[--tec_async.wait_count];
+}
 
-    printf("  %s --fail-fast\n"
-           "      Stop as soon as a test fails or unexpectedly passes.\n",
-           prog_name);
+void _tec_async_sleep(uint64_t ns, void *handle) {
+    if (!_tec_async_add_wait(handle, -1, tec_now_ns() + ns)) {
+        // out of memory: resume on the next turn instead of never.
+        _tec_async_add_wait(handle, -1, 0);
+    }
 }
 
-int tec_parse_args(int argc, char **argv) {
-    if (argc < 2) {
-        return 0;
+int _tec_async_wait_fd(int fd, uint32_t events, void *handle) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.fd = fd;
+    if (epoll_ctl(tec_async.epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0)
+        return errno;
+    if (!_tec_async_add_wait(handle, fd, 0)) {
+        epoll_ctl(tec_async.epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+        return ENOMEM;
     }
-    tec_context.options.filters = (char **)calloc(argc, sizeof(char *));
-    if (tec_context.options.filters == NULL) {
-        fprintf(stderr, "%sFailed to allocate memory for filters%s\n", TEC_RED,
-                TEC_RESET);
-        return 1;
+    return 0;
+}
+
+void _tec_async_wait_failed(int fd, int error) TEC_FUCK_MSVC_EH {
+    _TEC_CTX.stats.total_assertions++;
+    snprintf(_TEC_CTX.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,
+             TEC_PRE_SPACE "%sCannot wait for fd %d: %s%s\n", tec_fail_prefix,
+             fd, strerror(error),
+             error == EEXIST ? " (another coroutine is waiting for it)" : "");
+    TEC_POST_FAIL();
+}
+
+// records how the test ended and runs its teardown fixture.
+void _tec_async_finish(size_t k, JUMP_CODES result) {
+    tec_async_test_t *slot = &tec_async.tests[k];
+    const tec_suite_t *suite = tec_find_suite(slot->test->suite);
+    for (size_t i = 0; i < tec_async.wait_count;) {
+        if (tec_async.waits[i].test == k)
+            _tec_async_remove_wait(i);
+        else
+            ++i;
+    }
+    if (slot->root != NULL) {
+        // destroying the frame also destroys the tasks it is awaiting.
+        tec_async_root_t::from_address(slot->root).destroy();
+        slot->root = NULL;
+    }
+    slot->result = result;
+    slot->wall_ns = tec_now_ns() - slot->start_ns;
+    slot->done = true;
+    tec_async.pending--;
+    if (suite && suite->test_teardown) {
+        tec_context.current_test = slot->test;
+        _fixture_exec_helper(suite->test_teardown, "Test Teardown");
     }
+}
 
-    for (int i = 1; i < argc; ++i) {
-        if ((strcmp(argv[i], "-f") == 0) ||
-            (strcmp(argv[i], "--filter") == 0)) {
-            if (argc > ++i) {
-                tec_context.options
-                    .filters[tec_context.options.filter_count++] = argv[i];
-            } else {
-                fprintf(stderr,
-                        "%sError: Filter option requires an "
-                        "argument.%s\n",
-                        TEC_RED, TEC_RESET);
-                return 1;
+void _tec_async_resume(size_t k, void *handle) {
+    tec_async_test_t *slot = &tec_async.tests[k];
+    JUMP_CODES result = TEC_INITIAL;
+    uint64_t cpu_start = tec_thread_cpu_ns();
+    tec_async.current = k;
+    tec_context.current_test = slot->test;
+    _tec_thread_context = &slot->context;
+    std::coroutine_handle<>::from_address(handle).resume();
+    tec_async_root_t root = tec_async_root_t::from_address(slot->root);
+    if (root.done()) {
+        if (root.promise().error) {
+            try {
+                std::rethrow_exception(root.promise().error);
+            } catch (const tec_assertion_failure &) {
+                result = TEC_FAIL;
+            } catch (const tec_skip_test &) {
+                result = TEC_SKIP_e;
+            } catch (const std::exception &e) {
+                _TEC_CTX.current_failed++;
+                snprintf(_TEC_CTX.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,
+                         TEC_PRE_SPACE_SHORT
+                         "%sTest threw an unhandled std::exception: %s\n",
+                         tec_fail_prefix, e.what());
+                result = TEC_FAIL;
+            } catch (...) {
+                _TEC_CTX.current_failed++;
+                snprintf(_TEC_CTX.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,
+                         TEC_PRE_SPACE_SHORT
+                         "%sTest threw an unknown C++ exception.\n",
+                         tec_fail_prefix);
+                result = TEC_FAIL;
             }
-        } else if (strcmp(argv[i], "--file") == 0) {
-            tec_context.options.filter_by_filename = true;
-        } else if (strcmp(argv[i], "--fail-fast") == 0) {
-            tec_context.options.fail_fast = true;
-        } else if (strcmp(argv[i], "--no-color") == 0) {
-            tec_context.options.no_color = true;
-        } else if (strcmp(argv[i], "--ascii") == 0) {
-            tec_context.options.use_ascii = true;
-        } else if (strcmp(argv[i], "-h") == 0 ||
-                   strcmp(argv[i], "--help") == 0) {
-            tec_print_usage(argv[0]);
-            return 1;
-        } else {
-            fprintf(stderr, "%sError: Unknown option '%s'%s\n", TEC_RED,
-                    TEC_RESET, argv[i]);
-            tec_print_usage(argv[0]);
-            return 1;
         }
     }
-    return 0;
+    _tec_thread_context = &tec_context;
+    slot->cpu_ns += tec_thread_cpu_ns() - cpu_start;
+    if (root.done())
+        _tec_async_finish(k, result);
 }
 
-bool tec_should_run(const tec_entry_t *test) {
-    char full_name_buffer[TEC_TMP_STRBUF_LEN];
-    const char *target_string;
+// fails every test that has not finished yet.
+void _tec_async_fail_pending(const char *why) {
+    for (size_t k = 0; k < tec_async.count; ++k) {
+        tec_async_test_t *slot = &tec_async.tests[k];
+        if (slot->done)
+            continue;
+        slot->context.current_failed++;
+        snprintf(slot->context.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,
+                 TEC_PRE_SPACE "%s%s\n", tec_fail_prefix, why);
+        _tec_async_finish(k, TEC_FAIL);
+    }
+}
 
-    if (tec_context.options.filter_by_filename) {
-        target_string = test->file;
-    } else {
-        snprintf(full_name_buffer, sizeof(full_name_buffer), "%s.%s",
-                 test->suite, test->name);
-        target_string = full_name_buffer;
+void _tec_async_reset(void) {
+    for (size_t k = 0; k < tec_async.count; ++k) {
+        if (tec_async.tests[k].root != NULL)
+            tec_async_root_t::from_address(tec_async.tests[k].root).destroy();
     }
+    free(tec_async.tests);
+    free(tec_async.waits);
+    if (tec_async.epoll_fd >= 0)
+        close(tec_async.epoll_fd);
+    memset(&tec_async, 0, sizeof(tec_async));
+    tec_async.epoll_fd = -1;
+}
 
-    /* IMPORTANT:
-     * Exclusion filters are vetoes and MUST be evaluated before any inclusion
-     * decision is made. Never early-return on an inclusion match, doing so
-     * allows a later exclusion to be silently ignored depending on filter
-     * order. Accepting a test is a conclusion; excluding a test is a hard stop.
-     *
-     * Historical bug (now fixed):
-     *   ./tests/test_runner -f math -f '!division'
-     *
-     * Target:
-     *   mathutils.division
-     *
-     * A previous implementation returned true as soon as the "math" inclusion
-     * matched, skipping evaluation of the "!division" exclusion and incorrectly
-     * running the test.
-     *
-     * All exclusion filters must be checked before deciding to run a test.
-     */
-    bool has_inclusion_filters = false;
-    bool inclusion_matched = false;
-    for (size_t i = 0; i < tec_context.options.filter_count; ++i) {
-        const char *f = tec_context.options.filters[i];
-        if (f[0] == '!' && f[1] != '\0') {
-            if (strstr(target_string, f + 1) != NULL) {
-                return false;
+// milliseconds until the next timer or deadline, -1 if there is none.
+int _tec_async_timeout_ms(uint64_t now) {
+    uint64_t next = UINT64_MAX;
+    for (size_t i = 0; i < tec_async.wait_count; ++i) {
+        if (tec_async.waits[i].fd < 0 && tec_async.waits[i].due_ns < next)
+            next = tec_async.waits[i].due_ns;
+    }
+    for (size_t k = 0; k < tec_async.count; ++k) {
+        const tec_async_test_t *slot = &tec_async.tests[k];
+        if (!slot->done && slot->deadline_ns && slot->deadline_ns < next)
+            next = slot->deadline_ns;
+    }
+    if (next == UINT64_MAX)
+        return -1;
+    if (next <= now)
+        return 0;
+    uint64_t ms = (next - now + 999999) / 1000000; // round up, never spin
+    return ms > INT32_MAX ? INT32_MAX : (int)ms;
+}
+
+void _tec_async_loop(void) {
+    struct epoll_event events[TEC_ASYNC_MAX_EVENTS];
+    while (tec_async.pending > 0) {
+        uint64_t now = tec_now_ns();
+        for (size_t i = 0; i < tec_async.wait_count;) {
+            tec_async_wait_t wait = tec_async.waits[i];
+            if (wait.fd >= 0 || wait.due_ns > now) {
+                ++i;
+                continue;
+            }
+            _tec_async_remove_wait(i);
+            _tec_async_resume(wait.test, wait.handle);
+        }
+        for (size_t k = 0; k < tec_async.count; ++k) {
+            tec_async_test_t *slot = &tec_async.tests[k];
+            if (slot->done || !slot->deadline_ns || now < slot->deadline_ns)
+                continue;
+            char limit_buf[32];
+            tec_format_time((double)(slot->deadline_ns - slot->start_ns) * 1e-9,
+                            limit_buf, sizeof(limit_buf));
+            slot->context.current_failed++;
+            snprintf(slot->context.failure_message,
+                     TEC_MAX_FAILURE_MESSAGE_LEN,
+                     TEC_PRE_SPACE "%sTest did not finish within %s\n",
+                     tec_fail_prefix, limit_buf);
+            _tec_async_finish(k, TEC_FAIL);
+        }
+        if (tec_async.pending == 0)
+            break;
+        if (tec_async.wait_count == 0) {
+            _tec_async_fail_pending("Test suspended on something other than "
+                                    "a timer, an fd or a tec_task");
+            break;
+        }
+        int timeout_ms = _tec_async_timeout_ms(tec_now_ns());
+        int n = epoll_wait(tec_async.epoll_fd, events, TEC_ASYNC_MAX_EVENTS,
+                           timeout_ms);
+        if (n < 0 && errno != EINTR) {
+            _tec_async_fail_pending("epoll_wait failed");
+            break;
+        }
+        for (int e = 0; e < n; ++e) {
+            for (size_t i = 0; i < tec_async.wait_count; ++i) {
+                tec_async_wait_t wait = tec_async.waits[i];
+                if (wait.fd != events[e].data.fd)
+                    continue;
+                _tec_async_remove_wait(i);
+                _tec_async_resume(wait.test, wait.handle);
+                break;
             }
+        }
+    }
+}
+
+// starts the async tests of test's suite from test on, and runs them all.
+void _tec_async_run(tec_entry_t *test) {
+    tec_entry_t *end = tec_context.registry.entries +
+                       tec_context.registry.tec_count;
+    const tec_suite_t *suite = tec_find_suite(test->suite);
+    size_t count = 0;
+    _tec_async_reset();
+    for (tec_entry_t *t = test; t < end && strcmp(t->suite, test->suite) == 0;
+         ++t) {
+        if (t->async)
+            count++;
+    }
+    bool recording = _tec_leak_record(false);
+    tec_async.tests =
+        (tec_async_test_t *)calloc(count, sizeof(tec_async_test_t));
+    _tec_leak_record(recording);
+    if (tec_async.tests == NULL)
+        return;
+    // the loop enforces each test's own timeout, and output is not captured.
+    _tec_watchdog_disarm();
+    _tec_capture_end();
+    tec_async.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    for (tec_entry_t *t = test; t < end && strcmp(t->suite, test->suite) == 0;
+         ++t) {
+        if (!t->async ||
+            (tec_context.options.filter_count != 0 && !tec_should_run(t)))
+            continue;
+        size_t k = tec_async.count++;
+        tec_async_test_t *slot = &tec_async.tests[k];
+        double timeout_s =
+            t->timeout_s > 0.0 ? t->timeout_s : tec_context.options.timeout_s;
+        slot->test = t;
+        tec_async.pending++;
+        tec_context.current_test = t;
+        tec_context.failure_message[0] = '\0';
+        if (suite && suite->test_setup &&
+            _fixture_exec_helper(suite->test_setup, NULL)) {
+            _tec_fork_context(&slot->context);
+            snprintf(slot->context.failure_message,
+                     TEC_MAX_FAILURE_MESSAGE_LEN,
+                     TEC_PRE_SPACE "%sSkipped: test setup failed\n%.*s",
+                     tec_skip_prefix, TEC_MAX_FAILURE_MESSAGE_LEN / 2,
+                     tec_context.failure_message);
+            slot->start_ns = tec_now_ns();
+            slot->done = true;
+            slot->result = TEC_SKIP_e;
+            tec_async.pending--;
             continue;
         }
-        has_inclusion_filters = true;
-        if (strstr(target_string, f) != NULL) {
-            inclusion_matched = true;
+        _tec_fork_context(&slot->context);
+        slot->start_ns = tec_now_ns();
+        if (timeout_s > 0.0)
+            slot->deadline_ns = slot->start_ns + (uint64_t)(timeout_s * 1e9);
+        if (tec_async.epoll_fd < 0) {
+            slot->context.current_failed++;
+            snprintf(slot->context.failure_message,
+                     TEC_MAX_FAILURE_MESSAGE_LEN,
+                     TEC_PRE_SPACE "%sepoll_create1 failed: %s\n",
+                     tec_fail_prefix, strerror(errno));
+            _tec_async_finish(k, TEC_FAIL);
+            continue;
         }
+        tec_async.current = k;
+        t->func(); // creates the coroutine frame, see TEC_ASYNC
+        _tec_async_resume(k, slot->root);
     }
+    _tec_async_loop();
+    tec_context.current_test = test;
+}
 
-    // If inclusion filters exist, require a match.
-    // Otherwise (only exclusions), allow.
-    return has_inclusion_filters ? inclusion_matched : true;
+tec_async_test_t *_tec_async_find(const tec_entry_t *test) {
+    for (size_t k = 0; k < tec_async.count; ++k) {
+        if (tec_async.tests[k].test == test)
+            return &tec_async.tests[k];
+    }
+    return NULL;
 }
 
-bool _fixture_exec_helper(tec_fixture_func_t func, const char *token) {
-    bool has_failed = false;
-    bool should_print = token == NULL ? false : true;
-#ifdef __cplusplus
-    try {
-        func();
-    } catch (...) {
-        if (should_print) {
-            printf(TEC_PRE_SPACE_SHORT "%s%s Failed!\n", tec_fail_prefix,
-                   token);
-            printf("%s", tec_context.failure_message);
-        }
-        has_failed = true;
+bool _tec_async_elapsed(const tec_entry_t *test, uint64_t *wall_ns,
+                        uint64_t *cpu_ns) {
+    const tec_async_test_t *slot = _tec_async_find(test);
+    if (slot == NULL)
+        return false;
+    *wall_ns = slot->wall_ns;
+    *cpu_ns = slot->cpu_ns;
+    return true;
+}
+
+// reports a test that the loop already ran.
+void _tec_async_body(void) TEC_FUCK_MSVC_EH {
+    tec_entry_t *test = (tec_entry_t *)tec_context.current_test;
+    tec_async_test_t *slot = _tec_async_find(test);
+    if (slot == NULL) {
+        _tec_async_run(test);
+        slot = _tec_async_find(test);
     }
-#else
-    tec_context.jump_set = true;
-    if (setjmp(tec_context.jump_buffer) == TEC_INITIAL) {
-        func();
-    } else {
-        if (should_print) {
-            printf(TEC_PRE_SPACE_SHORT "%s%s Failed!\n", tec_fail_prefix,
-                   token);
-            printf("%s", tec_context.failure_message);
-        }
-        has_failed = true;
+    if (slot == NULL) {
+        snprintf(tec_context.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN,
+                 TEC_PRE_SPACE "%sCould not allocate the async test loop\n",
+                 tec_fail_prefix);
+        TEC_POST_FAIL();
+        return;
     }
-    tec_context.jump_set = false;
-#endif
-    return has_failed;
+    _tec_merge_context(&slot->context);
+    snprintf(tec_context.failure_message, TEC_MAX_FAILURE_MESSAGE_LEN, "%s",
+             slot->context.failure_message);
+    if (slot->result != TEC_INITIAL)
+        _tec_raise(slot->result);
 }
+#endif
 
 int tec_run_all(int argc, char **argv) {
     int result = 0;
-    double suite_start = 0.0;
-    double total_start = 0.0;
+    uint64_t suite_start = 0;
+    uint64_t total_start = 0;
     double suite_elapsed = 0.0;
     double total_elapsed = 0.0;
+    size_t profile_files = 0;
+    bool trace_failed = false;
+    size_t benchmarks_left_out = 0;
     const char *current_suite = NULL;
-    const tec_suite_t *current_suite_ptr = NULL;
+    tec_suite_t *current_suite_ptr = NULL;
     bool suite_setup_failed = false;
     bool test_setup_failed = false;
     bool has_printed_test_setup_failure = false;
@@ -1141,8 +7630,9 @@ int tec_run_all(int argc, char **argv) {
     if (result)
         goto cleanup;
     tec_init_prefixes();
+    _tec_clock_init();
 
-    total_start = tec_get_time();
+    total_start = tec_now_ns();
 
     printf("%s================================\n", TEC_BLUE);
     printf("         C Test Runner          \n");
@@ -1150,14 +7640,75 @@ int tec_run_all(int argc, char **argv) {
 
     qsort(tec_context.registry.entries, tec_context.registry.tec_count,
           sizeof(tec_entry_t), tec_compare_entries);
+#ifndef _WIN32
+    // fork the death-test server before any helper thread exists.
+    _tec_zygote_start();
+#endif
+    if (tec_context.options.bench_pin_set &&
+        !_tec_bench_pin(tec_context.options.bench_pin)) {
+        fprintf(stderr, "%sWarning: could not pin the runner to CPU %d.%s\n",
+                TEC_YELLOW, tec_context.options.bench_pin, TEC_RESET);
+        tec_context.options.bench_pin_set = false;
+    }
+    for (size_t i = 0; i < tec_context.registry.tec_count; ++i) {
+        const tec_entry_t *entry = &tec_context.registry.entries[i];
+        if (entry->bench && tec_context.options.bench &&
+            (tec_context.options.filter_count == 0 || tec_should_run(entry))) {
+            _tec_bench_probe();
+            break;
+        }
+    }
+    _tec_watchdog_start();
+    if (tec_context.options.catch_signals) {
+#if defined(__cplusplus) || defined(_WIN32)
+        fprintf(stderr,
+                "%sWarning: --catch-signals is only supported for C tests on "
+                "POSIX systems, ignoring it.%s\n",
+                TEC_YELLOW, TEC_RESET);
+#else
+        _tec_signals_install();
+#endif
+    }
+    if (tec_context.options.profile_dir && !_tec_profile_start()) {
+        fprintf(stderr,
+                "%sWarning: --profile needs setitimer() and backtrace(), "
+                "ignoring it.%s\n",
+                TEC_YELLOW, TEC_RESET);
+        tec_context.options.profile_dir = NULL;
+    }
+#ifdef _WIN32
+    if (tec_context.options.capture) {
+        fprintf(stderr,
+                "%sWarning: --capture is only supported on POSIX systems, "
+                "ignoring it.%s\n",
+                TEC_YELLOW, TEC_RESET);
+        tec_context.options.capture = false;
+    }
+#endif
+#ifndef TEC_HAVE_LEAK_CHECK
+    if (tec_context.options.leak_check) {
+        fprintf(stderr,
+                "%sWarning: --leak-check needs glibc and a build with "
+                "TEC_ENABLE_LEAK_CHECK (without ASan), ignoring it.%s\n",
+                TEC_YELLOW, TEC_RESET);
+        tec_context.options.leak_check = false;
+    }
+#endif
 
     for (size_t i = 0; i < tec_context.registry.tec_count; ++i) {
         tec_entry_t *test = &tec_context.registry.entries[i];
 
+        // benchmarks are slow and their numbers vary from host to host, so
+        // a plain run leaves them out.
         if (tec_context.options.filter_count != 0 && !tec_should_run(test)) {
             tec_context.stats.filtered_tests++;
             continue;
         }
+        if (test->bench && !tec_context.options.bench) {
+            tec_context.stats.filtered_tests++;
+            benchmarks_left_out++;
+            continue;
+        }
 
         if (current_suite == NULL || strcmp(current_suite, test->suite) != 0) {
             if (current_suite != NULL) {
@@ -1166,15 +7717,19 @@ int tec_run_all(int argc, char **argv) {
                     _fixture_exec_helper(current_suite_ptr->teardown,
                                          "Suite Teardown");
                 }
-                suite_elapsed = tec_get_time() - suite_start;
+                _tec_fixture_free(current_suite_ptr);
+                _tec_trace_span("suite", current_suite, NULL, NULL,
+                                suite_start);
+                suite_elapsed = _tec_seconds_since(suite_start);
                 char suite_time_buf[32];
                 tec_format_time(suite_elapsed, suite_time_buf,
                                 sizeof(suite_time_buf));
                 printf("%s  Suite total: %s%s\n", TEC_GRAY, suite_time_buf,
                        TEC_RESET);
+                _tec_note_suite_time(current_suite, suite_elapsed);
             }
             current_suite = test->suite;
-            suite_start = tec_get_time();
+            suite_start = tec_now_ns();
             const char *display_name = strstr(test->file, "tests/");
             if (display_name == NULL) {
                 display_name = strstr(test->file, "tests\\");
@@ -1203,6 +7758,17 @@ int tec_run_all(int argc, char **argv) {
             }
         }
 
+        // the compiler already evaluated it; a failed check fails the build.
+        if (test->compile_time) {
+            tec_context.stats.ran_tests++;
+            tec_context.stats.passed_tests++;
+            tec_context.stats.compile_time_tests++;
+            test->outcome = "passed";
+            printf(TEC_PRE_SPACE_SHORT "%s%s %s(compile time)%s\n",
+                   tec_pass_prefix, test->name, TEC_GRAY, TEC_RESET);
+            continue;
+        }
+
         if (suite_setup_failed) {
             tec_context.stats.skipped_tests++;
             printf(TEC_PRE_SPACE_SHORT "%s%s (skipped due to setup failure)\n",
@@ -1213,9 +7779,20 @@ int tec_run_all(int argc, char **argv) {
         tec_context.current_passed = 0;
         tec_context.current_failed = 0;
         tec_context.failure_message[0] = '\0';
+        tec_context.crash_signal = NULL;
+        tec_context.death.index = 0;
+        tec_context.current_test = test;
+        tec_context.latency_row_count = 0;
+        memset(&tec_context.bench, 0, sizeof(tec_context.bench));
         test_setup_failed = false;
+        uint64_t test_span_start = tec_now_ns();
+        _tec_watchdog_arm(test);
 
-        if (current_suite_ptr && current_suite_ptr->test_setup) {
+        if (!test->async)
+            test_setup_failed = _tec_fixture_prepare(current_suite_ptr);
+        // the event loop runs the fixtures of TEC_ASYNC tests itself.
+        if (!test_setup_failed && current_suite_ptr &&
+            current_suite_ptr->test_setup && !test->async) {
             test_setup_failed =
                 _fixture_exec_helper(current_suite_ptr->test_setup, NULL);
         }
@@ -1230,20 +7807,32 @@ int tec_run_all(int argc, char **argv) {
             printf(TEC_PRE_SPACE_SHORT
                    "%s%s (skipped due to test setup failure)\n",
                    tec_skip_prefix, test->name);
+            test->outcome = "skipped";
         } else {
             tec_context.stats.ran_tests++;
-            double test_start = tec_get_time();
+            if (tec_context.options.capture)
+                _tec_capture_begin();
+            if (tec_context.options.profile_dir)
+                _tec_profile_begin(i);
+            tec_func_t body = test->bench        ? _tec_bench_body
+                              : test->concurrent ? _tec_concurrent_body
+                                                 : test->func;
+#ifdef TEC_HAVE_ASYNC
+            if (test->async)
+                body = _tec_async_body;
+#endif
+            if (test->virtual_time && !_tec_virtual_time_begin())
+                body = _tec_virtual_time_missing;
+            _tec_leak_begin();
+            tec_timestamp_t test_start = _tec_timestamp();
 #ifdef __cplusplus
             try {
-                test->func();
-                double test_elapsed = tec_get_time() - test_start;
-                tec_process_test_result(TEC_INITIAL, test, test_elapsed);
+                body();
+                _tec_finish_test(TEC_INITIAL, test, test_start);
             } catch (const tec_assertion_failure &) {
-                double test_elapsed = tec_get_time() - test_start;
-                tec_process_test_result(TEC_FAIL, test, test_elapsed);
+                _tec_finish_test(TEC_FAIL, test, test_start);
             } catch (const tec_skip_test &) {
-                double test_elapsed = tec_get_time() - test_start;
-                tec_process_test_result(TEC_SKIP_e, test, test_elapsed);
+                _tec_finish_test(TEC_SKIP_e, test, test_start);
             } catch (const std::exception &e) {
                 tec_context.current_failed++;
                 snprintf(tec_context.failure_message,
@@ -1251,8 +7840,7 @@ int tec_run_all(int argc, char **argv) {
                          TEC_PRE_SPACE_SHORT
                          "%sTest threw an unhandled std::exception: %s\n",
                          tec_fail_prefix, e.what());
-                double test_elapsed = tec_get_time() - test_start;
-                tec_process_test_result(TEC_FAIL, test, test_elapsed);
+                _tec_finish_test(TEC_FAIL, test, test_start);
             } catch (...) {
                 tec_context.current_failed++;
                 snprintf(tec_context.failure_message,
@@ -1260,26 +7848,34 @@ int tec_run_all(int argc, char **argv) {
                          TEC_PRE_SPACE_SHORT
                          "%sTest threw an unknown C++ exception.\n",
                          tec_fail_prefix);
-                double test_elapsed = tec_get_time() - test_start;
-                tec_process_test_result(TEC_FAIL, test, test_elapsed);
+                _tec_finish_test(TEC_FAIL, test, test_start);
             }
 #else
             tec_context.jump_set = true;
             int jump_val = setjmp(tec_context.jump_buffer);
             if (jump_val == TEC_INITIAL) {
-                test->func();
+                _tec_guarded_call(body);
+            } else {
+                _tec_guarded_call_abandoned();
             }
             tec_context.jump_set = false;
-            double test_elapsed = tec_get_time() - test_start;
-            tec_process_test_result((JUMP_CODES)jump_val, test, test_elapsed);
+            _tec_finish_test((JUMP_CODES)jump_val, test, test_start);
 #endif
-            if (current_suite_ptr && current_suite_ptr->test_teardown) {
+            if (current_suite_ptr && current_suite_ptr->test_teardown &&
+                !test->async) {
                 _fixture_exec_helper(current_suite_ptr->test_teardown,
                                      "Test Teardown");
             }
         }
+        _tec_scratch_cleanup();
+        _tec_print_scratch();
+        _tec_watchdog_disarm();
+        _tec_trace_span("test", test->name, test->suite, test->outcome,
+                        test_span_start);
+        tec_context.current_test = NULL;
         if (tec_context.options.fail_fast &&
             ((!test->xfail && tec_context.current_failed > 0) ||
+             tec_context.stats.failed_tests > 0 ||
              tec_context.stats.xpassed_tests > 0)) {
             break;
         }
@@ -1289,14 +7885,25 @@ int tec_run_all(int argc, char **argv) {
         !suite_setup_failed) {
         _fixture_exec_helper(current_suite_ptr->teardown, "Suite Teardown");
     }
-    suite_elapsed = tec_get_time() - suite_start;
+    _tec_fixture_free(current_suite_ptr);
+    _tec_trace_span("suite", current_suite, NULL, NULL, suite_start);
+    suite_elapsed = _tec_seconds_since(suite_start);
     char suite_time_buf[32];
     tec_format_time(suite_elapsed, suite_time_buf, sizeof(suite_time_buf));
     printf("%s  Suite total: %s%s\n", TEC_GRAY, suite_time_buf, TEC_RESET);
+    _tec_note_suite_time(current_suite, suite_elapsed);
 
-    total_elapsed = tec_get_time() - total_start;
+    total_elapsed = _tec_seconds_since(total_start);
+    _tec_trace_span("run", "all tests", NULL, NULL, total_start);
     char total_time_buf[32];
     tec_format_time(total_elapsed, total_time_buf, sizeof(total_time_buf));
+    if (tec_context.options.durations > 0) {
+        _tec_print_durations(total_elapsed);
+    }
+    profile_files = _tec_profile_write();
+    if (tec_context.options.trace_path) {
+        trace_failed = !_tec_trace_write(total_start);
+    }
 
     printf("\n%s================================%s\n", TEC_BLUE, TEC_RESET);
     printf("Tests:      "
@@ -1331,6 +7938,31 @@ int tec_run_all(int argc, char **argv) {
            TEC_GREEN, tec_context.stats.passed_assertions, TEC_RESET, TEC_RED,
            tec_context.stats.failed_assertions, TEC_RESET,
            tec_context.stats.total_assertions);
+    if (tec_context.stats.updated_snapshots > 0) {
+        printf("Snapshots:  %s%zu updated%s\n", TEC_YELLOW,
+               tec_context.stats.updated_snapshots, TEC_RESET);
+    }
+    if (tec_context.stats.over_budget_tests > 0) {
+        printf("Budget:     %s%zu test(s) over time budget%s\n", TEC_YELLOW,
+               tec_context.stats.over_budget_tests, TEC_RESET);
+    }
+    if (tec_context.stats.leaking_tests > 0) {
+        printf("Leaks:      %s%zu test(s) leaked memory%s\n", TEC_YELLOW,
+               tec_context.stats.leaking_tests, TEC_RESET);
+    }
+    if (tec_context.stats.compile_time_tests > 0) {
+        printf("Constexpr:  %s%zu test(s) checked at compile time%s\n",
+               TEC_CYAN, tec_context.stats.compile_time_tests, TEC_RESET);
+    }
+    if (tec_context.stats.unstable_benchmarks > 0) {
+        printf("Benchmarks: %s%zu unstable (CV above %.1f%%)%s\n", TEC_YELLOW,
+               tec_context.stats.unstable_benchmarks,
+               tec_context.options.bench_cv_pct, TEC_RESET);
+    }
+    if (profile_files > 0) {
+        printf("Profile:    %s%zu folded stack file(s) in %s%s\n", TEC_CYAN,
+               profile_files, tec_context.options.profile_dir, TEC_RESET);
+    }
     printf("Time:       %s%s%s\n", TEC_CYAN, total_time_buf, TEC_RESET);
 
     if (tec_context.stats.failed_tests > 0 ||
@@ -1352,6 +7984,11 @@ int tec_run_all(int argc, char **argv) {
                 printf(TEC_PRE_SPACE_SHORT "%s %s%s%s\n", prefix, TEC_MAGENTA,
                        tec_context.options.filters[i], TEC_RESET);
             }
+            if (benchmarks_left_out > 0) {
+                printf(TEC_PRE_SPACE_SHORT TEC_PRE_SPACE_SHORT
+                       "%zu benchmark(s), run them with %s--bench%s\n",
+                       benchmarks_left_out, TEC_MAGENTA, TEC_RESET);
+            }
         }
         result = 1;
     } else if (tec_context.stats.skipped_tests > 0) {
@@ -1362,10 +7999,28 @@ int tec_run_all(int argc, char **argv) {
         printf("\n%sAll tests passed!%s\n", TEC_GREEN, TEC_RESET);
         result = 0;
     }
+    if (trace_failed) {
+        // the error is printed above; a run asked for a trace must not pass
+        // without one.
+        result = 1;
+    }
 
 cleanup:
+    _tec_watchdog_stop();
+#ifndef _WIN32
+    _tec_signals_uninstall();
+    _tec_zygote_stop();
+#endif
+    _tec_capture_close();
+#ifdef TEC_HAVE_ASYNC
+    _tec_async_reset();
+#endif
+    _tec_arena_free();
+    _tec_profile_stop();
+    free(tec_context.trace.events);
     free(tec_context.registry.entries);
     free(tec_context.registry.suites);
+    free(tec_context.registry.suite_times);
     free(tec_context.options.filters);
     memset(&tec_context, 0, sizeof(tec_context_t));
     return result;
@@ -2,6 +2,7 @@
 #include "tec.h"
 #include <iostream>
 #include <memory>
+#include <stdexcept>
 #include <vector>
 
 TEC(cpp_features, Vector) {
@@ -0,0 +1,42 @@
+#include "../../tec.h"
+
+#ifdef __cplusplus
+#include <vector>
+#endif
+
+/*
+ * Tests for tec_arena_alloc(). The runner rewinds the arena after every test
+ * with _tec_arena_reset(); the tests call it themselves to see the effect.
+ */
+TEC(arena, allocations_are_aligned) {
+    char *small = (char *)tec_arena_alloc(3, 1);
+    double *aligned = (double *)tec_arena_alloc(4 * sizeof(double), 64);
+    char *fallback = (char *)tec_arena_alloc(24, 0);
+    TEC_ASSERT_NOT_NULL(small);
+    TEC_ASSERT_NOT_NULL(aligned);
+    TEC_ASSERT_EQ((uintptr_t)aligned % 64, (uintptr_t)0);
+    TEC_ASSERT_EQ((uintptr_t)fallback % TEC_ARENA_ALIGN, (uintptr_t)0);
+    TEC_ASSERT_NULL(tec_arena_alloc(8, 3));
+
+    // larger than a block, gets one of its own.
+    char *big = (char *)tec_arena_alloc(4 * TEC_ARENA_BLOCK_SIZE, 0);
+    TEC_ASSERT_NOT_NULL(big);
+    memset(big, 0xab, 4 * TEC_ARENA_BLOCK_SIZE);
+}
+
+TEC(arena, reset_hands_the_memory_out_again) {
+    char *first = (char *)tec_arena_alloc(3, 1);
+    TEC_ASSERT_NOT_NULL(tec_arena_alloc(4 * TEC_ARENA_BLOCK_SIZE, 0));
+    _tec_arena_reset();
+    TEC_ASSERT_EQ((char *)tec_arena_alloc(3, 1), first);
+}
+
+#ifdef __cplusplus
+TEC(arena, containers_use_the_allocator) {
+    std::vector<int, tec_arena_allocator<int>> values;
+    for (int i = 0; i < 10000; ++i)
+        values.push_back(i);
+    TEC_ASSERT_EQ(values.size(), (size_t)10000);
+    TEC_ASSERT_EQ(values[9999], 9999);
+}
+#endif
@@ -50,3 +50,154 @@ TEC(assertions, test_float_near_success) {
 TEC_XFAIL(assertions, test_float_near_failure) {
     TEC_ASSERT_NEAR(3.1415, 3.2, 0.01);
 }
+
+TEC(assertions, test_text_success) {
+    TEC_ASSERT_TEXT_EQ("alpha\nbeta\ngamma\n", "alpha\nbeta\ngamma\n");
+    TEC_ASSERT_TEXT_EQ("", "");
+}
+
+TEC_XFAIL(assertions, test_text_failure) {
+    TEC_ASSERT_TEXT_EQ("alpha\nbeta\ngamma\n", "alpha\nBETA\ngamma\n");
+}
+
+TEC_XFAIL(assertions, test_text_failure_large_input) {
+    const size_t lines = 20000;
+    char *a = (char *)malloc(lines * 16);
+    char *b = (char *)malloc(lines * 16);
+    TEC_TRY_BLOCK({
+        TEC_ASSERT_NOT_NULL(a);
+        TEC_ASSERT_NOT_NULL(b);
+        size_t len = 0;
+        for (size_t i = 0; i < lines; ++i) {
+            len += (size_t)sprintf(a + len, "line %zu\n", i);
+        }
+        memcpy(b, a, len + 1);
+        b[len / 2] = '#';
+        TEC_ASSERT_TEXT_EQ(a, b);
+    });
+    free(a);
+    free(b);
+}
+
+TEC(assertions, test_text_failure_message) {
+    const char *msg = _TEC_CTX.failure_message;
+
+    TEC_ASSERT(!_tec_text_eq("alpha\nbeta\ngamma\n", "alpha\nBETA\ngamma\n",
+                             "a", "b", 1));
+    TEC_ASSERT_NOT_NULL(strstr(msg, "@@ -1,3 +1,3 @@"));
+    TEC_ASSERT_NOT_NULL(strstr(msg, " alpha"));
+    TEC_ASSERT_NOT_NULL(strstr(msg, "-beta"));
+    TEC_ASSERT_NOT_NULL(strstr(msg, "+BETA"));
+
+    // an empty side names the line before the hunk, as diff -u does.
+    TEC_ASSERT(!_tec_text_eq("", "one\ntwo\n", "a", "b", 1));
+    TEC_ASSERT_NOT_NULL(strstr(msg, "@@ -0,0 +1,2 @@"));
+    TEC_ASSERT_NOT_NULL(strstr(msg, "+one"));
+    TEC_ASSERT_NOT_NULL(strstr(msg, "+two"));
+    TEC_ASSERT(!_tec_text_eq("one\ntwo\n", "", "a", "b", 1));
+    TEC_ASSERT_NOT_NULL(strstr(msg, "@@ -1,2 +0,0 @@"));
+    TEC_ASSERT_NOT_NULL(strstr(msg, "-one"));
+    _TEC_CTX.failure_message[0] = '\0';
+}
+
+// nothing in common: the diff gives up and names the first difference.
+TEC(assertions, test_text_failure_unrelated_texts) {
+    const size_t lines = 20000;
+    char *a = (char *)malloc(lines * 16);
+    char *b = (char *)malloc(lines * 16);
+    TEC_TRY_BLOCK({
+        TEC_ASSERT_NOT_NULL(a);
+        TEC_ASSERT_NOT_NULL(b);
+        size_t len_a = (size_t)sprintf(a, "same\n");
+        size_t len_b = (size_t)sprintf(b, "same\n");
+        for (size_t i = 0; i < lines; ++i) {
+            len_a += (size_t)sprintf(a + len_a, "a %zu\n", i);
+            len_b += (size_t)sprintf(b + len_b, "b %zu\n", i);
+        }
+        const char *msg = _TEC_CTX.failure_message;
+        TEC_ASSERT(!_tec_text_eq(a, b, "a", "b", 1));
+        TEC_ASSERT_NOT_NULL(strstr(msg, "first difference at line 2, byte 5"));
+        TEC_ASSERT_NOT_NULL(strstr(msg, "-a 0"));
+        TEC_ASSERT_NOT_NULL(strstr(msg, "+b 0"));
+        _TEC_CTX.failure_message[0] = '\0';
+    });
+    free(a);
+    free(b);
+}
+
+TEC(assertions, test_ulp_success) {
+    double third = 1.0 / 3.0;
+    TEC_ASSERT_ULP_EQ(third * 3.0, 1.0, 1);
+    TEC_ASSERT_ULP_EQ(1e300 * (1.0 + DBL_EPSILON), 1e300, 2);
+    TEC_ASSERT_ULP_EQ(0.0, -0.0, 0);
+    TEC_ASSERT_ULP_EQ(0.1f + 0.2f, 0.3f, 1);
+}
+
+TEC_XFAIL(assertions, test_ulp_failure) { TEC_ASSERT_ULP_EQ(1.0, 1.0001, 4); }
+
+// 2^24 + 1 rounds to 2^24 as a float; integers are compared as double.
+TEC_XFAIL(assertions, test_ulp_int32_is_not_float) {
+    TEC_ASSERT_ULP_EQ((int32_t)16777217, (int32_t)16777216, 0);
+}
+
+TEC(assertions, test_near_rel_success) {
+    TEC_ASSERT_NEAR_REL(1e9, 1e9 + 1.0, 1e-8, 0.0);
+    TEC_ASSERT_NEAR_REL(1e-20, 0.0, 1e-6, 1e-12);
+}
+
+TEC_XFAIL(assertions, test_near_rel_failure) {
+    TEC_ASSERT_NEAR_REL(100.0, 101.0, 1e-3, 1e-9);
+}
+
+TEC(assertions, test_array_near_success) {
+    float fa[64], fb[64];
+    double da[64], db[64];
+    for (int i = 0; i < 64; ++i) {
+        fa[i] = (float)i * 0.5f;
+        fb[i] = fa[i] + 1e-6f;
+        da[i] = (double)i / 3.0;
+        db[i] = da[i] - 1e-12;
+    }
+    TEC_ASSERT_ARRAY_NEAR(fa, fb, 64, 1e-5);
+    TEC_ASSERT_ARRAY_NEAR(da, db, 64, 1e-9);
+    const double *cda = da;
+    TEC_ASSERT_ARRAY_NEAR(cda, db, 64, 1e-9);
+}
+
+TEC_XFAIL(assertions, test_array_near_failure) {
+    double a[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+    double b[8] = {0, 1, 2, 3.5, 4, 5, 6, 7.001};
+    TEC_ASSERT_ARRAY_NEAR(a, b, 8, 0.01);
+}
+
+TEC(assertions, test_percentile_success) {
+    static tec_latency_recorder rec;
+    tec_latency_reset(&rec);
+    for (uint64_t ns = 1; ns <= 1000; ++ns) {
+        tec_latency_record(&rec, ns);
+    }
+    TEC_ASSERT_EQ(tec_latency_percentile(&rec, 1.0), (uint64_t)10);
+    TEC_ASSERT_EQ(tec_latency_percentile(&rec, 100.0), (uint64_t)1000);
+    TEC_ASSERT_PERCENTILE_LE(rec, 50.0, 510);
+    TEC_ASSERT_PERCENTILE_LE(rec, 99.0, 1000);
+}
+
+TEC(assertions, test_percentile_precision) {
+    static tec_latency_recorder rec;
+    tec_latency_reset(&rec);
+    uint64_t big = 5000000000ull;
+    tec_latency_record(&rec, big);
+    uint64_t p = tec_latency_percentile(&rec, 50.0);
+    TEC_ASSERT(p <= big && p >= big - big / 64);
+}
+
+TEC_XFAIL(assertions, test_percentile_failure) {
+    static tec_latency_recorder rec;
+    tec_latency_reset(&rec);
+    for (int i = 0; i < 98; ++i) {
+        tec_latency_record(&rec, 1000);
+    }
+    tec_latency_record(&rec, 2000000);
+    tec_latency_record(&rec, 3000000);
+    TEC_ASSERT_PERCENTILE_LE(rec, 99.0, 10000);
+}
@@ -0,0 +1,50 @@
+#include "../../tec.h"
+
+/*
+ * Tests for TEC_ASYNC, which needs C++20 coroutines and epoll. All async
+ * tests of a suite run interleaved, so they finish in order of how long they
+ * wait, not in name order; each one checks that against those done before.
+ */
+#ifdef TEC_HAVE_ASYNC
+static int longest_wait_done = 0;
+
+static void finished_after(int waited_ms) {
+    TEC_ASSERT_LE(longest_wait_done, waited_ms);
+    longest_wait_done = waited_ms;
+}
+
+static tec_task<int> add_later(int a, int b) {
+    co_await tec_sleep_ms(1);
+    co_return a + b;
+}
+
+static tec_task<> write_later(int fd) {
+    co_await tec_sleep_ms(5);
+    TEC_ASSERT_EQ(write(fd, "x", 1), (ssize_t)1);
+}
+
+TEC_ASYNC(async, sleeps_longest) {
+    co_await tec_sleep_ms(30);
+    TEC_ASSERT_EQ(co_await add_later(2, 3), 5);
+    finished_after(31);
+}
+
+TEC_ASYNC(async, finishes_first) {
+    co_await tec_sleep_ms(1);
+    finished_after(1);
+}
+
+TEC_ASYNC(async, waits_for_a_pipe) {
+    int fds[2];
+    TEC_ASSERT_EQ(pipe(fds), 0);
+    tec_task<> writer = write_later(fds[1]);
+    co_await writer;
+    co_await tec_readable(fds[0]);
+    char c = 0;
+    TEC_ASSERT_EQ(read(fds[0], &c, 1), (ssize_t)1);
+    TEC_ASSERT_EQ(c, 'x');
+    close(fds[0]);
+    close(fds[1]);
+    finished_after(5);
+}
+#endif
@@ -0,0 +1,90 @@
+#include "../../tec.h"
+
+/*
+ * Tests for TEC_BENCH. The benchmarks below run only with --bench; the plain
+ * tests drive the measurement directly, so they run every time.
+ */
+static volatile unsigned checksum = 0;
+
+static unsigned sum_small_array(void) {
+    unsigned values[16] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+    unsigned sum = 0;
+    for (size_t i = 0; i < 16; ++i)
+        sum += values[i];
+    return sum;
+}
+
+TEC_BENCH(bench, sums_a_small_array) { checksum = sum_small_array(); }
+
+static size_t calls = 0;
+
+static void count_call(void) {
+    checksum = sum_small_array();
+    calls++;
+}
+
+TEC(bench, measure_runs_warmup_and_every_sample) {
+    tec_bench_point_t point;
+    memset(&point, 0, sizeof(point));
+    calls = 0;
+    _tec_bench_measure(count_call, &point);
+    TEC_ASSERT_GE(point.iterations, (uint64_t)1);
+    TEC_ASSERT(calls >= tec_context.options.bench_warmup +
+                            TEC_BENCH_SAMPLES * point.iterations);
+    TEC_ASSERT_LE(point.min_ns, point.median_ns);
+    TEC_ASSERT_GE(point.cv_pct, 0.0);
+    TEC_ASSERT_EQ(checksum, 120u);
+}
+
+static volatile unsigned sweep_sink = 0;
+
+TEC_BENCH_RANGE(bench, linear_scan_is_linear, 32, 8192) {
+    static unsigned char data[8192];
+    unsigned sum = 0;
+    for (size_t i = 0; i < tec_bench_n(); ++i)
+        sum += data[i];
+    sweep_sink = sum;
+    TEC_ASSERT_COMPLEXITY_LE(O_N);
+}
+
+TEC_XFAIL(bench, complexity_needs_a_range_benchmark) {
+    TEC_ASSERT_COMPLEXITY_LE(O_N); // not in a TEC_BENCH_RANGE
+}
+
+TEC_BENCH_RANGE(bench, nested_loop_is_at_most_quadratic, 8, 512) {
+    unsigned sum = 0;
+    for (size_t i = 0; i < tec_bench_n(); ++i)
+        for (size_t j = 0; j < tec_bench_n(); ++j)
+            sum += (unsigned)(i ^ j);
+    sweep_sink = sum;
+    TEC_ASSERT_COMPLEXITY_LE(O_N2);
+}
+
+TEC_BENCH_THREADS(bench, threads_share_a_counter, 2) {
+    static unsigned long shared = 0;
+    __atomic_fetch_add(&shared, 1, __ATOMIC_RELAXED);
+}
+
+static void assert_on_first_thread(void) {
+    TEC_ASSERT_EQ(tec_bench_thread_id(), (size_t)0);
+}
+
+// in a death-test child, so the worker's failure doesn't count here.
+static void bench_with_failing_worker(void) {
+    tec_bench_throughput_t point;
+    JUMP_CODES failed;
+    memset(&point, 0, sizeof(point));
+    uint64_t start = tec_now_ns();
+    bool ok = _tec_bench_throughput(assert_on_first_thread, 2, &point, &failed);
+    uint64_t taken = tec_now_ns() - start;
+    fputs(tec_context.failure_message, stderr);
+    exit(!ok && failed == TEC_FAIL && tec_context.current_failed == 1 &&
+                 taken < TEC_BENCH_THREAD_RUN_NS
+             ? 0
+             : 1);
+}
+
+TEC(bench, failing_worker_stops_the_thread_run) {
+    TEC_ASSERT_DEATH(bench_with_failing_worker(), TEC_DEATH_EXIT(0),
+                     "On thread 1 \\(of 2\\)");
+}
@@ -0,0 +1,30 @@
+#include "../../tec.h"
+
+/*
+ * Tests for time budgets on TEC_XFAIL tests. Whether the body failed decides
+ * "expected failure" against "unexpected success"; running over budget is
+ * reported next to that, never in place of it. Each verdict is printed in a
+ * death-test child so the xpass doesn't count against this run.
+ */
+static void report_xfail_over_budget(JUMP_CODES jump_val) {
+    tec_entry_t entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.suite = "budget";
+    entry.name = "slow_xfail";
+    entry.xfail = true;
+    entry.budget_ms = 1.0;
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+    tec_process_test_result(jump_val, &entry, 1.0);
+    fflush(stdout);
+    exit(0);
+}
+
+TEC(budget, passing_xfail_over_budget_is_an_unexpected_success) {
+    TEC_ASSERT_DEATH(report_xfail_over_budget(TEC_INITIAL), TEC_DEATH_EXIT(0),
+                     "unexpected success.*\n.*Over time budget");
+}
+
+TEC(budget, failing_xfail_over_budget_is_an_expected_failure) {
+    TEC_ASSERT_DEATH(report_xfail_over_budget(TEC_FAIL), TEC_DEATH_EXIT(0),
+                     "expected failure");
+}
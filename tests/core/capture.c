@@ -0,0 +1,81 @@
+#include "../../tec.h"
+
+/*
+ * Tests for --capture. The suite setup turns the option on, so the runner
+ * captures fd 1 and fd 2 around each test body and restores them once it
+ * finishes, the same as for a run started with the flag.
+ */
+static bool capture_was_on;
+
+TEC_SETUP(capture) {
+    capture_was_on = tec_context.options.capture;
+    tec_context.options.capture = true;
+}
+
+TEC_TEARDOWN(capture) { tec_context.options.capture = capture_was_on; }
+
+static void greet(const char *name) { printf("hello, %s\n", name); }
+
+TEC(capture, stdout_contains_and_eq) {
+#ifdef _WIN32
+    TEC_SKIP("stdout capture is POSIX only");
+#endif
+    TEC_ASSERT_STDOUT_EQ("");
+    greet("world");
+    fputs("to stderr\n", stderr);
+    TEC_ASSERT_STDOUT_CONTAINS("hello");
+    TEC_ASSERT_STDOUT_CONTAINS("world\n");
+    TEC_ASSERT_STDOUT_EQ("hello, world\n");
+    greet("again");
+    TEC_ASSERT_STDOUT_EQ("hello, world\nhello, again\n");
+}
+
+TEC(capture, captures_raw_writes) {
+#ifdef _WIN32
+    TEC_SKIP("stdout capture is POSIX only");
+#else
+    TEC_ASSERT(write(STDOUT_FILENO, "raw", 3) == 3);
+    TEC_ASSERT_STDOUT_EQ("raw");
+#endif
+}
+
+TEC_XFAIL(capture, stdout_mismatch_fails) {
+#ifdef _WIN32
+    TEC_ASSERT(false);
+#endif
+    greet("world");
+    TEC_ASSERT_STDOUT_CONTAINS("goodbye");
+}
+
+#ifndef _WIN32
+/*
+ * Reports a test that printed, the way the runner does once its body has
+ * returned. The report goes to stderr, where TEC_ASSERT_DEATH can see it.
+ */
+static void report_noisy_test(JUMP_CODES jump_val) {
+    tec_entry_t entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.suite = "capture";
+    entry.name = "noisy";
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+    _tec_capture_begin();
+    greet("from the body");
+    if (jump_val == TEC_FAIL)
+        tec_context.current_failed = 1;
+    tec_process_test_result(jump_val, &entry, 0.0);
+    fflush(stdout);
+    exit(0);
+}
+
+TEC(capture, output_is_replayed_when_a_test_fails) {
+    TEC_ASSERT_DEATH(report_noisy_test(TEC_FAIL), TEC_DEATH_EXIT(0),
+                     "noisy - 1 assertion\\(s\\) failed.*"
+                     "Captured stdout \\(21 bytes\\):.*hello, from the body");
+}
+
+TEC(capture, output_is_dropped_when_a_test_passes) {
+    // nothing may follow the test's own result line.
+    TEC_ASSERT_DEATH(report_noisy_test(TEC_INITIAL), TEC_DEATH_EXIT(0),
+                     "^[^\n]*noisy [^\n]*\n$");
+}
+#endif
@@ -0,0 +1,89 @@
+#include "../../tec.h"
+
+/*
+ * Tests for the clocks behind test timings: tec_now_ns(), the `--clock tsc`
+ * source and the subtraction of the timing window's own cost.
+ */
+#ifndef _WIN32
+#include <time.h>
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void sleep_ms(long ms) {
+    struct timespec ts = {0, ms * 1000000L};
+    nanosleep(&ts, NULL);
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+TEC(clock, now_ns_advances_with_real_time) {
+    uint64_t mono = monotonic_ns();
+    uint64_t now = tec_now_ns();
+    sleep_ms(2);
+    uint64_t now_taken = tec_now_ns() - now;
+    uint64_t mono_taken = monotonic_ns() - mono;
+
+    TEC_ASSERT_GE(now_taken, 2000000u);
+    // both bracket the same sleep, give or take the reads around it.
+    TEC_ASSERT_LE(now_taken, mono_taken + 1000000u);
+}
+
+TEC(clock, sleeping_costs_wall_time_not_cpu_time) {
+    tec_timestamp_t start = _tec_timestamp();
+    sleep_ms(5);
+    tec_timestamp_t taken = _tec_elapsed(start);
+
+    TEC_ASSERT_GE(taken.wall_ns, 5000000u);
+    TEC_ASSERT_LT(taken.cpu_ns, taken.wall_ns);
+}
+
+TEC(clock, cpu_time_never_exceeds_wall_time) {
+    for (int i = 0; i < 1000; ++i) {
+        tec_timestamp_t taken = _tec_elapsed(_tec_timestamp());
+        TEC_ASSERT_LE(taken.cpu_ns, taken.wall_ns);
+    }
+}
+
+TEC(clock, empty_window_is_corrected_to_about_zero) {
+    enum { SAMPLES = 101 };
+    uint64_t raw[SAMPLES];
+    uint64_t corrected[SAMPLES];
+    for (int i = 0; i < SAMPLES; ++i) {
+        uint64_t t0 = tec_now_ns();
+        tec_timestamp_t taken = _tec_elapsed(_tec_timestamp());
+        raw[i] = tec_now_ns() - t0;
+        corrected[i] = taken.wall_ns;
+    }
+    qsort(raw, SAMPLES, sizeof(uint64_t), compare_u64);
+    qsort(corrected, SAMPLES, sizeof(uint64_t), compare_u64);
+
+    // `raw` also holds the window's reads; after the subtraction a typical
+    // empty window is left with well under half of that.
+    TEC_ASSERT_LE(corrected[SAMPLES / 2] * 2, raw[SAMPLES / 2]);
+}
+
+TEC(clock, tsc_clock_tracks_the_monotonic_clock) {
+    // what `--clock tsc` switches to at start-up.
+    bool have_tsc = _tec_clock_use_tsc();
+    uint64_t mono = monotonic_ns();
+    uint64_t now = tec_now_ns();
+    sleep_ms(10);
+    int64_t now_taken = (int64_t)(tec_now_ns() - now);
+    int64_t mono_taken = (int64_t)(monotonic_ns() - mono);
+    _tec_clock_init();
+
+    if (!have_tsc)
+        TEC_SKIP("no invariant TSC on this machine");
+    // calibration is over a few milliseconds, so allow a few percent.
+    int64_t diff = now_taken - mono_taken;
+    TEC_ASSERT_LE(diff < 0 ? -diff : diff, mono_taken / 20 + 100000);
+}
+#endif
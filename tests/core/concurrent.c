@@ -0,0 +1,42 @@
+#include "../../tec.h"
+
+/*
+ * Tests for TEC_CONCURRENT. The plain test runs the concurrent body through
+ * _tec_concurrent_body(), as the runner does, so it can check the workers'
+ * results and merged assertions afterwards.
+ */
+static long increments = 0;
+static unsigned threads_seen = 0;
+
+TEC_TEST_SETUP(concurrent) {
+    increments = 0;
+    threads_seen = 0;
+}
+
+TEC_CONCURRENT(concurrent, threads_increment_together, 4, 500) {
+    long after = __atomic_add_fetch(&increments, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_or(&threads_seen, 1u << tec_concurrent_thread_id(),
+                      __ATOMIC_RELAXED);
+    TEC_ASSERT(after > 0);
+    TEC_ASSERT_LE(after, 4L * 500);
+}
+
+TEC(concurrent, every_worker_runs_every_iteration) {
+    const tec_entry_t *saved = tec_context.current_test;
+    tec_entry_t entry = *saved;
+    entry.func = tec_concurrent_threads_increment_together;
+    entry.concurrent = true;
+    entry.threads = 4;
+    entry.iterations = 500;
+    size_t before = tec_context.stats.total_assertions;
+
+    tec_context.current_test = &entry;
+    _tec_concurrent_body();
+    tec_context.current_test = saved;
+
+    size_t merged = tec_context.stats.total_assertions - before;
+    TEC_ASSERT_EQ(increments, 4L * 500);
+    TEC_ASSERT_EQ(threads_seen, 0xfu);
+    TEC_ASSERT_EQ(merged, (size_t)(4 * 500 * 2));
+    TEC_ASSERT_EQ(tec_concurrent_thread_id(), (size_t)0);
+}
@@ -0,0 +1,37 @@
+#include "../../tec.h"
+
+/*
+ * Tests for TEC_CONSTEXPR, which needs C++14. The bodies run inside the
+ * compiler; the plain test at the end checks how the runner recorded them.
+ */
+#ifdef TEC_HAVE_CONSTEXPR
+static constexpr int constexpr_factorial(int n) {
+    return n <= 1 ? 1 : n * constexpr_factorial(n - 1);
+}
+
+TEC_CONSTEXPR(constexpr_checks, a_factorial) {
+    TEC_CONSTEXPR_ASSERT_EQ(constexpr_factorial(0), 1);
+    TEC_CONSTEXPR_ASSERT_EQ(constexpr_factorial(5), 120);
+    TEC_CONSTEXPR_ASSERT(constexpr_factorial(10) > constexpr_factorial(9));
+}
+
+TEC_CONSTEXPR(constexpr_checks, b_loops_and_locals) {
+    int fib[10] = {0, 1};
+    for (int i = 2; i < 10; ++i)
+        fib[i] = fib[i - 1] + fib[i - 2];
+    TEC_CONSTEXPR_ASSERT_EQ(fib[9], 34);
+}
+
+TEC(constexpr_checks, c_listed_as_passed) {
+    size_t found = 0;
+    for (size_t i = 0; i < tec_context.registry.tec_count; ++i) {
+        tec_entry_t *entry = &tec_context.registry.entries[i];
+        if (strcmp(entry->suite, "constexpr_checks") != 0 ||
+            !entry->compile_time)
+            continue;
+        TEC_ASSERT_STR_EQ(entry->outcome, "passed");
+        found++;
+    }
+    TEC_ASSERT_EQ(found, (size_t)2);
+}
+#endif
@@ -26,3 +26,27 @@ TEC_XFAIL(control_flow,
     // USING THIS SO THE SUMMARY DOESN'T LOOK THAT UGLY
     // TEC_ASSERT_NE(1, 1);
 }
+
+#if !defined(__cplusplus) && !defined(_WIN32)
+static void dereference_null(void) {
+    volatile int *volatile ptr = NULL;
+    *ptr = 42;
+}
+
+// drives the --catch-signals machinery directly, so it also runs (and must
+// pass) when the flag is not given.
+TEC(control_flow, fatal_signal_becomes_a_failure) {
+    bool installed_here = _tec_signals_install();
+    bool crashed = _tec_guarded_call(dereference_null);
+    if (installed_here) {
+        _tec_signals_uninstall();
+    }
+    const char *crash_signal = tec_context.crash_signal;
+    // the crash was provoked on purpose, don't count it against this test.
+    tec_context.current_failed--;
+    tec_context.crash_signal = NULL;
+
+    TEC_ASSERT_TRUE(crashed);
+    TEC_ASSERT_STR_EQ(crash_signal, "SIGSEGV");
+}
+#endif
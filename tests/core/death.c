@@ -0,0 +1,81 @@
+#include "../../tec.h"
+
+/*
+ * Tests for TEC_ASSERT_DEATH. Each statement runs in a child of the death-test
+ * fork server, which replays the test up to the assertion, so the state built
+ * before it must be visible in the child.
+ */
+static void fail_with(const char *reason, int status) {
+    fprintf(stderr, "fatal: %s\n", reason);
+    exit(status);
+}
+
+static int parse_positive(int value) {
+    if (value <= 0) {
+        fprintf(stderr, "parse_positive: %d is not positive\n", value);
+        abort();
+    }
+    return value;
+}
+
+TEC(death, exit_status_and_stderr) {
+    TEC_ASSERT_DEATH(fail_with("bad input", 3), TEC_DEATH_EXIT(3),
+                     "bad in[a-z]+");
+    TEC_ASSERT_DEATH(fail_with("anything", 0), TEC_DEATH_ANY, NULL);
+}
+
+TEC(death, signal) {
+    TEC_ASSERT_EQ(parse_positive(7), 7);
+    TEC_ASSERT_DEATH(parse_positive(-1), TEC_DEATH_SIGNAL(SIGABRT),
+                     "-1 is not positive");
+}
+
+TEC(death, replays_state_before_the_assertion) {
+    char name[32];
+    int status = 0;
+    for (int i = 1; i <= 4; ++i) {
+        status += i;
+    }
+    snprintf(name, sizeof(name), "step %d", status);
+    TEC_ASSERT_DEATH(fail_with(name, status), TEC_DEATH_EXIT(10), "step 10");
+    TEC_ASSERT_DEATH(fail_with(name, status + 1), TEC_DEATH_EXIT(11), NULL);
+}
+
+TEC_XFAIL(death, statement_that_returns) {
+    int value = 0;
+    TEC_ASSERT_DEATH(value++, TEC_DEATH_ANY, NULL);
+}
+
+TEC_XFAIL(death, wrong_exit_status) {
+    TEC_ASSERT_DEATH(fail_with("oops", 2), TEC_DEATH_EXIT(3), NULL);
+}
+
+TEC_XFAIL(death, stderr_mismatch) {
+    TEC_ASSERT_DEATH(fail_with("oops", 3), TEC_DEATH_EXIT(3), "^expected");
+}
+
+// the replay dies before the assertion; that death is not the statement's.
+TEC_XFAIL(death, replay_crashes_before_the_statement) {
+    if (tec_context.death.in_child)
+        abort();
+    TEC_ASSERT_DEATH((void)0, TEC_DEATH_ANY, NULL);
+}
+
+// the child prepares the typed fixture the same way the runner does.
+typedef struct {
+    int value;
+    int *p;
+} death_state;
+
+TEC_FIXTURE(death_fixture, death_state);
+
+TEC_FIXTURE_RESET(death_fixture, fx) {
+    fx->value = 5;
+    fx->p = &fx->value;
+}
+
+TEC_F(death_fixture, statement_sees_the_fixture, fx) {
+    TEC_ASSERT_EQ(*fx->p, 5);
+    TEC_ASSERT_DEATH(fail_with("from fixture", *fx->p - 2), TEC_DEATH_EXIT(3),
+                     "from fixture");
+}
@@ -58,6 +58,39 @@ TEC(formatter_macros, test_pointer_types) {
     TEC_ASSERT_EQ(vptr, (void *)&x);
 }
 
+#ifdef __cplusplus
+#include <ostream>
+#include <string>
+
+struct formatter_point {
+    int x, y;
+};
+inline std::ostream &operator<<(std::ostream &out, const formatter_point &p) {
+    return out << "(" << p.x << ", " << p.y << ")";
+}
+enum formatter_color { FORMATTER_RED = 3 };
+
+TEC(formatter_macros, test_cpp_values) {
+    char buf[TEC_FMT_SLOT_SIZE];
+
+    TEC_FMT(std::string("plain"), buf);
+    TEC_ASSERT_STR_EQ(buf, "plain");
+    TEC_FMT("quoted", buf);
+    TEC_ASSERT_STR_EQ(buf, "\"quoted\"");
+    TEC_FMT('c', buf);
+    TEC_ASSERT_STR_EQ(buf, "c");
+    TEC_FMT(true, buf);
+    TEC_ASSERT_STR_EQ(buf, "1");
+    TEC_FMT(0.25, buf);
+    TEC_ASSERT_STR_EQ(buf, "0.25");
+    TEC_FMT(FORMATTER_RED, buf);
+    TEC_ASSERT_STR_EQ(buf, "3");
+    formatter_point point = {1, -2};
+    TEC_FMT(point, buf);
+    TEC_ASSERT_STR_EQ(buf, "(1, -2)");
+}
+#endif
+
 TEC_XFAIL(formatter_macros, verify_uint64_formatting_on_failure) {
     uint64_t u64 = 18446744073709551615ULL; // UINT64_MAX
     TEC_ASSERT_EQ(u64, (uint64_t)0);
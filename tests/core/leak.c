@@ -0,0 +1,99 @@
+#include "../../tec.h"
+
+/*
+ * Tests for --leak-check. Each test turns the check on around its own
+ * allocations; the leaking ones run in a death-test child so their reports
+ * don't count against this run.
+ */
+#ifdef TEC_HAVE_LEAK_CHECK
+static void leak_one_block(void) {
+    tec_context.options.leak_check = true;
+    tec_context.failure_message[0] = '\0';
+    _tec_leak_begin();
+    void *block = malloc(64);
+    _tec_leak_end();
+    bool leaked = _tec_leak_check();
+    fputs(tec_context.failure_message, stderr);
+    free(block);
+    exit(leaked ? 0 : 1);
+}
+
+TEC(leak, balanced_allocations_are_not_leaks) {
+    bool was_on = tec_context.options.leak_check;
+    tec_context.options.leak_check = true;
+    _tec_leak_begin();
+    char *text = (char *)malloc(16);
+    char *bigger = (char *)realloc(text, 4096);
+    int *zeroes = (int *)calloc(8, sizeof(int));
+    bool allocated = bigger != NULL && zeroes != NULL;
+    free(zeroes);
+    free(bigger);
+    _tec_leak_end();
+    bool leaked = _tec_leak_check();
+    tec_context.options.leak_check = was_on;
+
+    TEC_ASSERT(allocated);
+    TEC_ASSERT(!leaked);
+}
+
+TEC(leak, unfreed_block_is_reported) {
+    TEC_ASSERT_DEATH(leak_one_block(), TEC_DEATH_EXIT(0),
+                     "Leaked 64 bytes in 1 block\\(s\\)");
+}
+
+// like a time budget, a leak doesn't turn a passing TEC_XFAIL body into an
+// expected failure.
+static void report_leaking_xfail(void) {
+    tec_entry_t entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.suite = "leak";
+    entry.name = "leaking_xfail";
+    entry.xfail = true;
+    tec_context.options.leak_check = true;
+    tec_context.failure_message[0] = '\0';
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+    _tec_leak_begin();
+    void *block = malloc(64);
+    tec_process_test_result(TEC_INITIAL, &entry, 0.0);
+    fflush(stdout);
+    free(block);
+    exit(0);
+}
+
+TEC(leak, passing_xfail_that_leaks_is_an_unexpected_success) {
+    TEC_ASSERT_DEATH(report_leaking_xfail(), TEC_DEATH_EXIT(0),
+                     "unexpected success.*\n.*Leaked 64 bytes");
+}
+
+#ifdef __cplusplus
+#include <new>
+
+static __attribute__((noinline)) int *allocate_with_new(void) {
+    return new int(7);
+}
+
+// `new` is reported where it was called, not inside libstdc++.
+static void leak_through_new(void) {
+    tec_context.options.leak_check = true;
+    tec_context.failure_message[0] = '\0';
+    _tec_leak_begin();
+    int *one = new int(1);
+    delete one;
+    int *many = new int[8];
+    delete[] many;
+    int *maybe = new (std::nothrow) int(2);
+    delete maybe;
+    int *block = allocate_with_new();
+    _tec_leak_end();
+    bool leaked = _tec_leak_check();
+    fputs(tec_context.failure_message, stderr);
+    delete block;
+    exit(leaked && strstr(tec_context.failure_message, "(_Zn") == NULL ? 0 : 1);
+}
+
+TEC(leak, new_is_reported_at_its_caller) {
+    TEC_ASSERT_DEATH(leak_through_new(), TEC_DEATH_EXIT(0),
+                     "Leaked 4 bytes in 1 block\\(s\\)");
+}
+#endif
+#endif
@@ -0,0 +1,56 @@
+#include "../../tec.h"
+
+/*
+ * Tests for --profile. A death-test child profiles a body that only spins,
+ * the way the runner does, and reads back the folded stacks it wrote: with
+ * the runner's frames cut off, nearly every sample is the body alone.
+ */
+#ifdef TEC_HAVE_BACKTRACE
+static void spin(void) {
+    volatile uint64_t sum = 0;
+    uint64_t start = tec_thread_cpu_ns();
+    while (tec_thread_cpu_ns() - start < 50000000u) {
+        for (uint64_t i = 0; i < 1000000; ++i)
+            sum = sum + i;
+    }
+}
+
+static void profile_spin(void) {
+    char dir[] = "/tmp/tec-profile-XXXXXX";
+    if (mkdtemp(dir) == NULL)
+        exit(2);
+    const tec_entry_t *test = &tec_context.registry.entries[0];
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s.%s.folded", dir, test->suite,
+             test->name);
+
+    tec_context.options.profile_dir = dir;
+    if (!_tec_profile_start())
+        exit(3);
+    _tec_profile_begin(0);
+    _tec_guarded_call(spin);
+    _tec_profile_end();
+    size_t files = _tec_profile_write();
+
+    size_t samples = 0;
+    size_t body_only = 0;
+    char line[4096];
+    FILE *f = fopen(path, "r");
+    while (f != NULL && fgets(line, sizeof(line), f) != NULL) {
+        char *count = strrchr(line, ' ');
+        size_t n = count ? (size_t)strtoul(count + 1, NULL, 10) : 0;
+        samples += n;
+        if (strchr(line, ';') == NULL)
+            body_only += n;
+    }
+    if (f != NULL)
+        fclose(f);
+    remove(path);
+    rmdir(dir);
+    exit(files == 1 && samples > 0 && body_only * 2 >= samples ? 0 : 1);
+}
+
+TEC(profile, samples_start_at_the_test_body) {
+    TEC_ASSERT_DEATH(profile_spin(), TEC_DEATH_EXIT(0), NULL);
+}
+#endif
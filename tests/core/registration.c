@@ -48,6 +48,20 @@ TEC_XFAIL(registration, t03_xfail_is_correct) {
     TEC_ASSERT(0);
 }
 
+TEC_BUDGET(registration, t04_budget_is_recorded, 60000) {
+    TEC_ASSERT_STR_EQ(__func__, "tec_registration_t04_budget_is_recorded");
+    TEC_ASSERT_NOT_NULL(tec_context.current_test);
+    TEC_ASSERT_FALSE(tec_context.current_test->xfail);
+    TEC_ASSERT_NEAR(tec_context.current_test->budget_ms, 60000.0, 1e-9);
+}
+
+TEC_TIMEOUT(registration, t05_timeout_is_recorded, 120) {
+    TEC_ASSERT_STR_EQ(__func__, "tec_registration_t05_timeout_is_recorded");
+    TEC_ASSERT_NOT_NULL(tec_context.current_test);
+    TEC_ASSERT_NEAR(tec_context.current_test->timeout_s, 120.0, 1e-9);
+    TEC_ASSERT_NEAR(tec_context.current_test->budget_ms, 0.0, 1e-9);
+}
+
 TEC(registration, t90_registry_metadata) {
     size_t found = 0;
     for (size_t i = 0; i < tec_context.registry.tec_count; ++i) {
@@ -57,6 +71,7 @@ TEC(registration, t90_registry_metadata) {
             found++;
             TEC_ASSERT_FALSE(e->xfail);
             TEC_ASSERT_FUNC_NOT_NULL(e->func);
+            TEC_ASSERT_NEAR(e->budget_ms, 0.0, 1e-9);
         }
         if (strcmp(e->suite, "registration") == 0 &&
             strcmp(e->name, "t03_xfail_is_correct") == 0) {
@@ -71,6 +86,6 @@ TEC(registration, t90_registry_metadata) {
 TEC(registration, t99_final_count) {
     TEC_ASSERT_EQ(suite_setup_calls, 1);
     TEC_ASSERT_EQ(suite_teardown_calls, 0);
-    TEC_ASSERT_EQ(test_setup_calls, 5);
-    TEC_ASSERT_EQ(test_teardown_calls, 4);
+    TEC_ASSERT_EQ(test_setup_calls, 7);
+    TEC_ASSERT_EQ(test_teardown_calls, 6);
 }
@@ -0,0 +1,32 @@
+#include "../../tec.h"
+
+/*
+ * Tests for tec_scratch_dir() and tec_memfd_open(). The runner removes a
+ * test's scratch space with _tec_scratch_cleanup() once it has finished;
+ * the test calls it itself to check what is left.
+ */
+#ifndef _WIN32
+TEC(scratch, files_live_in_memory_until_cleanup) {
+    const char *dir = tec_scratch_dir();
+    TEC_ASSERT_NOT_NULL(dir);
+    TEC_ASSERT_STR_EQ(tec_scratch_dir(), dir);
+    char saved_dir[TEC_PATH_MAX];
+    snprintf(saved_dir, sizeof(saved_dir), "%s", dir);
+
+    char path[TEC_PATH_MAX];
+    snprintf(path, sizeof(path), "%s/data.bin", dir);
+    FILE *f = fopen(path, "wb");
+    TEC_ASSERT_NOT_NULL(f);
+    TEC_ASSERT_EQ(fwrite("0123456789", 1, 10, f), (size_t)10);
+    TEC_ASSERT_EQ(fclose(f), 0);
+
+    int fd = tec_memfd_open("scratch-test");
+    TEC_ASSERT_GE(fd, 0);
+    TEC_ASSERT_EQ(write(fd, "abcd", 4), (ssize_t)4);
+
+    _tec_scratch_cleanup();
+    struct stat st;
+    TEC_ASSERT_NE(stat(saved_dir, &st), 0);
+    TEC_ASSERT_EQ(fcntl(fd, F_GETFD), -1);
+}
+#endif
@@ -27,3 +27,56 @@ TEC(buffer_tests, test_two) {
     // This test gets a fresh state because TEC_TEST_SETUP ran again
     TEC_ASSERT_STR_EQ(shared_buffer, "initial_state");
 }
+
+// Typed fixtures: the struct is allocated once and reset before each test.
+typedef struct {
+    char *buffer; // allocated by the first reset, reused after that
+    int resets;
+} typed_state;
+
+static char *first_buffer = NULL;
+static int releases = 0;
+
+TEC_FIXTURE(typed_buffer, typed_state);
+
+TEC_FIXTURE_RESET(typed_buffer, fx) {
+    if (fx->buffer == NULL)
+        fx->buffer = (char *)malloc(100);
+    TEC_ASSERT_NOT_NULL(fx->buffer);
+    strcpy(fx->buffer, "initial_state");
+    fx->resets++;
+}
+
+TEC_FIXTURE_RELEASE(typed_buffer, fx) {
+    free(fx->buffer);
+    releases++;
+}
+
+TEC_F(typed_buffer, a_starts_from_the_reset, fx) {
+    TEC_ASSERT_STR_EQ(fx->buffer, "initial_state");
+    strcpy(fx->buffer, "modified_by_a");
+    first_buffer = fx->buffer;
+}
+
+TEC_F(typed_buffer, b_reuses_the_same_storage, fx) {
+    TEC_ASSERT_STR_EQ(fx->buffer, "initial_state");
+    if (first_buffer != NULL) {
+        TEC_ASSERT_EQ((void *)fx->buffer, (void *)first_buffer);
+        TEC_ASSERT_EQ(fx->resets, 2);
+    }
+    TEC_ASSERT_EQ(releases, 0);
+}
+
+typedef struct {
+    int counter;
+} zeroed_state;
+
+TEC_FIXTURE(zeroed_fixture, zeroed_state);
+
+TEC_F(zeroed_fixture, a_writes, fx) {
+    TEC_ASSERT_EQ(fx->counter, 0);
+    fx->counter = 42;
+}
+
+// without a reset hook the struct is zeroed again.
+TEC_F(zeroed_fixture, b_sees_zeroes, fx) { TEC_ASSERT_EQ(fx->counter, 0); }
@@ -0,0 +1,19 @@
+#include "../../tec.h"
+
+static const char greeting[] = "tec.h snapshot v1\nsecond line\n";
+
+TEC(snapshot, matches_golden) {
+    TEC_ASSERT_SNAPSHOT("greeting", greeting, sizeof(greeting) - 1);
+}
+
+TEC_XFAIL(snapshot, detects_changed_payload) {
+    if (tec_context.options.update_snapshots)
+        TEC_SKIP("Would overwrite the golden with bad data.");
+    TEC_ASSERT_SNAPSHOT("greeting", "tec.h snapshot v2\n", 18);
+}
+
+TEC_XFAIL(snapshot, detects_missing_golden) {
+    if (tec_context.options.update_snapshots)
+        TEC_SKIP("Would record a golden that must stay missing.");
+    TEC_ASSERT_SNAPSHOT("does_not_exist", greeting, sizeof(greeting) - 1);
+}
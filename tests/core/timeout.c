@@ -0,0 +1,36 @@
+#include "../../tec.h"
+
+/*
+ * Tests for the watchdog behind TEC_TIMEOUT and --timeout. A test that hangs
+ * past its limit ends the whole run, so the hang happens in a death-test
+ * child with a watchdog of its own.
+ */
+#ifndef _WIN32
+static void hang_past(double timeout_s, double option_s) {
+    tec_entry_t entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.suite = "timeout";
+    entry.name = "hangs";
+    entry.file = __FILE__;
+    entry.timeout_s = timeout_s;
+    tec_context.options.timeout_s = option_s;
+    _tec_watchdog_start();
+    _tec_watchdog_arm(&entry);
+    for (;;) {
+        pause();
+    }
+}
+
+TEC(timeout, test_limit_aborts_the_run) {
+    TEC_ASSERT_DEATH(hang_past(0.05, 0.0),
+                     TEC_DEATH_EXIT(TEC_TIMEOUT_EXIT_CODE),
+                     "TIMEOUT: timeout\\.hangs did not finish within 50\\.000 "
+                     "ms");
+}
+
+TEC(timeout, option_limit_aborts_the_run) {
+    TEC_ASSERT_DEATH(hang_past(0.0, 0.05),
+                     TEC_DEATH_EXIT(TEC_TIMEOUT_EXIT_CODE),
+                     "did not finish within 50\\.000 ms");
+}
+#endif
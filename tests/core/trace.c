@@ -0,0 +1,72 @@
+#include "../../tec.h"
+
+/*
+ * Tests for --trace. A death-test child starts a second run of its own over
+ * the trace_target suite, which has suite fixtures, and reads back the
+ * trace that run wrote.
+ */
+#ifndef _WIN32
+static int target_setups;
+
+TEC_SETUP(trace_target) { target_setups++; }
+TEC_TEARDOWN(trace_target) { target_setups--; }
+
+TEC(trace_target, traced_test) { TEC_ASSERT_EQ(target_setups, 1); }
+
+static int run_traced(const char *path) {
+    char *argv[] = {(char *)"test_runner", (char *)"-f",
+                    (char *)"trace_target.", (char *)"--trace",
+                    (char *)path, NULL};
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDOUT_FILENO);
+    close(null_fd);
+    memset(&tec_context.options, 0, sizeof(tec_context.options));
+    return tec_run_all(5, argv);
+}
+
+static void trace_target_suite(void) {
+    char path[] = "/tmp/tec-trace-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0)
+        exit(2);
+    close(fd);
+    int rc = run_traced(path);
+
+    static char json[1 << 16];
+    FILE *f = fopen(path, "r");
+    size_t len = f ? fread(json, 1, sizeof(json) - 1, f) : 0;
+    json[len] = '\0';
+    if (f != NULL)
+        fclose(f);
+    remove(path);
+
+    const char *spans[] = {
+        "{\"name\":\"traced_test\",\"cat\":\"test\"",
+        "\"args\":{\"suite\":\"trace_target\",\"result\":\"passed\"}",
+        "{\"name\":\"trace_target\",\"cat\":\"suite\"",
+        "{\"name\":\"Suite Setup\",\"cat\":\"fixture\"",
+        "{\"name\":\"Suite Teardown\",\"cat\":\"fixture\"",
+        "{\"name\":\"all tests\",\"cat\":\"run\"",
+    };
+    for (size_t i = 0; i < sizeof(spans) / sizeof(spans[0]); ++i) {
+        if (strstr(json, spans[i]) == NULL) {
+            fprintf(stderr, "missing span: %s\n", spans[i]);
+            exit(1);
+        }
+    }
+    exit(rc);
+}
+
+static void trace_to_missing_dir(void) {
+    exit(run_traced("/nonexistent-tec-dir/trace.json"));
+}
+
+TEC(trace, records_test_suite_and_fixture_spans) {
+    TEC_ASSERT_DEATH(trace_target_suite(), TEC_DEATH_EXIT(0), NULL);
+}
+
+TEC(trace, unwritable_trace_fails_the_run) {
+    TEC_ASSERT_DEATH(trace_to_missing_dir(), TEC_DEATH_EXIT(1),
+                     "could not write trace to /nonexistent-tec-dir");
+}
+#endif
@@ -0,0 +1,43 @@
+#include "../../tec.h"
+
+/*
+ * Tests for TEC_TYPED, which needs C++. The plain test at the end checks the
+ * names the instances were registered under.
+ */
+#ifdef __cplusplus
+TEC_TYPED(typed, a_sums_small_arrays, int8_t, int32_t, float, double) {
+    tec_type values[4] = {1, 2, 3, 4};
+    tec_type sum = 0;
+    for (size_t i = 0; i < 4; ++i)
+        sum = (tec_type)(sum + values[i]);
+    TEC_ASSERT_EQ(sum, (tec_type)10);
+}
+
+template <typename K, typename V> struct typed_pair {
+    K key;
+    V value;
+};
+
+TEC_TYPED(typed, b_keeps_template_arguments, typed_pair<int, char>, long) {
+    tec_type values[3] = {};
+    TEC_ASSERT_EQ(sizeof(values), 3 * sizeof(tec_type));
+}
+
+TEC(typed, c_instances_have_type_names) {
+    const char *expected[] = {
+        "a_sums_small_arrays<int8_t>", "a_sums_small_arrays<int32_t>",
+        "a_sums_small_arrays<float>", "a_sums_small_arrays<double>",
+        "b_keeps_template_arguments<typed_pair<int, char>>",
+        "b_keeps_template_arguments<long>"};
+    for (const char *name : expected) {
+        bool found = false;
+        for (size_t i = 0; i < tec_context.registry.tec_count; ++i) {
+            const tec_entry_t *entry = &tec_context.registry.entries[i];
+            if (strcmp(entry->suite, "typed") == 0 &&
+                strcmp(entry->name, name) == 0)
+                found = true;
+        }
+        TEC_ASSERT(found);
+    }
+}
+#endif
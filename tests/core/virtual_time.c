@@ -0,0 +1,51 @@
+#include "../../tec.h"
+
+/*
+ * Tests for TEC_VIRTUAL_TIME. Every sleep below would take over an hour of
+ * real time; on the simulated clock the test finishes at once.
+ */
+#ifdef TEC_HAVE_VIRTUAL_TIME
+#include <poll.h>
+
+static uint64_t clock_ns(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+TEC_VIRTUAL_TIME(virtual_time, sleeps_advance_the_clock) {
+    uint64_t real_start = tec_now_ns();
+    uint64_t mono_start = clock_ns(CLOCK_MONOTONIC);
+    uint64_t wall_start = clock_ns(CLOCK_REALTIME);
+
+    TEC_ASSERT_EQ(sleep(3600), 0u);
+    struct timespec five = {5, 0};
+    TEC_ASSERT_EQ(nanosleep(&five, NULL), 0);
+    TEC_ASSERT_EQ(usleep(250000), 0);
+    TEC_ASSERT_EQ(poll(NULL, 0, 1500), 0);
+
+    uint64_t slept = 3600000000000ull + 5000000000ull + 250000000ull +
+                     1500000000ull;
+    TEC_ASSERT_EQ(clock_ns(CLOCK_MONOTONIC) - mono_start, slept);
+    TEC_ASSERT_EQ(clock_ns(CLOCK_REALTIME) - wall_start, slept);
+    TEC_ASSERT(tec_now_ns() - real_start < 1000000000ull);
+}
+
+TEC_VIRTUAL_TIME(virtual_time, ready_poll_does_not_advance) {
+    int fds[2];
+    TEC_ASSERT_EQ(pipe(fds), 0);
+    TEC_ASSERT_EQ(write(fds[1], "x", 1), (ssize_t)1);
+    uint64_t start = clock_ns(CLOCK_MONOTONIC);
+    struct pollfd pfd = {fds[0], POLLIN, 0};
+    TEC_ASSERT_EQ(poll(&pfd, 1, 60000), 1);
+    TEC_ASSERT_EQ(clock_ns(CLOCK_MONOTONIC), start);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEC(virtual_time, plain_tests_use_real_time) {
+    uint64_t start = clock_ns(CLOCK_MONOTONIC);
+    TEC_ASSERT_EQ(usleep(1000), 0);
+    TEC_ASSERT_GE(clock_ns(CLOCK_MONOTONIC) - start, 1000000ull);
+}
+#endif
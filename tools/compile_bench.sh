@@ -0,0 +1,80 @@
+#!/bin/sh
+# Measures what tec.h costs a test file at compile time: generates N test
+# files shaped like tests/core/*.c, compiles each one on its own and prints
+# the average seconds per translation unit. The TEC_IMPLEMENTATION file is
+# built once and reported separately, since a project only has one.
+#
+#   tools/compile_bench.sh [-n files] [-x c|c++] [compiler [flags...]]
+#
+# e.g. tools/compile_bench.sh -n 20 -x c++ clang++ -std=c++17 -O2
+
+set -eu
+
+files=50
+lang=c
+while getopts n:x: opt; do
+    case $opt in
+    n) files=$OPTARG ;;
+    x) lang=$OPTARG ;;
+    *) exit 2 ;;
+    esac
+done
+shift $((OPTIND - 1))
+
+case $lang in
+c) ext=c; default_cc=${CC:-cc} ;;
+c++) ext=cpp; default_cc=${CXX:-c++} ;;
+*) echo "compile_bench: -x takes c or c++" >&2; exit 2 ;;
+esac
+if [ $# -eq 0 ]; then
+    set -- "$default_cc"
+fi
+
+root=$(cd "$(dirname "$0")/.." && pwd)
+work=$(mktemp -d "${TMPDIR:-/tmp}/tec-compile-bench-XXXXXX")
+trap 'rm -rf "$work"' EXIT INT TERM
+
+now() {
+    date +%s.%N
+}
+
+i=0
+while [ $i -lt "$files" ]; do
+    {
+        echo "#include \"$root/tec.h\""
+        echo
+        for t in 0 1 2 3 4 5 6 7; do
+            echo "TEC(gen_$i, test_$t) {"
+            echo "    int n = $t;"
+            echo "    double d = n * 0.5;"
+            echo "    const char *s = \"tec\";"
+            echo "    TEC_ASSERT(n >= 0);"
+            echo "    TEC_ASSERT_EQ(n, $t);"
+            echo "    TEC_ASSERT_NE(d, -1.0);"
+            echo "    TEC_ASSERT_FLOAT_EQ(d, $t * 0.5);"
+            echo "    TEC_ASSERT_STR_EQ(s, \"tec\");"
+            echo "}"
+            echo
+        done
+    } >"$work/test_$i.$ext"
+    i=$((i + 1))
+done
+printf '#define TEC_IMPLEMENTATION\n#include "%s/tec.h"\n\nTEC_MAIN()\n' \
+    "$root" >"$work/runner.$ext"
+
+start=$(now)
+"$@" -c "$work/runner.$ext" -o "$work/runner.o"
+runner=$(echo "$(now) $start" | awk '{ printf "%.3f", $1 - $2 }')
+
+start=$(now)
+i=0
+while [ $i -lt "$files" ]; do
+    "$@" -c "$work/test_$i.$ext" -o "$work/test_$i.o"
+    i=$((i + 1))
+done
+total=$(echo "$(now) $start" | awk '{ printf "%.3f", $1 - $2 }')
+
+echo "compiler: $*"
+echo "runner TU: ${runner}s"
+echo "$files test TUs: ${total}s," \
+    "$(echo "$total $files" | awk '{ printf "%.4f", $1 / $2 }')s per TU"